@@ -0,0 +1,71 @@
+#!/bin/sh
+# Compare the hand-written /dev/msg (write_read_lseek.ko) with the same
+# device built on common/chardev.h (write_read_lseek_core.ko), using the
+# same devbench load against both.
+#
+#   sudo ./bench_core.sh [seconds] [threads] [cpus]
+#
+# Runs, in this order:
+#   msg             the hand-written driver
+#   core-array      chardev.h, array store (the msgbuf.h engine, like msg)
+#   core-array+t    same, with stats_timing=1 (two ktime_get_ns() per call)
+#   core-pages      chardev.h, xarray of pages
+# and prints ops/s and p50/p99 (us) per run plus the ratios to msg. The
+# ring store is left out: it has no lseek and reads consume, so the same
+# load would not measure the same thing.
+#
+# Needs both modules built here (make) and tools/devbench built.
+
+SECS=${1:-5}
+THREADS=${2:-1}
+CPUS=$3
+HERE=$(cd $(dirname $0) && pwd)
+DEVBENCH=$HERE/../tools/devbench/devbench
+OUT=$(mktemp -d)
+LOAD="-m read=45,write=45,lseek=10 -s 1,64,512"
+
+[ -x $DEVBENCH ] || make -C $HERE/../tools/devbench -s || exit 1
+
+run() {     # <label> <node>
+    $DEVBENCH run -n $1 -d $SECS -t $THREADS ${CPUS:+-c $CPUS} $LOAD $2 > $OUT/$1.txt || exit 1
+    # "all" line: op ops ops/s MB/s errors p50 p90 p99 ...
+    set -- $1 $(grep '^all ' $OUT/$1.txt)
+    printf "%-12s %12s %8s %8s\n" $1 $4 $7 $9
+    echo $4 > $OUT/$1.ops
+}
+
+ratio() {   # <label> <baseline>
+    awk -v a=$(cat $OUT/$1.ops) -v b=$(cat $OUT/$2.ops) \
+        'BEGIN { printf "%-12s %11.3fx\n", "'$1'", a / b }'
+}
+
+insmod $HERE/write_read_lseek.ko || exit 1
+insmod $HERE/write_read_lseek_core.ko store=array || { rmmod write_read_lseek; exit 1; }
+udevadm settle 2>/dev/null
+ATTR=/sys/class/msgcore/msgcore
+
+printf "%-12s %12s %8s %8s\n" run ops/s p50 p99
+run msg /dev/msg
+run core-array /dev/msgcore
+echo 1 > $ATTR/stats_timing
+run core-array+t /dev/msgcore
+echo 0 > $ATTR/stats_timing
+cat $ATTR/stats > $OUT/stats
+
+rmmod write_read_lseek_core
+insmod $HERE/write_read_lseek_core.ko store=pages size=1024
+udevadm settle 2>/dev/null
+run core-pages /dev/msgcore
+
+rmmod write_read_lseek_core
+rmmod write_read_lseek
+
+echo
+echo "relative to msg (1.000x = as fast):"
+for R in core-array core-array+t core-pages; do
+    ratio $R msg
+done
+echo
+echo "chardev stats after core-array+t (op calls bytes errors ns):"
+cat $OUT/stats
+echo "full reports in $OUT"
@@ -0,0 +1,234 @@
+/*
+ * bench_splice.c - move N bytes out of /dev/msg into /dev/null and into a
+ * pipe, once through a user buffer (read + write) and once with
+ * sendfile()/splice(), and compare throughput and CPU time.
+ *
+ * The device is filled first (writes until ENOSPC) and rewound on every
+ * EOF, so load it with a buffer worth reading, e.g.
+ *
+ * gcc -O2 -pthread -o bench_splice bench_splice.c
+ * sudo insmod write_read_lseek.ko bufferSize=1048576
+ * sudo ./bench_splice [-n bytes] [-b chunk] [node]
+ *   e.g. ./bench_splice -n 10G -b 64K /dev/msg
+ *
+ * In the pipe runs a second thread splices the pipe into /dev/null, the
+ * same way in both runs, so only the device -> pipe side differs.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+
+#define PIPE_SIZE	(1 << 20)
+
+enum mode { NULL_RW, NULL_SENDFILE, PIPE_RW, PIPE_SPLICE, NR_MODES };
+
+static const char *const mode_names[NR_MODES] = {
+	"null read/write", "null sendfile", "pipe read/write", "pipe splice",
+};
+
+static uint64_t total = 10ULL << 30;
+static size_t chunk = 64 << 10;
+static const char *node = "/dev/msg";
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(2);
+}
+
+static uint64_t parse_size(const char *s)
+{
+	char *end;
+	uint64_t v = strtoull(s, &end, 0);
+
+	switch (*end) {
+	case 'G': case 'g': v <<= 10;	/* fall through */
+	case 'M': case 'm': v <<= 10;	/* fall through */
+	case 'K': case 'k': v <<= 10;
+	}
+	return v;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_time(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/* write a pattern until the device says ENOSPC; returns the bytes stored */
+static uint64_t fill(int fd)
+{
+	char *buf = malloc(chunk);
+	uint64_t stored = 0;
+	ssize_t n;
+	size_t i;
+
+	if (!buf)
+		die("malloc");
+	for (i = 0; i < chunk; i++)
+		buf[i] = 'a' + i % 26;
+
+	lseek(fd, 0, SEEK_SET);
+	while ((n = write(fd, buf, chunk)) > 0)
+		stored += n;
+	if (n < 0 && errno != ENOSPC)
+		die("write");
+
+	free(buf);
+	return stored;
+}
+
+static void *drain(void *arg)
+{
+	int rfd = *(int *)arg;
+	int null = open("/dev/null", O_WRONLY);
+	ssize_t n;
+
+	if (null < 0)
+		die("/dev/null");
+	while ((n = splice(rfd, NULL, null, NULL, PIPE_SIZE, SPLICE_F_MOVE)) > 0)
+		;
+	if (n < 0)
+		die("splice (drain)");
+	close(null);
+	return NULL;
+}
+
+static void run(int dev, enum mode mode)
+{
+	int out, pfd[2] = { -1, -1 };
+	char *buf = NULL;
+	uint64_t moved = 0;
+	unsigned long long rewinds = 0;
+	double t0, c0, secs, cpu;
+	pthread_t tid;
+	ssize_t n;
+
+	if (mode == PIPE_RW || mode == PIPE_SPLICE) {
+		if (pipe(pfd))
+			die("pipe");
+		fcntl(pfd[1], F_SETPIPE_SZ, PIPE_SIZE);
+		if (pthread_create(&tid, NULL, drain, &pfd[0]))
+			die("pthread_create");
+		out = pfd[1];
+	} else {
+		out = open("/dev/null", O_WRONLY);
+		if (out < 0)
+			die("/dev/null");
+	}
+	if (mode == NULL_RW || mode == PIPE_RW) {
+		buf = malloc(chunk);
+		if (!buf)
+			die("malloc");
+	}
+
+	lseek(dev, 0, SEEK_SET);
+	t0 = now();
+	c0 = cpu_time();
+
+	while (moved < total) {
+		size_t want = total - moved < chunk ? total - moved : chunk;
+
+		switch (mode) {
+		case NULL_RW:
+		case PIPE_RW:
+			n = read(dev, buf, want);
+			if (n > 0 && write(out, buf, n) != n)
+				die("write");
+			break;
+		case NULL_SENDFILE:
+			n = sendfile(out, dev, NULL, want);
+			break;
+		default:
+			n = splice(dev, NULL, out, NULL, want, SPLICE_F_MOVE);
+			break;
+		}
+		if (n < 0)
+			die(mode_names[mode]);
+		if (!n) {
+			lseek(dev, 0, SEEK_SET);
+			rewinds++;
+			continue;
+		}
+		moved += n;
+	}
+
+	if (pfd[1] >= 0) {
+		close(pfd[1]);
+		pthread_join(tid, NULL);
+		close(pfd[0]);
+	} else {
+		close(out);
+	}
+	secs = now() - t0;
+	cpu = cpu_time() - c0;
+	free(buf);
+
+	printf("%-16s %8.2f %8.2f %8.2f %8.2f %10llu\n", mode_names[mode],
+	       moved / secs / (1 << 30), secs, cpu, cpu / (moved / (double)(1 << 30)), rewinds);
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t stored;
+	int opt, dev, m;
+
+	while ((opt = getopt(argc, argv, "n:b:")) != -1) {
+		switch (opt) {
+		case 'n':
+			total = parse_size(optarg);
+			break;
+		case 'b':
+			chunk = parse_size(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n bytes] [-b chunk] [node]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		node = argv[optind];
+	if (!total || !chunk) {
+		fprintf(stderr, "-n and -b must be > 0\n");
+		return 1;
+	}
+
+	dev = open(node, O_RDWR);
+	if (dev < 0)
+		die(node);
+	stored = fill(dev);
+	if (!stored) {
+		fprintf(stderr, "%s: nothing could be written\n", node);
+		return 2;
+	}
+
+	printf("%s: %llu bytes in the device, moving %llu bytes in %zu byte calls\n", node,
+	       (unsigned long long)stored, (unsigned long long)total, chunk);
+	printf("%-16s %8s %8s %8s %8s %10s\n", "run", "GiB/s", "secs", "cpu s", "cpu/GiB",
+	       "rewinds");
+	for (m = 0; m < NR_MODES; m++)
+		run(dev, m);
+
+	close(dev);
+	return 0;
+}
@@ -5,6 +5,18 @@
 #include <linux/device.h>
 #include <linux/cdev.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
+#include <linux/version.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
+#include <linux/crc32c.h>
+#include <linux/sizes.h>
+#include <asm/unaligned.h>
+#include "msgbuf.h"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Your Name");
@@ -27,10 +39,24 @@ dev_t deviceNumber;
 struct class *myClass = NULL;
 struct device *myDevice = NULL;
 
+unsigned int bufferSize = 1024;
+module_param(bufferSize, uint, 0444);
+MODULE_PARM_DESC(bufferSize, "Message buffer size in bytes");
+
 static struct cdev myCdev;
-#define MAX_SIZE        1024
-char kernel_buffer[MAX_SIZE];
-int kernel_buffer_index;
+
+/*
+ * The buffer is an array of pages rather than one kmalloc'ed block, so
+ * splice()/sendfile() can hand the pages themselves to a pipe instead of
+ * copying them (mySpliceRead). A page still referenced by a pipe is never
+ * written in place: the writer gets a fresh copy (myWritablePage), so what
+ * was spliced is what the reader sees. msg tracks len/size only; its data
+ * pointer is unused.
+ */
+static struct page **bufferPages;
+static unsigned int nrBufferPages;
+static struct msgbuf msg;
+static DEFINE_MUTEX(msgLock);
 
 static int myOpen(struct inode *inode, struct file *file) {
     pr_info("%s: Device opened\n", __func__);
@@ -38,70 +64,305 @@ static int myOpen(struct inode *inode, struct file *file) {
     return 0;
 }
 
-static ssize_t myRead(struct file *file, char __user *user_buffer, size_t len, loff_t *offset) {
-    ssize_t bytes_to_read;
+static ssize_t myReadIter(struct kiocb *iocb, struct iov_iter *to) {
+    size_t n, done = 0;
 
-    pr_info("%s: Read operation\n", __func__);
+    mutex_lock(&msgLock);
+    n = msgbuf_read_span(&msg, iocb->ki_pos, iov_iter_count(to));
+    while (done < n) {
+        loff_t pos = iocb->ki_pos + done;
+        size_t off = offset_in_page(pos);
+        size_t chunk = min_t(size_t, n - done, PAGE_SIZE - off);
+        size_t copied = copy_page_to_iter(bufferPages[pos >> PAGE_SHIFT], off, chunk, to);
 
-    // Check if offset is beyond valid data
-    if (*offset >= kernel_buffer_index) {
-        pr_info("%s: No more data to read\n", __func__);
-        return 0; // EOF
+        done += copied;
+        if (copied < chunk)
+            break;
     }
+    mutex_unlock(&msgLock);
 
-    // Limit read to available data
-    bytes_to_read = min_t(size_t, len, kernel_buffer_index - *offset);
-    if (bytes_to_read == 0) {
-        pr_info("%s: No data available to read\n", __func__);
-        return 0;
+    if (!done && n)
+        return -EFAULT;
+    iocb->ki_pos += done;
+    return done;
+}
+
+/*
+ * Page 'index' of the buffer, ready to be written. If a pipe still holds
+ * it (mySpliceRead took a reference), replace it with a private copy.
+ */
+static struct page *myWritablePage(unsigned int index) {
+    struct page *old = bufferPages[index];
+    struct page *page;
+
+    if (page_count(old) == 1)
+        return old;
+
+    page = alloc_page(GFP_KERNEL);
+    if (!page)
+        return NULL;
+    copy_highpage(page, old);
+    bufferPages[index] = page;
+    put_page(old);
+    return page;
+}
+
+/*
+ * Sink mode (sysfs "sink"): writes are not stored but consumed by a
+ * kernel-side sink, here a running checksum of everything written. Small
+ * writes are copied through sinkBounce like any other write; writes of at
+ * least pinThreshold bytes from a plain user buffer skip the copy: the
+ * user pages are pinned with pin_user_pages_fast() and the sink reads them
+ * in place through kmap_local_page(). The file position is not used.
+ */
+enum { SINK_OFF, SINK_XOR, SINK_CRC32C };
+static const char * const sinkNames[] = { "off", "xor", "crc32c" };
+
+#define SINK_PIN_BATCH  64      /* pages pinned per pin_user_pages_fast() */
+
+static int sinkMode = SINK_OFF;
+static size_t pinThreshold = SZ_64K;
+static u8 *sinkBounce;          /* PAGE_SIZE staging buffer of the copy path */
+static u64 sinkResult;
+static u64 sinkBytes, sinkPinnedBytes, sinkCopiedBytes;
+
+static void mySinkUpdate(const u8 *p, size_t len) {
+    u64 pos = sinkBytes;
+    u64 x = 0;
+
+    sinkBytes += len;
+    if (sinkMode == SINK_CRC32C) {
+        sinkResult = crc32c(sinkResult, p, len);
+        return;
     }
 
-    // Copy data to user space
-    if (copy_to_user(user_buffer, kernel_buffer + *offset, bytes_to_read)) {
-        pr_err("%s: Failed to copy data to user\n", __func__);
-        return -EFAULT;
+    // xor-fold into 8 byte lanes by stream position, so chunking does not matter
+    for (; len && (pos & 7); len--, pos++)
+        sinkResult ^= (u64)*p++ << (8 * (pos & 7));
+    for (; len >= 8; len -= 8, p += 8)
+        x ^= get_unaligned_le64(p);
+    sinkResult ^= x;
+    for (pos = 0; len; len--, pos++)
+        sinkResult ^= (u64)*p++ << (8 * pos);
+}
+
+/* one user segment, pinned SINK_PIN_BATCH pages at a time */
+static ssize_t mySinkPinned(unsigned long addr, size_t len) {
+    struct page *pages[SINK_PIN_BATCH];
+    size_t done = 0;
+
+    while (done < len) {
+        unsigned long start = addr + done;
+        size_t off = offset_in_page(start);
+        int nr = min_t(size_t, SINK_PIN_BATCH, DIV_ROUND_UP(off + len - done, PAGE_SIZE));
+        int pinned, i;
+
+        // the sink only reads the pages, so no FOLL_WRITE
+        pinned = pin_user_pages_fast(start & PAGE_MASK, nr, 0, pages);
+        if (pinned <= 0)
+            return done ? done : (pinned ? pinned : -EFAULT);
+
+        for (i = 0; i < pinned && done < len; i++) {
+            size_t chunk = min_t(size_t, len - done, PAGE_SIZE - off);
+            void *kaddr = kmap_local_page(pages[i]);
+
+            mySinkUpdate(kaddr + off, chunk);
+            kunmap_local(kaddr);
+            done += chunk;
+            off = 0;
+        }
+        unpin_user_pages(pages, pinned);
     }
+    return done;
+}
 
-    *offset += bytes_to_read;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 0, 0)
+#define user_backed_iter(i)     iter_is_iovec(i)
+#endif
+
+/*
+ * The user memory the iterator is at: a plain write() comes as ITER_UBUF
+ * since 6.0, only writev() as ITER_IOVEC. writev() may also pass empty
+ * iovecs; those are stepped over here, and advancing the iterator past
+ * the bytes of the segment returned steps over them too.
+ */
+static struct iovec mySinkSegment(const struct iov_iter *from) {
+    const struct iovec *seg;
+    size_t skip = from->iov_offset;
+    struct iovec iov;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)
+    if (iter_is_ubuf(from)) {
+        iov.iov_base = from->ubuf + skip;
+        iov.iov_len = iov_iter_count(from);
+        return iov;
+    }
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+    seg = iter_iov(from);
+#else
+    seg = from->iov;
+#endif
+    // the caller checked iov_iter_count(), so a non-empty one follows
+    while (skip == seg->iov_len) {
+        seg++;
+        skip = 0;
+    }
+    iov.iov_base = seg->iov_base + skip;
+    iov.iov_len = min(seg->iov_len - skip, iov_iter_count(from));
+    return iov;
+}
+
+static ssize_t mySinkWrite(struct iov_iter *from) {
+    size_t threshold = READ_ONCE(pinThreshold);    // sysfs may change it meanwhile
+    size_t count = iov_iter_count(from);
+    size_t done = 0;
+    ssize_t ret = 0;
+
+    mutex_lock(&msgLock);
+    if (threshold && count >= threshold && user_backed_iter(from)) {
+        while (iov_iter_count(from)) {
+            struct iovec iov = mySinkSegment(from);
+
+            ret = mySinkPinned((unsigned long)iov.iov_base, iov.iov_len);
+            if (ret <= 0)
+                break;
+            iov_iter_advance(from, ret);
+            done += ret;
+            if (ret < iov.iov_len)
+                break;
+        }
+        sinkPinnedBytes += done;
+    } else {
+        while (iov_iter_count(from)) {
+            size_t chunk = min_t(size_t, iov_iter_count(from), PAGE_SIZE);
+            size_t copied = copy_from_iter(sinkBounce, chunk, from);
+
+            mySinkUpdate(sinkBounce, copied);
+            done += copied;
+            if (copied < chunk) {
+                ret = -EFAULT;
+                break;
+            }
+        }
+        sinkCopiedBytes += done;
+    }
+    mutex_unlock(&msgLock);
 
-    pr_info("%s: Read %zd bytes, offset now %lld\n", __func__, bytes_to_read, *offset);
-    return bytes_to_read;
+    return done ? done : ret;
 }
 
-static ssize_t myWrite(struct file *file, const char __user *user_buffer, size_t len, loff_t *offset) {
-    ssize_t bytes_to_write;
+static ssize_t myWriteIter(struct kiocb *iocb, struct iov_iter *from) {
+    ssize_t n;
+    size_t done = 0;
+    int err = 0;
 
-    pr_info("%s: Write operation\n", __func__);
+    if (READ_ONCE(sinkMode) != SINK_OFF)
+        return mySinkWrite(from);
 
-    // Check if write would exceed buffer size
-    if (*offset >= MAX_SIZE) {
-        pr_err("%s: Offset beyond buffer\n", __func__);
-        return -ENOSPC;
+    mutex_lock(&msgLock);
+    n = msgbuf_write_span(&msg, iocb->ki_pos, iov_iter_count(from));
+    if (n <= 0) {
+        mutex_unlock(&msgLock);
+        return n;
     }
 
-    // Limit write to remaining buffer space
-    bytes_to_write = min_t(size_t, len, MAX_SIZE - *offset);
-    if (bytes_to_write == 0) {
-        pr_err("%s: No space left in buffer\n", __func__);
-        return -ENOSPC;
-    }
+    while (done < n) {
+        loff_t pos = iocb->ki_pos + done;
+        size_t off = offset_in_page(pos);
+        size_t chunk = min_t(size_t, n - done, PAGE_SIZE - off);
+        struct page *page = myWritablePage(pos >> PAGE_SHIFT);
+        size_t copied;
 
-    // Copy data from user space
-    if (copy_from_user(kernel_buffer + *offset, user_buffer, bytes_to_write)) {
-        pr_err("%s: Failed to copy data from user\n", __func__);
-        return -EFAULT;
+        if (!page) {
+            err = -ENOMEM;
+            break;
+        }
+        copied = copy_page_from_iter(page, off, chunk, from);
+        done += copied;
+        if (copied < chunk) {
+            err = -EFAULT;
+            break;
+        }
     }
 
-    *offset += bytes_to_write;
+    iocb->ki_pos += done;
+    if (iocb->ki_pos > msg.len)
+        msg.len = iocb->ki_pos;
+    mutex_unlock(&msgLock);
+
+    return done ? done : err;
+}
+
+/*
+ * Pipe buffers pointing at our pages. They only hold a page reference;
+ * nobody may steal the page, and since these ops live in this module each
+ * buffer also pins the module until the pipe lets go of it.
+ */
+static void myPipeBufRelease(struct pipe_inode_info *pipe, struct pipe_buffer *buf) {
+    put_page(buf->page);
+    module_put(THIS_MODULE);
+}
 
-    // Update kernel_buffer_index if write extends valid data
-    if (*offset > kernel_buffer_index) {
-        kernel_buffer_index = *offset;
+static bool myPipeBufGet(struct pipe_inode_info *pipe, struct pipe_buffer *buf) {
+    if (!try_get_page(buf->page))
+        return false;
+    __module_get(THIS_MODULE);
+    return true;
+}
+
+static const struct pipe_buf_operations myPipeBufOps = {
+    .release = myPipeBufRelease,
+    .get = myPipeBufGet,
+};
+
+static void mySpliceRelease(struct splice_pipe_desc *spd, unsigned int i) {
+    put_page(spd->pages[i]);
+    module_put(THIS_MODULE);
+}
+
+/* read side of splice()/sendfile(): link buffer pages into the pipe, no copy */
+static ssize_t mySpliceRead(struct file *file, loff_t *ppos, struct pipe_inode_info *pipe,
+                            size_t len, unsigned int flags) {
+    struct page *pages[PIPE_DEF_BUFFERS];
+    struct partial_page partial[PIPE_DEF_BUFFERS];
+    struct splice_pipe_desc spd = {
+        .pages = pages,
+        .partial = partial,
+        .nr_pages_max = PIPE_DEF_BUFFERS,
+        .ops = &myPipeBufOps,
+        .spd_release = mySpliceRelease,
+    };
+    loff_t pos = *ppos;
+    size_t n;
+    ssize_t ret;
+
+    mutex_lock(&msgLock);
+    n = msgbuf_read_span(&msg, pos, len);
+    while (n && spd.nr_pages < PIPE_DEF_BUFFERS) {
+        size_t off = offset_in_page(pos);
+        size_t chunk = min_t(size_t, n, PAGE_SIZE - off);
+        struct page *page = bufferPages[pos >> PAGE_SHIFT];
+
+        get_page(page);
+        __module_get(THIS_MODULE);
+        pages[spd.nr_pages] = page;
+        partial[spd.nr_pages].offset = off;
+        partial[spd.nr_pages].len = chunk;
+        spd.nr_pages++;
+        pos += chunk;
+        n -= chunk;
     }
+    mutex_unlock(&msgLock);
+
+    if (!spd.nr_pages)
+        return 0;
 
-    pr_info("%s: Wrote %zd bytes, offset now %lld\n", __func__, bytes_to_write, *offset);
-    pr_info("%s: kernel_buffer content: %.*s\n", __func__, kernel_buffer_index, kernel_buffer);
-    return bytes_to_write;
+    /* pages the pipe had no room for come back through mySpliceRelease */
+    ret = splice_to_pipe(pipe, &spd);
+    if (ret > 0)
+        *ppos += ret;
+    return ret;
 }
 
 static int myRelease(struct inode *inode, struct file *file) {
@@ -109,56 +370,139 @@ static int myRelease(struct inode *inode, struct file *file) {
     return 0;
 }
 loff_t myLseek (struct file *file , loff_t offset , int whence){
-    loff_t new_pos;
-    pr_info("%s: Seek operation (whence=%d, offset=%lld)\n", __func__, whence, offset);
+    loff_t ret;
 
-    // Calculate new position based on whence
-    switch(whence){
-        case SEEK_SET:
-            new_pos = offset;
-            break;
-        case SEEK_CUR:
-            new_pos = file->f_pos  + offset;
-            break;
-        case SEEK_END:
-            new_pos = kernel_buffer_index + offset;
-            break;
-        default:
-            pr_err("%s: Invalid whence\n", __func__);
-            return -EINVAL;  // Safe: Invalid argument
-    }
-    // Prevent underflow: No negative positions
-    if (new_pos < 0) {
-        pr_err("%s: Seek to negative position\n", __func__);
-        return -EINVAL;
-    }
-    // Prevent overflow: Clamp to MAX_SIZE (allows writes at end)
-    if (new_pos > MAX_SIZE) {
-        pr_info("%s: Clamping seek beyond MAX_SIZE to %d\n", __func__, MAX_SIZE);
-        new_pos = MAX_SIZE;
-    }
-    file->f_pos = new_pos;
-    pr_info("%s: New position %lld\n", __func__, new_pos);
-    return new_pos;
+    mutex_lock(&msgLock);
+    ret = msgbuf_llseek(&msg, file, offset, whence);
+    mutex_unlock(&msgLock);
+    return ret;
 }
 
 static struct file_operations myF_ops = {
     .owner = THIS_MODULE,
     .open = myOpen,
-    .read = myRead,
-    .write = myWrite,
+    .read_iter = myReadIter,
+    .write_iter = myWriteIter,
+    .splice_read = mySpliceRead,
+    .splice_write = iter_file_splice_write,    /* pipe pages -> myWriteIter */
     .release = myRelease,
     .llseek = myLseek
 };
 
+/*
+ * /sys/class/myClass/<deviceName>/
+ *   sink           off (writes go to the buffer), xor or crc32c; writing resets the result
+ *   pin_threshold  sink writes of at least this many bytes are pinned, 0 = always copy
+ *   sink_stats     bytes written to the sink, how many were pinned/copied, the result
+ */
+static ssize_t sink_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    return sysfs_emit(buf, "%s\n", sinkNames[READ_ONCE(sinkMode)]);
+}
+
+static ssize_t sink_store(struct device *dev, struct device_attribute *attr,
+                          const char *buf, size_t count) {
+    int mode = sysfs_match_string(sinkNames, buf);
+
+    if (mode < 0)
+        return mode;
+
+    mutex_lock(&msgLock);
+    WRITE_ONCE(sinkMode, mode);
+    sinkResult = mode == SINK_CRC32C ? ~0U : 0;
+    sinkBytes = sinkPinnedBytes = sinkCopiedBytes = 0;
+    mutex_unlock(&msgLock);
+    return count;
+}
+static DEVICE_ATTR_RW(sink);
+
+static ssize_t pin_threshold_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    return sysfs_emit(buf, "%zu\n", READ_ONCE(pinThreshold));
+}
+
+static ssize_t pin_threshold_store(struct device *dev, struct device_attribute *attr,
+                                   const char *buf, size_t count) {
+    unsigned long val;
+    int ret;
+
+    ret = kstrtoul(buf, 0, &val);
+    if (ret)
+        return ret;
+    WRITE_ONCE(pinThreshold, val);
+    return count;
+}
+static DEVICE_ATTR_RW(pin_threshold);
+
+static ssize_t sink_stats_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    ssize_t len;
+
+    mutex_lock(&msgLock);
+    len = sysfs_emit(buf, "bytes=%llu pinned=%llu copied=%llu result=%#llx\n",
+                     sinkBytes, sinkPinnedBytes, sinkCopiedBytes, sinkResult);
+    mutex_unlock(&msgLock);
+    return len;
+}
+static DEVICE_ATTR_RO(sink_stats);
+
+static struct attribute *sink_attrs[] = {
+    &dev_attr_sink.attr,
+    &dev_attr_pin_threshold.attr,
+    &dev_attr_sink_stats.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(sink);
+
+static void myFreeBuffer(void) {
+    unsigned int i;
+
+    /* pages still in a pipe live on until the pipe drops them */
+    for (i = 0; bufferPages && i < nrBufferPages; i++)
+        if (bufferPages[i])
+            put_page(bufferPages[i]);
+    kfree(bufferPages);
+    kfree(sinkBounce);
+}
+
+static int myAllocBuffer(void) {
+    unsigned int i;
+
+    if (!bufferSize)
+        return -EINVAL;
+
+    nrBufferPages = DIV_ROUND_UP(bufferSize, PAGE_SIZE);
+    bufferPages = kcalloc(nrBufferPages, sizeof(*bufferPages), GFP_KERNEL);
+    sinkBounce = kmalloc(PAGE_SIZE, GFP_KERNEL);
+    if (!bufferPages || !sinkBounce) {
+        myFreeBuffer();
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < nrBufferPages; i++) {
+        bufferPages[i] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+        if (!bufferPages[i]) {
+            myFreeBuffer();
+            return -ENOMEM;
+        }
+    }
+
+    msgbuf_init(&msg, NULL, bufferSize);
+    return 0;
+}
+
 static int __init cdev_init_example_init(void) {
     int ret;
 
     pr_info("Initializing character device using cdev_init()\n");
 
+    ret = myAllocBuffer();
+    if (ret < 0) {
+        pr_err("Failed to allocate the message buffer\n");
+        return ret;
+    }
+
     ret = alloc_chrdev_region(&deviceNumber, baseNumber, count, deviceName);
     if (ret < 0) {
         pr_err("Failed to allocate device number\n");
+        myFreeBuffer();
         return ret;
     }
 
@@ -169,6 +513,7 @@ static int __init cdev_init_example_init(void) {
     if (ret < 0) {
         pr_err("Failed to add cdev\n");
         unregister_chrdev_region(deviceNumber, count);
+        myFreeBuffer();
         return ret;
     }
 
@@ -177,15 +522,18 @@ static int __init cdev_init_example_init(void) {
         pr_err("Failed to create class\n");
         cdev_del(&myCdev);
         unregister_chrdev_region(deviceNumber, count);
+        myFreeBuffer();
         return PTR_ERR(myClass);
     }
 
-    myDevice = device_create(myClass, NULL, deviceNumber, NULL, deviceName);
+    myDevice = device_create_with_groups(myClass, NULL, deviceNumber, NULL, sink_groups,
+                                         "%s", deviceName);
     if (IS_ERR(myDevice)) {
         pr_err("Failed to create device\n");
         class_destroy(myClass);
         cdev_del(&myCdev);
         unregister_chrdev_region(deviceNumber, count);
+        myFreeBuffer();
         return PTR_ERR(myDevice);
     }
 
@@ -208,6 +556,7 @@ static void __exit cdev_init_example_exit(void) {
 
     cdev_del(&myCdev);
     unregister_chrdev_region(deviceNumber, count);
+    myFreeBuffer();
 
     pr_info("Character device cleaned up successfully\n");
 }
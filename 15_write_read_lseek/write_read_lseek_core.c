@@ -0,0 +1,49 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include "chardev.h"
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Your Name");
+MODULE_DESCRIPTION("write_read_lseek on top of the shared chardev core");
+MODULE_VERSION("1.0");
+
+/*
+ * The same /dev/msg device as write_read_lseek.c, with registration, the
+ * buffer and the fops all coming from common/chardev.h. Both modules can be
+ * loaded side by side (different names), which is what bench_core.sh does.
+ */
+
+static char *deviceName = "msgcore";
+module_param(deviceName, charp, 0444);
+MODULE_PARM_DESC(deviceName, "Device name (also the class name)");
+
+static char *store = "array";
+module_param(store, charp, 0444);
+MODULE_PARM_DESC(store, "Storage backend: array, pages, ring or dgram");
+
+static unsigned int size = 1024;
+module_param(size, uint, 0444);
+MODULE_PARM_DESC(size, "Buffer size in bytes");
+
+static struct chardev msgDev;
+
+static int __init write_read_lseek_core_init(void) {
+    const struct chardev_store_ops *ops = chardev_store_find(store);
+
+    if (!ops) {
+        pr_err("%s: unknown store '%s'\n", __func__, store);
+        return -EINVAL;
+    }
+    if (!size)
+        return -EINVAL;
+
+    return chardev_register(&msgDev, deviceName, ops, size);
+}
+
+static void __exit write_read_lseek_core_exit(void) {
+    chardev_unregister(&msgDev);
+    pr_info("Character device cleaned up successfully\n");
+}
+
+module_init(write_read_lseek_core_init);
+module_exit(write_read_lseek_core_exit);
@@ -0,0 +1,246 @@
+/*
+ * bench_dgram.c - messages/s through /dev/my_misc_device for 16 B to 4 KiB
+ * messages, stream mode against datagram mode.
+ *
+ *   stream    what framed messages cost today: each message is written as
+ *             a __u16 length + payload, then the buffer is read back in
+ *             4 KiB read()s and the frames are cut out again in userspace,
+ *             carrying partial frames over from one read to the next
+ *   dgram     one write() per message, one read() per message
+ *   batch     one write() per message, MSG_IOCTL_READ_BATCH to read them
+ *
+ * Every round fills the device (buffer or queue) and empties it again,
+ * single threaded, and each message's length is checked on the way out.
+ * Give both modes the same room:
+ *
+ * gcc -O2 -o bench_dgram bench_dgram.c
+ * sudo insmod using_misc_driver_with_yours.ko bufferSize=65536 dgramFifoSize=65536
+ * sudo ./bench_dgram [seconds] [node]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include "ioctl_cmd.h"
+
+#define READ_CHUNK	4096
+#define BATCH_SIZE	(64 << 10)
+
+static const size_t sizes[] = { 16, 64, 256, 1024, 4096 };
+
+static double secs = 2;
+static unsigned long buffer_size;
+static char payload[4096];
+static char rbuf[BATCH_SIZE];
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(2);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void set_mode(int fd, int mode)
+{
+	if (ioctl(fd, MSG_IOCTL_SET_MODE, &mode))
+		die("MSG_IOCTL_SET_MODE");
+}
+
+static void check(size_t got, size_t want)
+{
+	if (got != want) {
+		fprintf(stderr, "message of %zu bytes, expected %zu\n", got, want);
+		exit(2);
+	}
+}
+
+/* one round in stream mode: write frames until full, read them back */
+static uint64_t stream_round(int fd, size_t size)
+{
+	size_t frame = MSG_BATCH_HDR + size;
+	size_t written = 0, have = 0, left;
+	uint64_t msgs = 0;
+	uint16_t len = size;
+	char hdr_frame[MSG_BATCH_HDR + sizeof(payload)];
+	char carry[MSG_BATCH_HDR + sizeof(payload)];
+	ssize_t n;
+
+	memcpy(hdr_frame, &len, MSG_BATCH_HDR);
+	memcpy(hdr_frame + MSG_BATCH_HDR, payload, size);
+
+	lseek(fd, 0, SEEK_SET);
+	while (written + frame <= buffer_size) {
+		if (write(fd, hdr_frame, frame) != (ssize_t)frame)
+			die("write (stream)");
+		written += frame;
+	}
+
+	lseek(fd, 0, SEEK_SET);
+	for (left = written; left; left -= n) {
+		char *p = rbuf, *end;
+
+		n = read(fd, rbuf, left < READ_CHUNK ? left : READ_CHUNK);
+		if (n <= 0)
+			die("read (stream)");
+		end = rbuf + n;
+
+		/* finish the frame cut by the previous read */
+		if (have) {
+			size_t need, take;
+
+			if (have < MSG_BATCH_HDR) {
+				take = MSG_BATCH_HDR - have;
+				take = take < (size_t)(end - p) ? take : (size_t)(end - p);
+				memcpy(carry + have, p, take);
+				have += take;
+				p += take;
+				if (have < MSG_BATCH_HDR)
+					continue;
+			}
+			memcpy(&len, carry, MSG_BATCH_HDR);
+			need = MSG_BATCH_HDR + len - have;
+			take = need < (size_t)(end - p) ? need : (size_t)(end - p);
+			memcpy(carry + have, p, take);
+			have += take;
+			p += take;
+			if (take < need)
+				continue;
+			check(len, size);
+			msgs++;
+			have = 0;
+		}
+
+		while (p < end) {
+			if (end - p < (ssize_t)MSG_BATCH_HDR) {
+				have = end - p;
+				memcpy(carry, p, have);
+				break;
+			}
+			memcpy(&len, p, MSG_BATCH_HDR);
+			if (end - p < (ssize_t)(MSG_BATCH_HDR + len)) {
+				have = end - p;
+				memcpy(carry, p, have);
+				break;
+			}
+			check(len, size);
+			p += MSG_BATCH_HDR + len;
+			msgs++;
+		}
+	}
+	return msgs;
+}
+
+/* queue messages until the driver says EAGAIN; returns how many */
+static uint64_t dgram_fill(int fd, size_t size)
+{
+	uint64_t msgs = 0;
+	ssize_t n;
+
+	while ((n = write(fd, payload, size)) == (ssize_t)size)
+		msgs++;
+	if (n >= 0 || errno != EAGAIN)
+		die("write (dgram)");
+	return msgs;
+}
+
+static uint64_t dgram_round(int fd, size_t size)
+{
+	uint64_t msgs = dgram_fill(fd, size), i;
+	ssize_t n;
+
+	for (i = 0; i < msgs; i++) {
+		n = read(fd, rbuf, sizeof(payload));
+		if (n < 0)
+			die("read (dgram)");
+		check(n, size);
+	}
+	if (read(fd, rbuf, sizeof(payload)) != 0)
+		die("queue not empty");
+	return msgs;
+}
+
+static uint64_t batch_round(int fd, size_t size)
+{
+	uint64_t msgs = dgram_fill(fd, size), got = 0;
+	struct msg_batch b = { .buf = (uintptr_t)rbuf, .size = sizeof(rbuf) };
+	uint16_t len;
+	uint32_t i, off;
+
+	while (got < msgs) {
+		if (ioctl(fd, MSG_IOCTL_READ_BATCH, &b))
+			die("MSG_IOCTL_READ_BATCH");
+		if (!b.count)
+			die("batch came back empty");
+		for (i = 0, off = 0; i < b.count; i++) {
+			memcpy(&len, rbuf + off, MSG_BATCH_HDR);
+			check(len, size);
+			off += MSG_BATCH_HDR + len;
+		}
+		got += b.count;
+	}
+	return msgs;
+}
+
+static double measure(int fd, size_t size, uint64_t (*round)(int, size_t))
+{
+	double t0 = now(), t;
+	uint64_t msgs = 0;
+
+	do {
+		msgs += round(fd, size);
+		t = now() - t0;
+	} while (t < secs);
+	return msgs / t;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *node = "/dev/my_misc_device";
+	double s, d, b;
+	unsigned int i;
+	int fd;
+
+	if (argc > 1)
+		secs = atof(argv[1]);
+	if (argc > 2)
+		node = argv[2];
+
+	fd = open(node, O_RDWR);
+	if (fd < 0)
+		die(node);
+	if (ioctl(fd, MSG_IOCTL_GET_LENGTH, &buffer_size))
+		die("MSG_IOCTL_GET_LENGTH");
+	memset(payload, 'm', sizeof(payload));
+
+	printf("%s: stream buffer %lu bytes, %.1f s per run\n", node, buffer_size, secs);
+	printf("%6s %12s %12s %12s %8s %8s\n", "size", "stream/s", "dgram/s", "batch/s",
+	       "dgram", "batch");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		if (MSG_BATCH_HDR + sizes[i] > buffer_size) {
+			printf("%6zu  skipped, frame larger than the stream buffer\n", sizes[i]);
+			continue;
+		}
+		set_mode(fd, MSG_MODE_STREAM);
+		s = measure(fd, sizes[i], stream_round);
+		set_mode(fd, MSG_MODE_DATAGRAM);
+		d = measure(fd, sizes[i], dgram_round);
+		b = measure(fd, sizes[i], batch_round);
+		printf("%6zu %12.0f %12.0f %12.0f %7.2fx %7.2fx\n", sizes[i], s, d, b, d / s, b / s);
+	}
+	set_mode(fd, MSG_MODE_STREAM);
+
+	close(fd);
+	return 0;
+}
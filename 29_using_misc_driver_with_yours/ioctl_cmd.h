@@ -1,6 +1,8 @@
 #ifndef __IOCTL_CMD_H
 #define __IOCTL_CMD_H
 
+#include <linux/types.h>
+
 #define MSG_MAGIC_NUMBER    0x21
 
 #define MSG_IOCTL_GET_LENGTH    _IOR(MSG_MAGIC_NUMBER, 1, unsigned int)
@@ -11,6 +13,26 @@
 
 #define MSG_GET_ADDRESS		_IOR(MSG_MAGIC_NUMBER, 4, unsigned long long)
 
-#define MSG_IOCTL_MAX_CMDS      4
+/* MSG_MODE_STREAM: one flat buffer (default). MSG_MODE_DATAGRAM: each
+ * write() queues one message, each read() returns exactly one. Switching
+ * starts the new mode empty: the buffer or queue of the old one is dropped. */
+#define MSG_MODE_STREAM         0
+#define MSG_MODE_DATAGRAM       1
+#define MSG_IOCTL_SET_MODE      _IOW(MSG_MAGIC_NUMBER, 5, int)
+
+/* Datagram mode: read up to 'max' messages (0 = as many as fit) into buf,
+ * each as a native-endian __u16 length followed by that many bytes, back
+ * to back. Same layout on 32 and 64 bit. */
+struct msg_batch {
+    __u64 buf;              /* in: user pointer */
+    __u32 size;             /* in: bytes at buf */
+    __u32 max;              /* in: message limit, 0 = none */
+    __u32 count;            /* out: messages returned */
+    __u32 bytes;            /* out: bytes of buf used */
+};
+#define MSG_BATCH_HDR           sizeof(__u16)
+#define MSG_IOCTL_READ_BATCH    _IOWR(MSG_MAGIC_NUMBER, 6, struct msg_batch)
+
+#define MSG_IOCTL_MAX_CMDS      6
 
 #endif
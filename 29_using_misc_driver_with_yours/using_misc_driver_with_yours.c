@@ -1,171 +1,133 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/fs.h>
-#include <linux/cdev.h>
-#include <linux/miscdevice.h>//to use miscdevice
+#include <linux/compat.h>
+#include "chardev.h"
 #include "ioctl_cmd.h"
 
 MODULE_LICENSE("GPL");
 
-char *device_name = "mydevice";
-module_param(device_name , charp , 0644);
-MODULE_PARM_DESC(device_name , "device_name  is string of the device name");
-
-int basecount = 0;
-module_param(basecount , int , 0644);
-MODULE_PARM_DESC(basecount, "Base minor number");
-
-int count = 1;
-module_param(count, int, 0644);
-MODULE_PARM_DESC(count, "Number of devices to create");
-
-dev_t device_number;
+#define MAX_SIZE        1024
+static unsigned int bufferSize = MAX_SIZE;
+module_param(bufferSize, uint, 0444);
+MODULE_PARM_DESC(bufferSize, "Stream mode buffer size in bytes");
 
-char * class_name = "myclass";
-struct class * myclass;
-struct device* mydevice;
-struct cdev  mycdev;
 /*
-struct cdev {
-	struct kobject kobj;
-	struct module *owner;
-	const struct file_operations *ops;
-	struct list_head list;
-	dev_t dev;
-	unsigned int count;
-}
-*/
+ * Stream mode is chardev.h's array store, datagram mode its dgram store: a
+ * queue of messages where write() queues one whole message and read()
+ * returns one (-EMSGSIZE, message left queued, if the buffer is too small).
+ * MSG_IOCTL_SET_MODE swaps one store for the other.
+ */
+static bool datagram;
+module_param(datagram, bool, 0444);
+MODULE_PARM_DESC(datagram, "Start in datagram mode (MSG_IOCTL_SET_MODE switches)");
 
+static unsigned int dgramFifoSize = 65536;
+module_param(dgramFifoSize, uint, 0444);
+MODULE_PARM_DESC(dgramFifoSize, "Datagram queue size in bytes, headers included");
 
-#define MAX_SIZE        1024
-char kernel_buffer[MAX_SIZE];
-int kernel_buffer_index;
+static struct chardev mydev;
 
-static int myOpen(struct inode *inode, struct file *file) {
+static int myOpen(struct chardev *cd, struct inode *inode, struct file *file) {
     pr_info("%s: Device opened\n", __func__);
-    file->f_pos = 0;
     return 0;
 }
 
-static ssize_t myRead(struct file *file, char __user *user_buffer, size_t user_lenght, loff_t *offset) {
-    ssize_t bytes_to_read;
-    //here the max is the kernel_buffer_index not the max , so replace the MAX_SIZE with kernel_buffer_index with the myWrite function
-    pr_info("%s: Read operation\n", __func__);
-
-    // Check if offset is beyond valid data
-    if (*offset >= kernel_buffer_index) {
-        pr_info("%s: No more data to read\n", __func__);
-        return 0; // EOF
-    }
-
-    // Limit read to available data
-    /*
-            <---kernel_index-offset----> kernel_index        MAX
-        |-----------------------------------|-----------------|
-
-        which min (user len , <max-offset>) to be number bytes_to_read
+static int myRelease(struct chardev *cd, struct inode *inode, struct file *file) {
+    pr_info("%s: Device closed\n", __func__);
+    return 0;
+}
 
-     */
-    bytes_to_read = min_t(size_t, user_lenght, kernel_buffer_index - *offset);
-    if (bytes_to_read == 0) {
-        pr_info("%s: No data available to read\n", __func__);
-        return 0;
-    }
+static long myIoctlSetMode(struct chardev *cd, unsigned long arg) {
+    int mode;
 
-    // Copy data to user space
-    if (copy_to_user(user_buffer, kernel_buffer + *offset, bytes_to_read)) {
-        pr_err("%s: Failed to copy data to user\n", __func__);
+    if (get_user(mode, (int __user *)arg))
         return -EFAULT;
-    }
-
-    *offset += bytes_to_read;
-
-    pr_info("%s: Read %zd bytes, offset now %lld\n", __func__, bytes_to_read, *offset);
-    return bytes_to_read;
+    if (mode == MSG_MODE_STREAM)
+        return chardev_set_store(cd, &chardev_store_array, bufferSize);
+    if (mode == MSG_MODE_DATAGRAM)
+        return chardev_set_store(cd, &chardev_store_dgram, dgramFifoSize);
+    return -EINVAL;
 }
 
-static ssize_t myWrite(struct file *file, const char __user *user_buffer, size_t user_lenght, loff_t *offset) {
-    ssize_t bytes_to_write;
+/* as many whole messages as fit into the caller's buffer, in one call */
+static long myIoctlReadBatch(struct chardev *cd, unsigned long arg) {
+    struct chardev_dgram *d;
+    struct msg_batch batch;
+    char __user *ubuf;
+    unsigned int used = 0, len, copied;
+    long ret = 0;
+    u16 hdr;
 
-    pr_info("%s: Write operation\n", __func__);
+    if (copy_from_user(&batch, (void __user *)arg, sizeof(batch)))
+        return -EFAULT;
+    ubuf = u64_to_user_ptr(batch.buf);
+    batch.count = 0;
 
-    // Check if write would exceed buffer size
-    if (*offset >= MAX_SIZE) {
-        pr_err("%s: Offset beyond buffer\n", __func__);
-        return -ENOSPC;
+    mutex_lock(&cd->lock);
+    if (cd->store != &chardev_store_dgram) {
+        mutex_unlock(&cd->lock);
+        return -EINVAL;
     }
-
-    // Limit write to remaining buffer space
-    /*
-            buffer_index
-        0    offset <-----max-offset----->  MAX_SIZE
-        |------|------------------------------|
-
-        which min (user_lenght , <max-offset>) to be number bytes_to_write
-     */
-    bytes_to_write = min_t(size_t, user_lenght, MAX_SIZE - *offset);
-    if (bytes_to_write == 0) {
-        pr_err("%s: No space left in buffer\n", __func__);
-        return -ENOSPC;
+    d = cd->priv;
+    while (!kfifo_is_empty(&d->fifo) && (!batch.max || batch.count < batch.max)) {
+        len = kfifo_peek_len(&d->fifo);
+        if (len + MSG_BATCH_HDR > batch.size - used) {
+            if (!batch.count)
+                ret = -EMSGSIZE;
+            break;
+        }
+        hdr = len;
+        if (copy_to_user(ubuf + used, &hdr, sizeof(hdr))) {
+            ret = -EFAULT;
+            break;
+        }
+        ret = kfifo_to_user(&d->fifo, ubuf + used + sizeof(hdr), len, &copied);
+        if (ret)
+            break;
+        used += sizeof(hdr) + len;
+        batch.count++;
     }
+    mutex_unlock(&cd->lock);
 
-    // Copy data from user space
-    if (copy_from_user(kernel_buffer + *offset, user_buffer, bytes_to_write)) {
-        pr_err("%s: Failed to copy data from user\n", __func__);
+    // a fault after some messages went out still reports those
+    if (ret && !batch.count)
+        return ret;
+    batch.bytes = used;
+    if (copy_to_user((void __user *)arg, &batch, sizeof(batch)))
         return -EFAULT;
-    }
-
-    *offset += bytes_to_write;
+    return 0;
+}
 
-    // Update kernel_buffer_index if write extends valid data
-    if (*offset > kernel_buffer_index) {
-        kernel_buffer_index = *offset;
-    }
+/* fill the stream buffer with one character; datagram mode has none */
+static long myIoctlFill(struct chardev *cd, unsigned long arg) {
+    struct msgbuf *mb;
+    unsigned char ch;
 
-    pr_info("%s: Wrote %zd bytes, offset now %lld\n", __func__, bytes_to_write, *offset);
-    pr_info("%s: kernel_buffer content: %.*s\n", __func__, kernel_buffer_index, kernel_buffer);
-    return bytes_to_write;
+    if (get_user(ch, (unsigned char __user *)arg))
+        return -EFAULT;
+    mutex_lock(&cd->lock);
+    mb = chardev_array_msgbuf(cd);
+    if (mb) {
+        memset(mb->data, ch, mb->size);
+        mb->len = mb->size - 1;
+    }
+    mutex_unlock(&cd->lock);
+    return mb ? 0 : -EINVAL;
 }
 
-static int myRelease(struct inode *inode, struct file *file) {
-    pr_info("%s: Device closed\n", __func__);
-    return 0;
-}
-loff_t myLseek (struct file *file , loff_t offset , int whence){
-    loff_t new_pos;
-    pr_info("%s: Seek operation (whence=%d, offset=%lld)\n", __func__, whence, offset);
+static long myIoctlGetAddress(struct chardev *cd, unsigned long arg) {
+    struct msgbuf *mb;
 
-    // Calculate new position based on whence
-    switch(whence){
-        case SEEK_SET:
-            new_pos = offset;
-            break;
-        case SEEK_CUR:
-            new_pos = file->f_pos  + offset;
-            break;
-        case SEEK_END:
-            new_pos = kernel_buffer_index + offset;
-            break;
-        default:
-            pr_err("%s: Invalid whence\n", __func__);
-            return -EINVAL;  // Safe: Invalid argument
-    }
-    // Prevent underflow: No negative positions
-    if (new_pos < 0) {
-        pr_err("%s: Seek to negative position\n", __func__);
+    mutex_lock(&cd->lock);
+    mb = chardev_array_msgbuf(cd);
+    mutex_unlock(&cd->lock);
+    if (!mb)
         return -EINVAL;
-    }
-    // Prevent overflow: Clamp to MAX_SIZE (allows writes at end)
-    if (new_pos > MAX_SIZE) {
-        pr_info("%s: Clamping seek beyond MAX_SIZE to %d\n", __func__, MAX_SIZE);
-        new_pos = MAX_SIZE;
-    }
-    file->f_pos = new_pos;
-    pr_info("%s: New position %lld\n", __func__, new_pos);
-    return new_pos;
+    return put_user((unsigned long)mb->data, (unsigned long __user *)arg);
 }
-long myioctl (struct file *, unsigned int cmd, unsigned long arg){
-    unsigned char ch;
+
+static long myioctl(struct chardev *cd, unsigned int cmd, unsigned long arg){
     int returnValue;
     long size;
     pr_info("%s: Cmd:%u\t Arg:%lu\n", __func__, cmd, arg);
@@ -187,30 +149,30 @@ long myioctl (struct file *, unsigned int cmd, unsigned long arg){
 		//Get Length of buffer
         case MSG_IOCTL_GET_LENGTH:
             pr_info("Get Length of buffer\n");
-            if (put_user(MAX_SIZE, (unsigned long *)arg)) {
+            if (put_user(bufferSize, (unsigned long *)arg)) {
                 pr_err("Failed to copy data to user\n");
                 return -EFAULT;
             }
             break;
-		//clear buffer
+		//clear buffer (or the datagram queue)
 		case MSG_IOCTL_CLEAR_BUFFER:
             pr_info("clear buffer\n");
-            memset(kernel_buffer , 0 , sizeof(kernel_buffer));
-            kernel_buffer_index=0;
+            chardev_clear(cd);
 			break;
 		//fill character
 		case MSG_IOCTL_FILL_BUFFER:
             pr_info("fill character\n");
-            get_user(ch , (unsigned char *)arg);
-            memset(kernel_buffer , ch , sizeof(kernel_buffer));
-            kernel_buffer_index = MAX_SIZE-1;
-			break;
+            return myIoctlFill(cd, arg);
             //address of kernel buffer
         case MSG_GET_ADDRESS:
             pr_info("address of kernel buffer\n");
-            //put_user(&kernel_buffer , (unsigned long long* )arg);
-            put_user((unsigned long)kernel_buffer, (unsigned long __user *)arg);
-			break;
+            return myIoctlGetAddress(cd, arg);
+		//stream or datagram mode
+		case MSG_IOCTL_SET_MODE:
+			return myIoctlSetMode(cd, arg);
+		//several datagrams in one call
+		case MSG_IOCTL_READ_BATCH:
+			return myIoctlReadBatch(cd, arg);
 		default:
 			pr_info("Unknown Command:%u\n", cmd);
 			return -ENOTTY;
@@ -218,71 +180,12 @@ long myioctl (struct file *, unsigned int cmd, unsigned long arg){
 	return 0;
 }
 
-long myioctl32bit (struct file * file, unsigned int cmd, unsigned long arg){
-        unsigned char ch;
-    int returnValue;
-    long size;
+/* every argument is a pointer or has the same layout on 32 and 64 bit */
+static long myioctl32bit(struct chardev *cd, unsigned int cmd, unsigned long arg){
     pr_info("%s 32bit: Cmd:%u\t Arg:%lu\n", __func__, cmd, arg);
-    if(_IOC_TYPE(cmd) !=MSG_MAGIC_NUMBER){
-        return  -ENOTTY;
-    }
-    if(_IOC_NR(cmd) > MSG_IOCTL_MAX_CMDS){
-        return  -ENOTTY;
-    }
-    size= _IOC_SIZE(cmd);
-    returnValue = access_ok( ( void __user * ) arg , size);
-
-    pr_info("access_ok returned:%d\n", returnValue);
-	if (!returnValue){
-		return -EFAULT;
-    }
-	switch(cmd)
-	{
-		//Get Length of buffer
-        case MSG_IOCTL_GET_LENGTH:
-            pr_info("Get Length of buffer\n");
-            if (put_user(MAX_SIZE, (unsigned long *)arg)) {
-                pr_err("Failed to copy data to user\n");
-                return -EFAULT;
-            }
-            break;
-		//clear buffer
-		case MSG_IOCTL_CLEAR_BUFFER:
-            pr_info("clear buffer\n");
-            memset(kernel_buffer , 0 , sizeof(kernel_buffer));
-            kernel_buffer_index=0;
-			break;
-		//fill character
-		case MSG_IOCTL_FILL_BUFFER:
-            pr_info("fill character\n");
-            get_user(ch , (unsigned char *)arg);
-            memset(kernel_buffer , ch , sizeof(kernel_buffer));
-            kernel_buffer_index = MAX_SIZE-1;
-			break;
-            //address of kernel buffer
-        case MSG_GET_ADDRESS:
-            pr_info("address of kernel buffer\n");
-            //put_user(&kernel_buffer , (unsigned long long* )arg);
-            put_user((unsigned long)kernel_buffer, (unsigned long __user *)arg);
-			break;
-		default:
-			pr_info("Unknown Command:%u\n", cmd);
-			return -ENOTTY;
-	}
-	return 0;
+    return myioctl(cd, cmd, (unsigned long)compat_ptr(arg));
 }
 
-static struct file_operations myfops = {
-    .owner = THIS_MODULE,
-    .open = myOpen,
-    .read = myRead,
-    .write = myWrite,
-    .release = myRelease,
-    .llseek = myLseek,
-    .unlocked_ioctl=myioctl,
-    .compat_ioctl = myioctl32bit
-};
-
 
 /*
 struct miscdevice  {
@@ -296,21 +199,8 @@ struct miscdevice  {
 	const char *nodename;
 	umode_t mode;
 };
- */
-
-static struct miscdevice my_misc_device = {
-    .minor = MISC_DYNAMIC_MINOR,//to allocate minor number dynamicaly
-    //.minor = 150 ,             //to allocate minor number statically
-    .name = "my_misc_device",
-    .fops = &myfops,
-    .mode = 0666, // Permissions for /dev/my_misc_device
-};
-
-
-/*
- 1-allocate major , minor number
- 2-create class with information for device file
- 3-create the device file by using class
+ chardev_register_misc() fills mydev.misc: a dynamic minor, name
+ "my_misc_device", chardev_fops, and mydev.mode as the node permissions.
  */
 
 int multiple_device_init(void){
@@ -324,14 +214,28 @@ int multiple_device_init(void){
 
     int returnValue;
     pr_info("Initializing character device using misc_driver\n");
-    returnValue = misc_register(&my_misc_device);
+
+    if (!bufferSize || !dgramFifoSize)
+        return -EINVAL;
+
+    mydev.mode = 0666; // Permissions for /dev/my_misc_device
+    mydev.open = myOpen;
+    mydev.release = myRelease;
+    mydev.ioctl = myioctl;
+    mydev.compat_ioctl = myioctl32bit;
+    if (datagram)
+        returnValue = chardev_register_misc(&mydev, "my_misc_device", &chardev_store_dgram,
+                                            dgramFifoSize);
+    else
+        returnValue = chardev_register_misc(&mydev, "my_misc_device", &chardev_store_array,
+                                            bufferSize);
     if (returnValue != 0){ // we check on true on Failed
-        pr_err("Couldn't register device misc, %d.\n", my_misc_device.minor);
-		return -EBUSY;
+        pr_err("Couldn't register device misc, %d.\n", returnValue);
+		return returnValue;
 
     }
     pr_info("MISC Major number of Character device:%d\n" , MISC_MAJOR);
-    pr_info("driver Minor number of Character device:%d\n" , my_misc_device.minor);
+    pr_info("driver Minor number of Character device:%d\n" , mydev.misc.minor);
     pr_info("Character device initialized successfully\n");
     pr_info("Succeeded in registering character device %s\n", "my_misc_device");
 
@@ -339,7 +243,7 @@ int multiple_device_init(void){
 }
 void multiple_device_exit(void){
     pr_info("device unregistered character device\n");
-    misc_deregister(&my_misc_device);
+    chardev_unregister(&mydev);
     pr_info("device unregistered successfully\n");
 
 }
@@ -5,6 +5,10 @@
 #include <linux/device.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <linux/mutex.h>
+#include <linux/crc32c.h>
+#include <linux/log2.h>
+#include "pseudo_ioctl.h"
 
 struct pseudo_platform_data {
     int buffer_size;
@@ -19,8 +23,37 @@ struct pseudo_driver_data {
     struct cdev cdev;        // char device
     struct class *class;     // device class (shared)
     struct device *device;   // device node (/dev/..)
+
+    /* integrity mode, see pseudo_ioctl.h and sysfs below */
+    struct mutex lock;       // buffer + checksums
+    int integrity;           // PSEUDO_INTEGRITY_*
+    unsigned int block_size; // bytes per checksum
+    unsigned int nr_blocks;
+    u32 *crcs;               // one CRC32C per block, room for the smallest block size
+    unsigned int crc_errors;
 };
 
+#define PSEUDO_MIN_BLOCK     4
+#define PSEUDO_DEFAULT_BLOCK 32
+
+static u32 pseudo_block_crc(struct pseudo_driver_data *drvdata, unsigned int block)
+{
+    unsigned int start = block * drvdata->block_size;
+    unsigned int len = min_t(unsigned int, drvdata->block_size, drvdata->buffer_size - start);
+
+    return ~crc32c(~0, drvdata->buffer + start, len);
+}
+
+/* checksum the whole buffer, after a mode or block size change (lock held) */
+static void pseudo_rehash(struct pseudo_driver_data *drvdata)
+{
+    unsigned int i;
+
+    drvdata->nr_blocks = DIV_ROUND_UP(drvdata->buffer_size, drvdata->block_size);
+    for (i = 0; i < drvdata->nr_blocks; i++)
+        drvdata->crcs[i] = pseudo_block_crc(drvdata, i);
+}
+
 /* File ops */
 static int pseudo_open(struct inode *inode, struct file *file)
 {
@@ -43,44 +76,253 @@ static ssize_t pseudo_read(struct file *file, char __user *buf, size_t count, lo
 {
     struct pseudo_driver_data *drvdata = file->private_data;
     size_t to_copy;
+    ssize_t ret;
 
     if (*ppos >= drvdata->buffer_size)
         return 0;
 
     to_copy = min(count, (size_t)(drvdata->buffer_size - *ppos));
+    /* a zero-length read touches no block, so there is nothing to verify */
+    if (!to_copy)
+        return 0;
 
-    if (copy_to_user(buf, drvdata->buffer + *ppos, to_copy))
-        return -EFAULT;
+    mutex_lock(&drvdata->lock);
+
+    /* verify every block the read touches before handing any of it out */
+    if (drvdata->integrity == PSEUDO_INTEGRITY_VERIFY) {
+        /* both ends are below buffer_size: 32 bit division, no __aeabi_ldivmod */
+        unsigned int b = (unsigned int)*ppos / drvdata->block_size;
+        unsigned int last = (unsigned int)(*ppos + to_copy - 1) / drvdata->block_size;
+
+        for (; b <= last; b++) {
+            if (pseudo_block_crc(drvdata, b) != drvdata->crcs[b]) {
+                drvdata->crc_errors++;
+                dev_warn_ratelimited(drvdata->device, "CRC mismatch in block %u\n", b);
+                ret = -EBADMSG;
+                goto out;
+            }
+        }
+    }
+
+    if (copy_to_user(buf, drvdata->buffer + *ppos, to_copy)) {
+        ret = -EFAULT;
+        goto out;
+    }
 
     *ppos += to_copy;
-    return to_copy;
+    ret = to_copy;
+out:
+    mutex_unlock(&drvdata->lock);
+    return ret;
 }
 
 static ssize_t pseudo_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
 {
     struct pseudo_driver_data *drvdata = file->private_data;
     size_t to_copy;
+    loff_t pos, end;
+    ssize_t ret = 0;
 
     if (*ppos >= drvdata->buffer_size)
         return -ENOSPC;
 
     to_copy = min(count, (size_t)(drvdata->buffer_size - *ppos));
 
-    if (copy_from_user(drvdata->buffer + *ppos, buf, to_copy))
-        return -EFAULT;
+    mutex_lock(&drvdata->lock);
+
+    if (drvdata->integrity == PSEUDO_INTEGRITY_OFF) {
+        if (copy_from_user(drvdata->buffer + *ppos, buf, to_copy))
+            ret = -EFAULT;
+        goto out;
+    }
+
+    /*
+     * Copy block by block and checksum each block right after its copy,
+     * while it is still in cache. A block only partly covered by the
+     * write is checksummed whole, old bytes included.
+     */
+    for (pos = *ppos, end = *ppos + to_copy; pos < end; ) {
+        unsigned int b = (unsigned int)pos / drvdata->block_size;
+        loff_t block_end = min_t(loff_t, (loff_t)(b + 1) * drvdata->block_size, end);
+        unsigned long left;
+
+        left = copy_from_user(drvdata->buffer + pos, buf + (pos - *ppos), block_end - pos);
+        drvdata->crcs[b] = pseudo_block_crc(drvdata, b);
+        if (left) {
+            ret = -EFAULT;
+            break;
+        }
+        pos = block_end;
+    }
+
+out:
+    mutex_unlock(&drvdata->lock);
+    if (ret)
+        return ret;
 
     *ppos += to_copy;
     return to_copy;
 }
 
+static long pseudo_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct pseudo_driver_data *drvdata = file->private_data;
+    struct pseudo_crc_query q;
+    u32 __user *ucrcs;
+    long ret = 0;
+
+    if (cmd != PSEUDO_IOCTL_GET_CRCS)
+        return -ENOTTY;
+    if (copy_from_user(&q, (void __user *)arg, sizeof(q)))
+        return -EFAULT;
+    ucrcs = u64_to_user_ptr(q.crcs);
+
+    mutex_lock(&drvdata->lock);
+    q.block_size = drvdata->block_size;
+    q.nr_blocks = drvdata->nr_blocks;
+    q.mode = drvdata->integrity;
+    q.crc_errors = drvdata->crc_errors;
+
+    if (q.mode == PSEUDO_INTEGRITY_OFF || q.first >= q.nr_blocks)
+        q.count = 0;
+    else
+        q.count = min(q.count, q.nr_blocks - q.first);
+    if (q.count && copy_to_user(ucrcs, drvdata->crcs + q.first, q.count * sizeof(u32)))
+        ret = -EFAULT;
+    mutex_unlock(&drvdata->lock);
+
+    if (!ret && copy_to_user((void __user *)arg, &q, sizeof(q)))
+        ret = -EFAULT;
+    return ret;
+}
+
 static const struct file_operations pseudo_fops = {
     .owner   = THIS_MODULE,
     .open    = pseudo_open,
     .release = pseudo_release,
     .read    = pseudo_read,
     .write   = pseudo_write,
+    .unlocked_ioctl = pseudo_ioctl,
 };
 
+/*
+ * sysfs, in /sys/class/pseudo_class/<device_name>/:
+ *   integrity        off | crc | verify
+ *   integrity_block  bytes per checksum (power of two, >= 4)
+ *   checksums        one CRC32C per block, hex, one per line
+ *   crc_errors       reads refused by verify
+ *   corrupt          write an offset to flip that byte behind the checksum's back (testing)
+ */
+static const char * const pseudo_integrity_names[] = { "off", "crc", "verify" };
+
+static ssize_t integrity_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct pseudo_driver_data *drvdata = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%s\n", pseudo_integrity_names[drvdata->integrity]);
+}
+
+static ssize_t integrity_store(struct device *dev, struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+    struct pseudo_driver_data *drvdata = dev_get_drvdata(dev);
+    int mode = sysfs_match_string(pseudo_integrity_names, buf);
+
+    if (mode < 0)
+        return mode;
+
+    mutex_lock(&drvdata->lock);
+    /* coming from off, the buffer has no checksums yet */
+    if (drvdata->integrity == PSEUDO_INTEGRITY_OFF && mode != PSEUDO_INTEGRITY_OFF)
+        pseudo_rehash(drvdata);
+    drvdata->integrity = mode;
+    drvdata->crc_errors = 0;
+    mutex_unlock(&drvdata->lock);
+    return count;
+}
+static DEVICE_ATTR_RW(integrity);
+
+static ssize_t integrity_block_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct pseudo_driver_data *drvdata = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", drvdata->block_size);
+}
+
+static ssize_t integrity_block_store(struct device *dev, struct device_attribute *attr,
+                                     const char *buf, size_t count)
+{
+    struct pseudo_driver_data *drvdata = dev_get_drvdata(dev);
+    unsigned int val;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &val);
+    if (ret)
+        return ret;
+    if (val < PSEUDO_MIN_BLOCK || !is_power_of_2(val))
+        return -EINVAL;
+
+    mutex_lock(&drvdata->lock);
+    drvdata->block_size = val;
+    pseudo_rehash(drvdata);
+    mutex_unlock(&drvdata->lock);
+    return count;
+}
+static DEVICE_ATTR_RW(integrity_block);
+
+static ssize_t checksums_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct pseudo_driver_data *drvdata = dev_get_drvdata(dev);
+    ssize_t len = 0;
+    unsigned int i;
+
+    mutex_lock(&drvdata->lock);
+    if (drvdata->integrity != PSEUDO_INTEGRITY_OFF)
+        for (i = 0; i < drvdata->nr_blocks; i++)
+            len += sysfs_emit_at(buf, len, "%08x\n", drvdata->crcs[i]);
+    mutex_unlock(&drvdata->lock);
+    return len;
+}
+static DEVICE_ATTR_RO(checksums);
+
+static ssize_t crc_errors_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct pseudo_driver_data *drvdata = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(drvdata->crc_errors));
+}
+static DEVICE_ATTR_RO(crc_errors);
+
+static ssize_t corrupt_store(struct device *dev, struct device_attribute *attr,
+                             const char *buf, size_t count)
+{
+    struct pseudo_driver_data *drvdata = dev_get_drvdata(dev);
+    unsigned int off;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &off);
+    if (ret)
+        return ret;
+    if (off >= drvdata->buffer_size)
+        return -EINVAL;
+
+    mutex_lock(&drvdata->lock);
+    drvdata->buffer[off] ^= 0xff;
+    mutex_unlock(&drvdata->lock);
+    return count;
+}
+static DEVICE_ATTR_WO(corrupt);
+
+static struct attribute *pseudo_attrs[] = {
+    &dev_attr_integrity.attr,
+    &dev_attr_integrity_block.attr,
+    &dev_attr_checksums.attr,
+    &dev_attr_crc_errors.attr,
+    &dev_attr_corrupt.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(pseudo);
+
 /* Probe */
 static int pseudo_probe(struct platform_device *pdev)
 {
@@ -101,6 +343,16 @@ static int pseudo_probe(struct platform_device *pdev)
     if (!drvdata->buffer)
         return -ENOMEM;
 
+    mutex_init(&drvdata->lock);
+    drvdata->integrity = PSEUDO_INTEGRITY_OFF;
+    drvdata->block_size = PSEUDO_DEFAULT_BLOCK;
+    drvdata->nr_blocks = DIV_ROUND_UP(drvdata->buffer_size, drvdata->block_size);
+    drvdata->crcs = devm_kcalloc(&pdev->dev,
+                                 DIV_ROUND_UP(drvdata->buffer_size, PSEUDO_MIN_BLOCK),
+                                 sizeof(u32), GFP_KERNEL);
+    if (!drvdata->crcs)
+        return -ENOMEM;
+
     /* Allocate device number */
     ret = alloc_chrdev_region(&drvdata->devt, 0, 1, pdata->device_name);
     if (ret < 0) {
@@ -132,9 +384,10 @@ static int pseudo_probe(struct platform_device *pdev)
     drvdata->class = pseudo_class;
 
     /* Create /dev entry */
-    drvdata->device = device_create(drvdata->class, NULL,
-                                    drvdata->devt, NULL,
-                                    pdata->device_name);
+    drvdata->device = device_create_with_groups(drvdata->class, NULL,
+                                                drvdata->devt, drvdata,
+                                                pseudo_groups, "%s",
+                                                pdata->device_name);
     if (IS_ERR(drvdata->device)) {
         pr_err("Pseudo driver: device_create failed\n");
         cdev_del(&drvdata->cdev);
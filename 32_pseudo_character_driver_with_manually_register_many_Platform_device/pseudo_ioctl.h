@@ -0,0 +1,30 @@
+#ifndef __PSEUDO_IOCTL_H
+#define __PSEUDO_IOCTL_H
+
+#include <linux/types.h>
+
+#define PSEUDO_MAGIC_NUMBER     'P'
+
+/* integrity modes, also the words accepted by sysfs "integrity" */
+#define PSEUDO_INTEGRITY_OFF    0       /* no checksums */
+#define PSEUDO_INTEGRITY_CRC    1       /* CRC32C per block, updated by write() */
+#define PSEUDO_INTEGRITY_VERIFY 2       /* and read() fails with EBADMSG on a mismatch */
+
+/*
+ * Per-block CRC32C of the device buffer. Block i covers bytes
+ * [i * block_size, (i + 1) * block_size), the last one may be shorter.
+ * The CRC is the standard one (seed and final xor ~0).
+ */
+struct pseudo_crc_query {
+    __u32 first;            /* in: first block */
+    __u32 count;            /* in: room at crcs; out: CRCs returned */
+    __u64 crcs;             /* in: user pointer to __u32[count] */
+    __u32 block_size;       /* out */
+    __u32 nr_blocks;        /* out */
+    __u32 mode;             /* out: PSEUDO_INTEGRITY_* */
+    __u32 crc_errors;       /* out: reads refused since the mode was set */
+};
+
+#define PSEUDO_IOCTL_GET_CRCS   _IOWR(PSEUDO_MAGIC_NUMBER, 1, struct pseudo_crc_query)
+
+#endif
@@ -0,0 +1,66 @@
+#!/bin/sh
+# Apply/remove a generated overlay with many pseudo nodes in a loop and
+# print the hot-plug latency histogram collected by pseudo_driver.ko.
+#
+# Needs: dtc, configfs overlays (CONFIG_OF_OVERLAY + CONFIG_OF_CONFIGFS),
+# debugfs mounted, pseudo_driver.ko loaded. Works fine under QEMU virt.
+#
+#   sudo ./overlay_latency_test.sh [nodes] [loops]
+
+NODES=${1:-100}
+LOOPS=${2:-20}
+WORK=$(mktemp -d)
+OVL=/sys/kernel/config/device-tree/overlays/pseudo_lat
+DBG=/sys/kernel/debug/pseudo_hotplug
+
+# 1. Generate the overlay
+{
+    echo "/dts-v1/;"
+    echo "/plugin/;"
+    echo "/ {"
+    echo "    fragment@0 {"
+    echo "        target-path = \"/\";"
+    echo "        __overlay__ {"
+    i=0
+    while [ $i -lt $NODES ]; do
+        echo "            pseudo@$i {"
+        echo "                compatible = \"myvendor,pseudo\";"
+        echo "                label = \"Device$i\";"
+        echo "                some-value = <$i>;"
+        echo "            };"
+        i=$((i + 1))
+    done
+    echo "        };"
+    echo "    };"
+    echo "};"
+} > $WORK/lat.dts
+
+dtc -@ -I dts -O dtb -o $WORK/lat.dtbo $WORK/lat.dts || exit 1
+
+# 2. Apply / remove in a loop
+# The base DT may have pseudo nodes of its own: only count what the overlay adds
+nr_nodes() {
+    ls /dev/pseudo* 2>/dev/null | wc -l
+}
+BASE=$(nr_nodes)
+
+echo 1 > $DBG/reset
+l=0
+while [ $l -lt $LOOPS ]; do
+    mkdir $OVL
+    cat $WORK/lat.dtbo > $OVL/dtbo
+    # wait until udev has created every node
+    while [ $(nr_nodes) -lt $((BASE + NODES)) ]; do
+        sleep 0.01
+    done
+    rmdir $OVL
+    # and until they are all gone again, or the next wait sees stale nodes
+    while [ $(nr_nodes) -gt $BASE ]; do
+        sleep 0.01
+    done
+    l=$((l + 1))
+done
+
+# 3. Report (p50/p99 are upper bounds of the log2 bucket)
+cat $DBG/latency
+rm -rf $WORK
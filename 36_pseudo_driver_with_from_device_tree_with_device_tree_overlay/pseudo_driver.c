@@ -5,6 +5,189 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+
+/*
+ * Hot-plug latency instrumentation
+ * --------------------------------
+ * When an overlay is applied, the OF core fires OF_RECONFIG_ATTACH_NODE
+ * for every new node *before* the platform_device is created. We stamp
+ * that moment, then stamp probe entry, misc_register() return (cdev is
+ * live and the KOBJ_ADD uevent has been sent by device_add()) and probe
+ * exit. Each stage goes into a log2(us) histogram in debugfs:
+ *
+ *   /sys/kernel/debug/pseudo_hotplug/latency   (read: histogram + p50/p99)
+ *   /sys/kernel/debug/pseudo_hotplug/reset     (write anything: clear)
+ */
+#define PSEUDO_HIST_BUCKETS 32
+
+enum pseudo_stage {
+    STAGE_NOTIFY_TO_PROBE,   // OF notifier  -> probe entry
+    STAGE_PROBE_TO_CDEV,     // probe entry  -> misc_register() done (cdev + uevent)
+    STAGE_PROBE,             // probe entry  -> probe exit
+    STAGE_NOTIFY_TO_REMOVE,  // OF detach    -> remove() done
+    STAGE_MAX,
+};
+
+static const char * const pseudo_stage_names[STAGE_MAX] = {
+    "notify_to_probe",
+    "probe_to_cdev_uevent",
+    "probe",
+    "detach_to_remove",
+};
+
+struct pseudo_hist {
+    u64 buckets[PSEUDO_HIST_BUCKETS];  // bucket i: [2^i, 2^(i+1)) us, bucket 0 also holds < 1us
+    u64 count;
+    u64 sum_us;
+    u64 max_us;
+};
+
+static struct pseudo_hist pseudo_hists[STAGE_MAX];
+static DEFINE_SPINLOCK(pseudo_hist_lock);
+
+/* OF notifier timestamps waiting for their probe()/remove() */
+struct pseudo_pending {
+    struct list_head node;
+    struct device_node *np;
+    ktime_t stamp;
+    bool detach;
+};
+
+static LIST_HEAD(pseudo_pending_list);
+static struct dentry *pseudo_debugfs_dir;
+
+static void pseudo_hist_add(enum pseudo_stage stage, ktime_t start, ktime_t end)
+{
+    struct pseudo_hist *h = &pseudo_hists[stage];
+    u64 us = ktime_us_delta(end, start);
+    int idx = us ? min_t(int, ilog2(us), PSEUDO_HIST_BUCKETS - 1) : 0;
+
+    spin_lock(&pseudo_hist_lock);
+    h->buckets[idx]++;
+    h->count++;
+    h->sum_us += us;
+    if (us > h->max_us)
+        h->max_us = us;
+    spin_unlock(&pseudo_hist_lock);
+}
+
+/* Take (and forget) the notifier timestamp recorded for @np, if any */
+static bool pseudo_pending_take(struct device_node *np, bool detach, ktime_t *stamp)
+{
+    struct pseudo_pending *p, *tmp;
+    bool found = false;
+
+    spin_lock(&pseudo_hist_lock);
+    list_for_each_entry_safe(p, tmp, &pseudo_pending_list, node) {
+        if (p->np == np && p->detach == detach) {
+            *stamp = p->stamp;
+            list_del(&p->node);
+            of_node_put(p->np);
+            kfree(p);
+            found = true;
+            break;
+        }
+    }
+    spin_unlock(&pseudo_hist_lock);
+    return found;
+}
+
+static int pseudo_of_notify(struct notifier_block *nb, unsigned long action, void *arg)
+{
+    struct of_reconfig_data *rd = arg;
+    struct pseudo_pending *p;
+    ktime_t now = ktime_get();
+
+    if (action != OF_RECONFIG_ATTACH_NODE && action != OF_RECONFIG_DETACH_NODE)
+        return NOTIFY_DONE;
+    if (!of_device_is_compatible(rd->dn, "myvendor,pseudo"))
+        return NOTIFY_DONE;
+
+    p = kzalloc(sizeof(*p), GFP_KERNEL);
+    if (!p)
+        return NOTIFY_DONE;
+
+    p->np = of_node_get(rd->dn);
+    p->stamp = now;
+    p->detach = (action == OF_RECONFIG_DETACH_NODE);
+
+    spin_lock(&pseudo_hist_lock);
+    list_add_tail(&p->node, &pseudo_pending_list);
+    spin_unlock(&pseudo_hist_lock);
+    return NOTIFY_OK;
+}
+
+/* Run before of_platform_notify() (priority 0), which creates the device and probes it */
+static struct notifier_block pseudo_of_nb = {
+    .notifier_call = pseudo_of_notify,
+    .priority = 1,
+};
+
+/* Percentile from the log2 histogram: reports the upper bound of the bucket */
+static u64 pseudo_hist_percentile(const struct pseudo_hist *h, unsigned int pct)
+{
+    u64 target, seen = 0;
+    int i;
+
+    if (!h->count)
+        return 0;
+
+    target = div_u64(h->count * pct + 99, 100);
+    for (i = 0; i < PSEUDO_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= target)
+            return 1ULL << (i + 1);
+    }
+    return h->max_us;
+}
+
+static int latency_show(struct seq_file *s, void *unused)
+{
+    struct pseudo_hist snap[STAGE_MAX];
+    int stage, i;
+
+    spin_lock(&pseudo_hist_lock);
+    memcpy(snap, pseudo_hists, sizeof(snap));
+    spin_unlock(&pseudo_hist_lock);
+
+    for (stage = 0; stage < STAGE_MAX; stage++) {
+        struct pseudo_hist *h = &snap[stage];
+
+        seq_printf(s, "%s: count=%llu avg_us=%llu p50_us<=%llu p99_us<=%llu max_us=%llu\n",
+                   pseudo_stage_names[stage], h->count,
+                   h->count ? div64_u64(h->sum_us, h->count) : 0,
+                   pseudo_hist_percentile(h, 50),
+                   pseudo_hist_percentile(h, 99),
+                   h->max_us);
+        for (i = 0; i < PSEUDO_HIST_BUCKETS; i++) {
+            if (h->buckets[i])
+                seq_printf(s, "  [%10llu, %10llu) us: %llu\n",
+                           i ? 1ULL << i : 0ULL, 1ULL << (i + 1), h->buckets[i]);
+        }
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(latency);
+
+static ssize_t reset_write(struct file *file, const char __user *buf,
+                           size_t count, loff_t *ppos)
+{
+    spin_lock(&pseudo_hist_lock);
+    memset(pseudo_hists, 0, sizeof(pseudo_hists));
+    spin_unlock(&pseudo_hist_lock);
+    return count;
+}
+
+static const struct file_operations reset_fops = {
+    .owner = THIS_MODULE,
+    .write = reset_write,
+};
 
 struct pseudo_platform_data {
     int some_value;
@@ -86,8 +269,13 @@ static int pseudo_probe(struct platform_device *pdev)
     const char *label;
     u32 value;
     static int dev_idx;  // create unique /dev names
+    ktime_t t_probe = ktime_get();
+    ktime_t t_notify, t_cdev;
+    bool have_notify;
     int ret;
 
+    have_notify = pseudo_pending_take(pdev->dev.of_node, false, &t_notify);
+
     pr_info("pseudo: probe for node %pOF\n", pdev->dev.of_node);
 
     /* Allocate memory for device */
@@ -106,7 +294,9 @@ static int pseudo_probe(struct platform_device *pdev)
 
     /* Setup miscdevice (/dev/pseudoX) */
     priv->miscdev.minor = MISC_DYNAMIC_MINOR;
-    priv->miscdev.name = kasprintf(GFP_KERNEL, "pseudo%d", dev_idx++);
+    priv->miscdev.name = devm_kasprintf(&pdev->dev, GFP_KERNEL, "pseudo%d", dev_idx++);
+    if (!priv->miscdev.name)
+        return -ENOMEM;
     priv->miscdev.fops = &pseudo_fops;
 
     ret = misc_register(&priv->miscdev);
@@ -114,18 +304,31 @@ static int pseudo_probe(struct platform_device *pdev)
         pr_err("pseudo: failed to register misc device\n");
         return ret;
     }
+    /* misc_register() -> device_create() has added the cdev and sent KOBJ_ADD */
+    t_cdev = ktime_get();
 
     platform_set_drvdata(pdev, priv);
     pr_info("pseudo: registered %s as /dev/%s\n",
             priv->pdata.label, priv->miscdev.name);
+
+    pseudo_hist_add(STAGE_PROBE_TO_CDEV, t_probe, t_cdev);
+    pseudo_hist_add(STAGE_PROBE, t_probe, ktime_get());
+    if (have_notify) {
+        pseudo_hist_add(STAGE_NOTIFY_TO_PROBE, t_notify, t_probe);
+    }
     return 0;
 }
 
 static int pseudo_remove(struct platform_device *pdev)
 {
     struct pseudo_dev *priv = platform_get_drvdata(pdev);
+    ktime_t t_detach;
+
     misc_deregister(&priv->miscdev);
     pr_info("pseudo: removed /dev/%s\n", priv->miscdev.name);
+
+    if (pseudo_pending_take(pdev->dev.of_node, true, &t_detach))
+        pseudo_hist_add(STAGE_NOTIFY_TO_REMOVE, t_detach, ktime_get());
     return 0;
 }
 
@@ -138,7 +341,49 @@ static struct platform_driver pseudo_driver = {
     .remove = pseudo_remove,
 };
 
-module_platform_driver(pseudo_driver);
+static int __init pseudo_init(void)
+{
+    int ret;
+
+    pseudo_debugfs_dir = debugfs_create_dir("pseudo_hotplug", NULL);
+    debugfs_create_file("latency", 0444, pseudo_debugfs_dir, NULL, &latency_fops);
+    debugfs_create_file("reset", 0200, pseudo_debugfs_dir, NULL, &reset_fops);
+
+    ret = of_reconfig_notifier_register(&pseudo_of_nb);
+    if (ret) {
+        pr_err("pseudo: failed to register OF notifier\n");
+        goto err_debugfs;
+    }
+
+    ret = platform_driver_register(&pseudo_driver);
+    if (ret)
+        goto err_notifier;
+    return 0;
+
+err_notifier:
+    of_reconfig_notifier_unregister(&pseudo_of_nb);
+err_debugfs:
+    debugfs_remove_recursive(pseudo_debugfs_dir);
+    return ret;
+}
+
+static void __exit pseudo_exit(void)
+{
+    struct pseudo_pending *p, *tmp;
+
+    platform_driver_unregister(&pseudo_driver);
+    of_reconfig_notifier_unregister(&pseudo_of_nb);
+    debugfs_remove_recursive(pseudo_debugfs_dir);
+
+    list_for_each_entry_safe(p, tmp, &pseudo_pending_list, node) {
+        list_del(&p->node);
+        of_node_put(p->np);
+        kfree(p);
+    }
+}
+
+module_init(pseudo_init);
+module_exit(pseudo_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("You");
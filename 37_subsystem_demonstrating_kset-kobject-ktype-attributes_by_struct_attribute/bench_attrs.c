@@ -0,0 +1,83 @@
+/*
+ * bench_attrs.c - read every text attribute of every kobject under
+ * /sys/kernel/my_devices, the way a monitoring agent scrapes sysfs.
+ *
+ * gcc -O2 -o bench_attrs bench_attrs.c
+ * sudo insmod my_devices.ko nr_bench_devs=10000
+ * ./bench_attrs [passes]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+
+#define ROOT "/sys/kernel/my_devices"
+
+static const char * const attrs[] = { "status", "value", "chunk_index" };
+#define NR_ATTRS (sizeof(attrs) / sizeof(attrs[0]))
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	int passes = argc > 1 ? atoi(argv[1]) : 5;
+	char **paths = NULL;
+	size_t nr_paths = 0, i;
+	struct dirent *de;
+	char buf[4096];
+	double t0, t;
+	DIR *dir;
+	int p;
+
+	dir = opendir(ROOT);
+	if (!dir) {
+		perror(ROOT);
+		return 2;
+	}
+	while ((de = readdir(dir))) {
+		size_t a;
+
+		if (de->d_name[0] == '.')
+			continue;
+		paths = realloc(paths, (nr_paths + NR_ATTRS) * sizeof(*paths));
+		for (a = 0; a < NR_ATTRS; a++) {
+			paths[nr_paths] = malloc(strlen(ROOT) + strlen(de->d_name) + 32);
+			sprintf(paths[nr_paths++], ROOT "/%s/%s", de->d_name, attrs[a]);
+		}
+	}
+	closedir(dir);
+
+	printf("%zu kobjects, %zu attributes, %d passes\n",
+	       nr_paths / NR_ATTRS, nr_paths, passes);
+
+	t0 = now_sec();
+	for (p = 0; p < passes; p++) {
+		for (i = 0; i < nr_paths; i++) {
+			int fd = open(paths[i], O_RDONLY);
+
+			if (fd < 0 || read(fd, buf, sizeof(buf)) < 0) {
+				perror(paths[i]);
+				return 2;
+			}
+			close(fd);
+		}
+	}
+	t = now_sec() - t0;
+
+	printf("%.3f s/pass, %.0f reads/s, %.0f ns/read (open+read+close)\n",
+	       t / passes, nr_paths * passes / t, t * 1e9 / (nr_paths * passes));
+
+	for (i = 0; i < nr_paths; i++)
+		free(paths[i]);
+	free(paths);
+	return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * bench_dyn.c - create/destroy rate and memory cost of the dynamic
+ * kobjects behind /sys/kernel/my_devices/{create,destroy,count}.
+ *
+ * gcc -O2 -o bench_dyn bench_dyn.c
+ * sudo insmod my_devices.ko
+ * sudo ./bench_dyn [max_objects]      (default 100000)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#define ROOT "/sys/kernel/my_devices"
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void write_attr(const char *name, const char *val)
+{
+	int fd = open(name, O_WRONLY);
+
+	if (fd < 0 || write(fd, val, strlen(val)) < 0) {
+		perror(name);
+		exit(2);
+	}
+	close(fd);
+}
+
+/* kernel memory in use, in kB: MemTotal - MemAvailable */
+static long mem_used_kb(void)
+{
+	long total = 0, avail = 0, v;
+	char key[64];
+	FILE *f = fopen("/proc/meminfo", "r");
+
+	while (fscanf(f, "%63s %ld kB\n", key, &v) == 2) {
+		if (!strcmp(key, "MemTotal:"))
+			total = v;
+		else if (!strcmp(key, "MemAvailable:"))
+			avail = v;
+	}
+	fclose(f);
+	return total - avail;
+}
+
+int main(int argc, char *argv[])
+{
+	long max = argc > 1 ? atol(argv[1]) : 100000;
+	long n;
+
+	printf("%10s %14s %14s %12s\n", "objects", "create obj/s", "destroy obj/s", "bytes/obj");
+	for (n = 100; n <= max; n *= 10) {
+		char val[32];
+		long before, after;
+		double t0, tc, td;
+
+		write_attr(ROOT "/destroy", "all");
+		sync();
+		before = mem_used_kb();
+
+		snprintf(val, sizeof(val), "%ld", n);
+		t0 = now_sec();
+		write_attr(ROOT "/create", val);
+		tc = now_sec() - t0;
+
+		after = mem_used_kb();
+
+		t0 = now_sec();
+		write_attr(ROOT "/destroy", "all");
+		td = now_sec() - t0;
+
+		printf("%10ld %14.0f %14.0f %12.0f\n", n, n / tc, n / td,
+		       (after - before) * 1024.0 / n);
+	}
+	return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * bench_scrape.c - compare scraping the device state buffer through
+ * the text attributes (chunk_index + chunk, one hex page at a time)
+ * against the "buffer" binary attribute (pread and mmap).
+ *
+ * gcc -O2 -o bench_scrape bench_scrape.c
+ * sudo ./bench_scrape /sys/kernel/my_devices/dev1 [iterations]
+ * (also works with /sys/class/my_devices/dev1 from example 38)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int hexval(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	return c - 'a' + 10;
+}
+
+/* text: write chunk_index, read chunk, decode hex - until chunk is empty */
+static size_t scrape_text(const char *dir, unsigned char *out, size_t size)
+{
+	char path[256], idx[32], *page;
+	int fd_idx, fd_chunk;
+	size_t got = 0;
+	unsigned int i;
+	long pagesz = sysconf(_SC_PAGESIZE);
+
+	page = malloc(pagesz);
+	snprintf(path, sizeof(path), "%s/chunk_index", dir);
+	fd_idx = open(path, O_WRONLY);
+	snprintf(path, sizeof(path), "%s/chunk", dir);
+	fd_chunk = open(path, O_RDONLY);
+	if (fd_idx < 0 || fd_chunk < 0) {
+		perror("open text attributes");
+		exit(2);
+	}
+
+	for (i = 0; got < size; i++) {
+		ssize_t n, j;
+
+		snprintf(idx, sizeof(idx), "%u", i);
+		if (pwrite(fd_idx, idx, strlen(idx), 0) < 0) {
+			perror("chunk_index");
+			exit(2);
+		}
+		n = pread(fd_chunk, page, pagesz, 0);
+		if (n <= 1)
+			break;
+		n = (n - 1) / 2;	/* strip '\n', two hex digits per byte */
+		for (j = 0; j < n && got < size; j++)
+			out[got++] = hexval(page[2 * j]) << 4 | hexval(page[2 * j + 1]);
+	}
+	close(fd_idx);
+	close(fd_chunk);
+	free(page);
+	return got;
+}
+
+/* binary: big pread()s at increasing offsets */
+static size_t scrape_bin(const char *dir, unsigned char *out, size_t size)
+{
+	char path[256];
+	size_t got = 0;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/buffer", dir);
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror("open buffer");
+		exit(2);
+	}
+	while (got < size) {
+		ssize_t n = pread(fd, out + got, size - got, got);
+
+		if (n <= 0)
+			break;
+		got += n;
+	}
+	close(fd);
+	return got;
+}
+
+/* binary + mmap: one memcpy out of the shared mapping */
+static size_t scrape_mmap(const char *dir, unsigned char *out, size_t size)
+{
+	char path[256];
+	void *map;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/buffer", dir);
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror("open buffer");
+		exit(2);
+	}
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap buffer");
+		exit(2);
+	}
+	memcpy(out, map, size);
+	munmap(map, size);
+	close(fd);
+	return size;
+}
+
+int main(int argc, char *argv[])
+{
+	struct {
+		const char *name;
+		size_t (*fn)(const char *, unsigned char *, size_t);
+	} modes[] = {
+		{ "text (chunk)", scrape_text },
+		{ "bin (pread)", scrape_bin },
+		{ "bin (mmap)", scrape_mmap },
+	};
+	unsigned char *ref, *out;
+	const char *dir;
+	char path[256];
+	struct stat st;
+	size_t size;
+	int iters, m, i;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <sysfs dev dir> [iterations]\n", argv[0]);
+		return 1;
+	}
+	dir = argv[1];
+	iters = argc > 2 ? atoi(argv[2]) : 10;
+
+	/* sysfs reports the bin_attribute size as the file size */
+	snprintf(path, sizeof(path), "%s/buffer", dir);
+	if (stat(path, &st) < 0) {
+		perror("stat buffer");
+		return 2;
+	}
+	size = st.st_size;
+	ref = malloc(size);
+	out = malloc(size);
+	scrape_bin(dir, ref, size);
+
+	printf("state size: %zu bytes, %d iterations\n", size, iters);
+	for (m = 0; m < 3; m++) {
+		double t0, t;
+		size_t got = 0;
+
+		t0 = now_sec();
+		for (i = 0; i < iters; i++)
+			got = modes[m].fn(dir, out, size);
+		t = (now_sec() - t0) / iters;
+
+		printf("%-14s %9.3f ms/scrape %9.1f MiB/s %s\n", modes[m].name,
+		       t * 1e3, size / t / (1 << 20),
+		       got == size && !memcmp(ref, out, size) ? "ok" : "MISMATCH");
+	}
+	free(ref);
+	free(out);
+	return 0;
+}
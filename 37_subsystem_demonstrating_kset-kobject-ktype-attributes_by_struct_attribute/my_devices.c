@@ -6,22 +6,146 @@
 #include <linux/slab.h>
 #include <linux/sysfs.h>
 #include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/xarray.h>
+#include <linux/atomic.h>
+#include <linux/mutex.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Example Author");
 MODULE_DESCRIPTION("Toy subsystem demonstrating kset -> kobject -> ktype -> attributes");
 MODULE_VERSION("0.1");
 
+/* size of the per-device state buffer exported through the "buffer" bin attribute */
+static unsigned int buf_size = SZ_1M;
+module_param(buf_size, uint, 0444);
+MODULE_PARM_DESC(buf_size, "Size in bytes of each device's state buffer (default 1 MiB)");
+
+/* a text attribute can only return one page, so "chunk" shows the buffer in hex slices */
+#define TEXT_CHUNK_BYTES ((PAGE_SIZE - 1) / 2)
+
 struct my_dev {
     struct kobject kobj;
     int value;
     char status[16];
+    u32 id;                   /* index in my_dyn_devs (dynamic kobjects only) */
+    u8 *buffer;               /* vmalloc_user() so it can be mmap'ed */
+    unsigned int chunk_index; /* which TEXT_CHUNK_BYTES slice "chunk" shows */
+    struct kernfs_node *value_kn; /* cached "value" node for change notification */
+};
+
+/* ---------- helper: container_of to map kobject -> my_dev ---------- */
+static inline struct my_dev *to_my_dev(struct kobject *kobj)
+{
+    return container_of(kobj, struct my_dev, kobj);
+}
+
+/*
+ * Typed attribute: each attribute carries its own show/store, so the
+ * generic sysfs_ops below is one container_of() + one indirect call
+ * instead of a strcmp() chain over every attribute name.
+ */
+struct my_attribute {
+    struct attribute attr;
+    ssize_t (*show)(struct my_dev *mdev, struct my_attribute *attr, char *buf);
+    ssize_t (*store)(struct my_dev *mdev, struct my_attribute *attr,
+                     const char *buf, size_t count);
 };
+#define to_my_attr(a) container_of(a, struct my_attribute, attr)
+
+/* expect <name>_show / <name>_store, like DEVICE_ATTR_RO/RW */
+#define MY_ATTR_RO(_name) \
+    static struct my_attribute my_attr_##_name = __ATTR_RO(_name)
+#define MY_ATTR_RW(_name) \
+    static struct my_attribute my_attr_##_name = __ATTR_RW(_name)
+
+/* ---------- per-attribute show/store implementations ---------- */
+static ssize_t status_show(struct my_dev *mdev, struct my_attribute *attr, char *buf)
+{
+    return scnprintf(buf, PAGE_SIZE, "%s\n", mdev->status);
+}
+MY_ATTR_RO(status);
+
+static ssize_t value_show(struct my_dev *mdev, struct my_attribute *attr, char *buf)
+{
+    return scnprintf(buf, PAGE_SIZE, "%d\n", mdev->value);
+}
+
+static ssize_t value_store(struct my_dev *mdev, struct my_attribute *attr,
+                           const char *buf, size_t count)
+{
+    long v;
+    int ret;
+
+    ret = kstrtol(buf, 0, &v);
+    if (ret)
+        return ret;
+
+    /* wake poll(POLLPRI)/select(exceptfds) waiters only on a real change */
+    if (mdev->value != (int)v) {
+        mdev->value = (int)v;
+        if (mdev->value_kn)
+            sysfs_notify_dirent(mdev->value_kn);
+    }
+    return count;
+}
+MY_ATTR_RW(value);
+
+static ssize_t chunk_index_show(struct my_dev *mdev, struct my_attribute *attr, char *buf)
+{
+    return scnprintf(buf, PAGE_SIZE, "%u\n", mdev->chunk_index);
+}
+
+static ssize_t chunk_index_store(struct my_dev *mdev, struct my_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    unsigned int idx;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &idx);
+    if (ret)
+        return ret;
+    mdev->chunk_index = idx;
+    return count;
+}
+MY_ATTR_RW(chunk_index);
+
+static ssize_t chunk_show(struct my_dev *mdev, struct my_attribute *attr, char *buf)
+{
+    size_t off = (size_t)mdev->chunk_index * TEXT_CHUNK_BYTES;
+    size_t len;
+
+    if (!mdev->buffer || off >= buf_size)
+        return 0;
+    len = min_t(size_t, TEXT_CHUNK_BYTES, buf_size - off);
+    bin2hex(buf, mdev->buffer + off, len);
+    buf[len * 2] = '\n';
+    return len * 2 + 1;
+}
+MY_ATTR_RO(chunk);
+
+/* ---------- generic sysfs_ops: dispatch to the typed attribute ---------- */
+static ssize_t my_show(struct kobject *kobj, struct attribute *attr, char *buf)
+{
+    struct my_attribute *my_attr = to_my_attr(attr);
+
+    if (!my_attr->show)
+        return -EIO;
+    return my_attr->show(to_my_dev(kobj), my_attr, buf);
+}
 
-/* forward declarations */
-static ssize_t my_show(struct kobject *kobj, struct attribute *attr, char *buf);
 static ssize_t my_store(struct kobject *kobj, struct attribute *attr,
-                        const char *buf, size_t count);
+                        const char *buf, size_t count)
+{
+    struct my_attribute *my_attr = to_my_attr(attr);
+
+    /* read-only attribute */
+    if (!my_attr->store)
+        return -EIO;
+    return my_attr->store(to_my_dev(kobj), my_attr, buf, count);
+}
+
 static void my_release(struct kobject *kobj);
 
 /* sysfs ops */
@@ -30,19 +154,12 @@ static const struct sysfs_ops my_sysfs_ops = {
     .store = my_store,
 };
 
-/* attributes: status (ro), value (rw) */
-static struct attribute attr_status = {
-    .name = "status",
-    .mode = 0444,
-};
-static struct attribute attr_value = {
-    .name = "value",
-    .mode = 0644,
-};
-
+/* attributes: status (ro), value (rw), chunk_index (rw), chunk (ro) */
 static struct attribute *my_default_attrs[] = {
-    &attr_status,
-    &attr_value,
+    &my_attr_status.attr,
+    &my_attr_value.attr,
+    &my_attr_chunk_index.attr,
+    &my_attr_chunk.attr,
     NULL,
 };
 
@@ -59,54 +176,268 @@ static struct kset *my_kset;
 static struct my_dev *dev1;
 static struct my_dev *dev2;
 
-/* ---------- helper: container_of to map kobject -> my_dev ---------- */
-static inline struct my_dev *to_my_dev(struct kobject *kobj)
+/*
+ * Dynamically created attribute-only kobjects (no state buffer), named
+ * <prefix><id> and indexed by id in an allocating xarray for O(1) lookup.
+ * nr_bench_devs of them ("benchN") are created at load time; more can be
+ * created/destroyed at runtime through the kset's "create"/"destroy" files.
+ */
+static unsigned int nr_bench_devs;
+module_param(nr_bench_devs, uint, 0444);
+MODULE_PARM_DESC(nr_bench_devs, "Number of extra benchN kobjects to create (default 0)");
+
+static DEFINE_XARRAY_ALLOC(my_dyn_devs);
+static atomic_t my_dyn_count = ATOMIC_INIT(0);
+
+/* upper bound for one "create" write (and for nr_bench_devs) */
+#define MY_DYN_MAX_CREATE 1000000
+
+/*
+ * Serialises create against destroy: between xa_alloc() and xa_store() the
+ * id is a reserved NULL slot, and an xa_erase() from destroy in that window
+ * would free the id for reuse while the kobject for it is still being added.
+ */
+static DEFINE_MUTEX(my_dyn_lock);
+
+/* ---------- binary attribute: whole state buffer ---------- */
+/*
+ * sysfs already clamps off/count against attr->size, so read/write are a
+ * plain memcpy at the requested offset - no text formatting, no PAGE_SIZE
+ * splitting on our side.
+ */
+static ssize_t buffer_read(struct file *filp, struct kobject *kobj,
+                           struct bin_attribute *attr,
+                           char *buf, loff_t off, size_t count)
 {
-    return container_of(kobj, struct my_dev, kobj);
+    struct my_dev *mdev = to_my_dev(kobj);
+
+    memcpy(buf, mdev->buffer + off, count);
+    return count;
 }
 
-/* ---------- sysfs show/store implementations ---------- */
-static ssize_t my_show(struct kobject *kobj, struct attribute *attr, char *buf)
+static ssize_t buffer_write(struct file *filp, struct kobject *kobj,
+                            struct bin_attribute *attr,
+                            char *buf, loff_t off, size_t count)
 {
     struct my_dev *mdev = to_my_dev(kobj);
 
-    if (strcmp(attr->name, "status") == 0) {
-        return scnprintf(buf, PAGE_SIZE, "%s\n", mdev->status);
-    } else if (strcmp(attr->name, "value") == 0) {
-        return scnprintf(buf, PAGE_SIZE, "%d\n", mdev->value);
-    }
-
-    /* unknown attribute */
-    return -EIO;
+    memcpy(mdev->buffer + off, buf, count);
+    return count;
 }
 
-static ssize_t my_store(struct kobject *kobj, struct attribute *attr,
-                        const char *buf, size_t count)
+static int buffer_mmap(struct file *filp, struct kobject *kobj,
+                       struct bin_attribute *attr,
+                       struct vm_area_struct *vma)
 {
     struct my_dev *mdev = to_my_dev(kobj);
-    long v;
-    int ret;
 
-    if (strcmp(attr->name, "value") == 0) {
-        ret = kstrtol(buf, 0, &v);
-        if (ret)
-            return ret;
-        mdev->value = (int)v;
-        return count;
-    }
-
-    /* read-only or unknown attribute */
-    return -EIO;
+    /* checks that the requested range fits inside the vmalloc area */
+    return remap_vmalloc_range(vma, mdev->buffer, vma->vm_pgoff);
 }
 
+/* .size is filled in at init time from buf_size */
+static struct bin_attribute bin_attr_buffer = {
+    .attr  = { .name = "buffer", .mode = 0644 },
+    .read  = buffer_read,
+    .write = buffer_write,
+    .mmap  = buffer_mmap,
+};
+
 /* ---------- release ---------- */
 static void my_release(struct kobject *kobj)
 {
     struct my_dev *mdev = to_my_dev(kobj);
-    pr_info("my_devices: releasing %s\n", kobject_name(kobj));
+    /* pr_debug: thousands of dynamic kobjects may be released at once */
+    pr_debug("my_devices: releasing %s\n", kobject_name(kobj));
+    sysfs_put(mdev->value_kn);
+    vfree(mdev->buffer);
     kfree(mdev);
 }
 
+/* allocate the state buffer and fill it with a recognisable pattern */
+static int my_dev_alloc_buffer(struct my_dev *mdev)
+{
+    unsigned int i;
+
+    mdev->buffer = vmalloc_user(PAGE_ALIGN(buf_size));
+    if (!mdev->buffer)
+        return -ENOMEM;
+
+    for (i = 0; i < buf_size; i++)
+        mdev->buffer[i] = (u8)(i + mdev->value);
+    return 0;
+}
+
+/* ---------- dynamic kobjects ---------- */
+/*
+ * Per-object uevents are not sent: udev would get one event per kobject,
+ * which turns a 100k-object create into an event storm. Instead each batch
+ * sends a single KOBJ_CHANGE on the kset carrying ACTION_BATCH/FIRST/COUNT.
+ */
+static void my_dyn_batch_uevent(const char *action, u32 first, u32 count)
+{
+    char action_env[32], first_env[32], count_env[32];
+    char *envp[] = { action_env, first_env, count_env, NULL };
+
+    if (!count)
+        return;
+    snprintf(action_env, sizeof(action_env), "ACTION_BATCH=%s", action);
+    snprintf(first_env, sizeof(first_env), "FIRST=%u", first);
+    snprintf(count_env, sizeof(count_env), "COUNT=%u", count);
+    kobject_uevent_env(&my_kset->kobj, KOBJ_CHANGE, envp);
+}
+
+static struct my_dev *my_dyn_create(const char *prefix)
+{
+    struct my_dev *mdev;
+    int ret;
+
+    mdev = kzalloc(sizeof(*mdev), GFP_KERNEL);
+    if (!mdev)
+        return ERR_PTR(-ENOMEM);
+    strscpy(mdev->status, "OK", sizeof(mdev->status));
+
+    mutex_lock(&my_dyn_lock);
+    /* reserve the id first so it can be part of the name */
+    ret = xa_alloc(&my_dyn_devs, &mdev->id, NULL, xa_limit_31b, GFP_KERNEL);
+    if (ret) {
+        mutex_unlock(&my_dyn_lock);
+        kfree(mdev);
+        return ERR_PTR(ret);
+    }
+    mdev->value = mdev->id;
+
+    ret = kobject_init_and_add(&mdev->kobj, &my_ktype, &my_kset->kobj,
+                               "%s%u", prefix, mdev->id);
+    if (ret) {
+        xa_erase(&my_dyn_devs, mdev->id);
+        mutex_unlock(&my_dyn_lock);
+        kobject_put(&mdev->kobj);
+        return ERR_PTR(ret);
+    }
+    mdev->value_kn = sysfs_get_dirent(mdev->kobj.sd, "value");
+
+    /* publish: the reserved NULL slot becomes visible to lookups */
+    xa_store(&my_dyn_devs, mdev->id, mdev, GFP_KERNEL);
+    atomic_inc(&my_dyn_count);
+    mutex_unlock(&my_dyn_lock);
+    return mdev;
+}
+
+/* create @count objects; returns how many were created, or an error if none */
+static int my_dyn_create_many(const char *prefix, unsigned int count)
+{
+    struct my_dev *mdev;
+    u32 first = 0;
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        mdev = my_dyn_create(prefix);
+        if (IS_ERR(mdev)) {
+            pr_err("my_devices: failed to create %s object: %ld\n",
+                   prefix, PTR_ERR(mdev));
+            if (!i)
+                return PTR_ERR(mdev);
+            break;
+        }
+        if (!i)
+            first = mdev->id;
+        cond_resched();
+    }
+    my_dyn_batch_uevent("create", first, i);
+    return i;
+}
+
+static bool my_dyn_destroy(u32 id)
+{
+    struct my_dev *mdev;
+
+    mutex_lock(&my_dyn_lock);
+    /* a reserved slot reads back as NULL, but must not be erased */
+    mdev = xa_load(&my_dyn_devs, id);
+    if (mdev)
+        xa_erase(&my_dyn_devs, id);
+    mutex_unlock(&my_dyn_lock);
+
+    if (!mdev)
+        return false;
+    atomic_dec(&my_dyn_count);
+    kobject_put(&mdev->kobj);
+    return true;
+}
+
+static unsigned int my_dyn_destroy_all(void)
+{
+    struct my_dev *mdev;
+    unsigned long id;
+    unsigned int n = 0;
+
+    xa_for_each(&my_dyn_devs, id, mdev) {
+        if (my_dyn_destroy(id))
+            n++;
+        cond_resched();
+    }
+    return n;
+}
+
+/*
+ * Control files on the kset itself (/sys/kernel/my_devices/). The kset's
+ * ktype uses kobj_sysfs_ops, so these are plain kobj_attributes.
+ *   create  : write N     -> create N "objID" kobjects, N <= MY_DYN_MAX_CREATE
+ *   destroy : write ID    -> destroy that kobject, "all" -> destroy every one
+ *   count   : number of dynamic kobjects alive
+ */
+static ssize_t create_store(struct kobject *kobj, struct kobj_attribute *attr,
+                            const char *buf, size_t count)
+{
+    unsigned int n;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &n);
+    if (ret)
+        return ret;
+    if (n > MY_DYN_MAX_CREATE)
+        return -E2BIG;
+    ret = my_dyn_create_many("obj", n);
+    return ret < 0 ? ret : count;
+}
+static struct kobj_attribute create_attr = __ATTR_WO(create);
+
+static ssize_t destroy_store(struct kobject *kobj, struct kobj_attribute *attr,
+                             const char *buf, size_t count)
+{
+    u32 id;
+
+    if (sysfs_streq(buf, "all")) {
+        my_dyn_batch_uevent("destroy", 0, my_dyn_destroy_all());
+        return count;
+    }
+    if (kstrtou32(buf, 0, &id))
+        return -EINVAL;
+    if (!my_dyn_destroy(id))
+        return -ENOENT;
+    my_dyn_batch_uevent("destroy", id, 1);
+    return count;
+}
+static struct kobj_attribute destroy_attr = __ATTR_WO(destroy);
+
+static ssize_t count_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+    return scnprintf(buf, PAGE_SIZE, "%d\n", atomic_read(&my_dyn_count));
+}
+static struct kobj_attribute count_attr = __ATTR_RO(count);
+
+static struct attribute *my_kset_attrs[] = {
+    &create_attr.attr,
+    &destroy_attr.attr,
+    &count_attr.attr,
+    NULL,
+};
+
+static const struct attribute_group my_kset_group = {
+    .attrs = my_kset_attrs,
+};
+
 /* ---------- module init/exit ---------- */
 static int __init my_module_init(void)
 {
@@ -114,6 +445,10 @@ static int __init my_module_init(void)
 
     pr_info("my_devices: init\n");
 
+    if (!buf_size || nr_bench_devs > MY_DYN_MAX_CREATE)
+        return -EINVAL;
+    bin_attr_buffer.size = buf_size;
+
     /* create a kset under /sys/kernel by passing kernel_kobj as parent
      * It will create: /sys/kernel/my_devices
      * If you want it under /sys/class instead, use kset_create_and_add("my_devices", NULL, NULL)
@@ -141,6 +476,17 @@ static int __init my_module_init(void)
         dev1 = NULL;
         goto err_free_kset;
     }
+    dev1->value_kn = sysfs_get_dirent(dev1->kobj.sd, "value");
+
+    ret = my_dev_alloc_buffer(dev1);
+    if (!ret)
+        ret = sysfs_create_bin_file(&dev1->kobj, &bin_attr_buffer);
+    if (ret) {
+        pr_err("my_devices: failed to add dev1 buffer: %d\n", ret);
+        kobject_put(&dev1->kobj);
+        dev1 = NULL;
+        goto err_free_kset;
+    }
     kobject_uevent(&dev1->kobj, KOBJ_ADD);
 
     /* allocate and initialize dev2 */
@@ -159,11 +505,37 @@ static int __init my_module_init(void)
         dev2 = NULL;
         goto err_put_dev1;
     }
+    dev2->value_kn = sysfs_get_dirent(dev2->kobj.sd, "value");
+
+    ret = my_dev_alloc_buffer(dev2);
+    if (!ret)
+        ret = sysfs_create_bin_file(&dev2->kobj, &bin_attr_buffer);
+    if (ret) {
+        pr_err("my_devices: failed to add dev2 buffer: %d\n", ret);
+        kobject_put(&dev2->kobj);
+        dev2 = NULL;
+        goto err_put_dev1;
+    }
     kobject_uevent(&dev2->kobj, KOBJ_ADD);
 
+    if (nr_bench_devs) {
+        ret = my_dyn_create_many("bench", nr_bench_devs);
+        if (ret < 0)
+            goto err_put_dev2;
+    }
+
+    ret = sysfs_create_group(&my_kset->kobj, &my_kset_group);
+    if (ret)
+        goto err_destroy_dyn;
+
     pr_info("my_devices: created /sys/kernel/my_devices/dev1 and dev2\n");
     return 0;
 
+err_destroy_dyn:
+    my_dyn_destroy_all();
+err_put_dev2:
+    kobject_put(&dev2->kobj);
+    dev2 = NULL;
 err_put_dev1:
     if (dev1) {
         kobject_put(&dev1->kobj);
@@ -179,6 +551,11 @@ static void __exit my_module_exit(void)
 {
     pr_info("my_devices: exit\n");
 
+    /* control files first, so nothing can create objects while we tear down */
+    sysfs_remove_group(&my_kset->kobj, &my_kset_group);
+    my_dyn_destroy_all();
+    xa_destroy(&my_dyn_devs);
+
     /* remove dev1 and dev2 */
     if (dev2) {
         kobject_uevent(&dev2->kobj, KOBJ_REMOVE);
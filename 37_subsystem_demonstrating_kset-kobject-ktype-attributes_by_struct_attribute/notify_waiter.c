@@ -0,0 +1,188 @@
+/*
+ * notify_waiter.c - wait for changes on many sysfs "value" attributes
+ * with epoll(EPOLLPRI) and compare against periodic polling.
+ *
+ * A writer thread changes a random attribute every <period_us>; the
+ * waiter reports change-to-wakeup latency and its own CPU time.
+ *
+ * gcc -O2 -pthread -o notify_waiter notify_waiter.c
+ * sudo insmod my_devices.ko nr_bench_devs=1000
+ * sudo ./notify_waiter notify [nattrs] [changes] [period_us]
+ * sudo ./notify_waiter poll   [nattrs] [changes] [period_us] [poll_interval_us]
+ *
+ * Attribute files are /sys/kernel/my_devices/benchN/value.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#define PATH_FMT "/sys/kernel/my_devices/bench%d/value"
+
+static int nattrs = 1000;
+static int nchanges = 2000;
+static int period_us = 1000;
+static int *fds;
+static double *t_write;		/* indexed by the value written = change sequence */
+static volatile int writer_done;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_value(int fd)
+{
+	char buf[32];
+	ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+
+	if (n <= 0)
+		return -1;
+	buf[n] = '\0';
+	return atoi(buf);
+}
+
+/* values start at the bench index; use seq + nattrs so every write is a change */
+static void *writer(void *arg)
+{
+	char buf[32];
+	int i;
+
+	for (i = 0; i < nchanges; i++) {
+		int fd = fds[rand() % nattrs];
+		int seq = nattrs + i;
+
+		t_write[i] = now_sec();
+		snprintf(buf, sizeof(buf), "%d", seq);
+		if (pwrite(fd, buf, strlen(buf), 0) < 0)
+			perror("write value");
+		usleep(period_us);
+	}
+	writer_done = 1;
+	return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[])
+{
+	int notify_mode, poll_interval_us = 10000;
+	double *lat, cpu;
+	int nlat = 0, i, efd = -1;
+	int *last;
+	struct rusage ru;
+	struct rlimit rl;
+	pthread_t th;
+	char path[128];
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s notify|poll [nattrs] [changes] [period_us] [poll_interval_us]\n", argv[0]);
+		return 1;
+	}
+	notify_mode = !strcmp(argv[1], "notify");
+	if (argc > 2)
+		nattrs = atoi(argv[2]);
+	if (argc > 3)
+		nchanges = atoi(argv[3]);
+	if (argc > 4)
+		period_us = atoi(argv[4]);
+	if (argc > 5)
+		poll_interval_us = atoi(argv[5]);
+
+	rl.rlim_cur = rl.rlim_max = nattrs + 64;
+	setrlimit(RLIMIT_NOFILE, &rl);
+
+	fds = calloc(nattrs, sizeof(*fds));
+	last = calloc(nattrs, sizeof(*last));
+	t_write = calloc(nchanges, sizeof(*t_write));
+	lat = calloc(nchanges, sizeof(*lat));
+
+	if (notify_mode)
+		efd = epoll_create1(0);
+
+	for (i = 0; i < nattrs; i++) {
+		snprintf(path, sizeof(path), PATH_FMT, i);
+		fds[i] = open(path, O_RDWR);
+		if (fds[i] < 0) {
+			perror(path);
+			return 2;
+		}
+		/* sysfs only reports a change after the file has been read once */
+		last[i] = read_value(fds[i]);
+		if (notify_mode) {
+			struct epoll_event ev = { .events = EPOLLPRI | EPOLLERR, .data.u32 = i };
+
+			if (epoll_ctl(efd, EPOLL_CTL_ADD, fds[i], &ev) < 0) {
+				perror("epoll_ctl");
+				return 2;
+			}
+		}
+	}
+
+	pthread_create(&th, NULL, writer, NULL);
+
+	while (!writer_done || nlat < nchanges) {
+		if (notify_mode) {
+			struct epoll_event evs[64];
+			int n = epoll_wait(efd, evs, 64, 100);
+
+			if (n == 0 && writer_done)
+				break;
+			for (i = 0; i < n; i++) {
+				int idx = evs[i].data.u32;
+				int v = read_value(fds[idx]);
+				double t = now_sec();
+
+				if (v >= nattrs && v != last[idx]) {
+					lat[nlat++] = t - t_write[v - nattrs];
+					last[idx] = v;
+				}
+			}
+		} else {
+			int changed = 0;
+
+			for (i = 0; i < nattrs; i++) {
+				int v = read_value(fds[i]);
+
+				if (v >= nattrs && v != last[i]) {
+					lat[nlat++] = now_sec() - t_write[v - nattrs];
+					last[i] = v;
+					changed = 1;
+				}
+			}
+			if (!changed && writer_done)
+				break;
+			usleep(poll_interval_us);
+		}
+	}
+	pthread_join(th, NULL);
+
+	getrusage(RUSAGE_SELF, &ru);
+	cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	      ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+
+	qsort(lat, nlat, sizeof(*lat), cmp_double);
+	printf("mode=%s attrs=%d changes=%d seen=%d\n",
+	       notify_mode ? "notify" : "poll", nattrs, nchanges, nlat);
+	if (nlat)
+		printf("latency us: p50=%.1f p99=%.1f max=%.1f\n",
+		       lat[nlat / 2] * 1e6, lat[nlat * 99 / 100] * 1e6, lat[nlat - 1] * 1e6);
+	printf("process CPU time: %.3f s (user+sys, includes writer)\n", cpu);
+
+	for (i = 0; i < nattrs; i++)
+		close(fds[i]);
+	return 0;
+}
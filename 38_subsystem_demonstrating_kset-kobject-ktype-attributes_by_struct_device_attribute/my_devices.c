@@ -6,16 +6,29 @@
 #include <linux/fs.h>
 #include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Example Author");
 MODULE_DESCRIPTION("Toy class + device + device_attribute example");
 MODULE_VERSION("0.2");
 
+/* size of the per-device state buffer exported through the "buffer" bin attribute */
+static unsigned int buf_size = SZ_1M;
+module_param(buf_size, uint, 0444);
+MODULE_PARM_DESC(buf_size, "Size in bytes of each device's state buffer (default 1 MiB)");
+
+/* a text attribute can only return one page, so "chunk" shows the buffer in hex slices */
+#define TEXT_CHUNK_BYTES ((PAGE_SIZE - 1) / 2)
+
 struct my_dev {
     struct device *dev;
     int value;
     char status[16];
+    u8 *buffer;               /* vmalloc_user() so it can be mmap'ed */
+    unsigned int chunk_index; /* which TEXT_CHUNK_BYTES slice "chunk" shows */
+    struct kernfs_node *value_kn; /* cached "value" node for change notification */
 };
 
 /* Global class */
@@ -48,24 +61,136 @@ static ssize_t value_store(struct device *dev,
     long v;
     if (kstrtol(buf, 0, &v))
         return -EINVAL;
-    mdev->value = (int)v;
+
+    /* wake poll(POLLPRI)/select(exceptfds) waiters only on a real change */
+    if (mdev->value != (int)v) {
+        mdev->value = (int)v;
+        if (mdev->value_kn)
+            sysfs_notify_dirent(mdev->value_kn);
+    }
     return count;
 }
 static DEVICE_ATTR_RW(value);
 
+static ssize_t chunk_index_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct my_dev *mdev = dev_get_drvdata(dev);
+    return scnprintf(buf, PAGE_SIZE, "%u\n", mdev->chunk_index);
+}
+
+static ssize_t chunk_index_store(struct device *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    struct my_dev *mdev = dev_get_drvdata(dev);
+    unsigned int idx;
+    if (kstrtouint(buf, 0, &idx))
+        return -EINVAL;
+    mdev->chunk_index = idx;
+    return count;
+}
+static DEVICE_ATTR_RW(chunk_index);
+
+static ssize_t chunk_show(struct device *dev,
+                          struct device_attribute *attr, char *buf)
+{
+    struct my_dev *mdev = dev_get_drvdata(dev);
+    size_t off = (size_t)mdev->chunk_index * TEXT_CHUNK_BYTES;
+    size_t len;
+
+    if (off >= buf_size)
+        return 0;
+    len = min_t(size_t, TEXT_CHUNK_BYTES, buf_size - off);
+    bin2hex(buf, mdev->buffer + off, len);
+    buf[len * 2] = '\n';
+    return len * 2 + 1;
+}
+static DEVICE_ATTR_RO(chunk);
+
+/* --- binary attribute: whole state buffer --- */
+/* sysfs clamps off/count against attr->size, so these are a plain memcpy */
+static ssize_t buffer_read(struct file *filp, struct kobject *kobj,
+                           struct bin_attribute *attr,
+                           char *buf, loff_t off, size_t count)
+{
+    struct my_dev *mdev = dev_get_drvdata(kobj_to_dev(kobj));
+
+    memcpy(buf, mdev->buffer + off, count);
+    return count;
+}
+
+static ssize_t buffer_write(struct file *filp, struct kobject *kobj,
+                            struct bin_attribute *attr,
+                            char *buf, loff_t off, size_t count)
+{
+    struct my_dev *mdev = dev_get_drvdata(kobj_to_dev(kobj));
+
+    memcpy(mdev->buffer + off, buf, count);
+    return count;
+}
+
+static int buffer_mmap(struct file *filp, struct kobject *kobj,
+                       struct bin_attribute *attr,
+                       struct vm_area_struct *vma)
+{
+    struct my_dev *mdev = dev_get_drvdata(kobj_to_dev(kobj));
+
+    return remap_vmalloc_range(vma, mdev->buffer, vma->vm_pgoff);
+}
+
+/* .size is filled in at init time from buf_size */
+static struct bin_attribute bin_attr_buffer = {
+    .attr  = { .name = "buffer", .mode = 0644 },
+    .read  = buffer_read,
+    .write = buffer_write,
+    .mmap  = buffer_mmap,
+};
+
 /* Group attributes together */
 static struct attribute *my_attrs[] = {
     &dev_attr_status.attr,
     &dev_attr_value.attr,
+    &dev_attr_chunk_index.attr,
+    &dev_attr_chunk.attr,
+    NULL,
+};
+
+static struct bin_attribute *my_bin_attrs[] = {
+    &bin_attr_buffer,
     NULL,
 };
-ATTRIBUTE_GROUPS(my);
+
+static const struct attribute_group my_group = {
+    .attrs     = my_attrs,
+    .bin_attrs = my_bin_attrs,
+};
+__ATTRIBUTE_GROUPS(my);
+
+/* allocate the state buffer and fill it with a recognisable pattern */
+static u8 *my_alloc_buffer(int seed)
+{
+    u8 *buffer = vmalloc_user(PAGE_ALIGN(buf_size));
+    unsigned int i;
+
+    if (!buffer)
+        return NULL;
+    for (i = 0; i < buf_size; i++)
+        buffer[i] = (u8)(i + seed);
+    return buffer;
+}
 
 /* --- Module init/exit --- */
 static int __init my_module_init(void)
 {
+    int ret;
+
     pr_info("my_devices: init\n");
 
+    if (!buf_size)
+        return -EINVAL;
+    bin_attr_buffer.size = buf_size;
+
     /* Create /sys/class/my_devices */
     my_class = class_create(THIS_MODULE, "my_devices");
     if (IS_ERR(my_class))
@@ -76,34 +201,69 @@ static int __init my_module_init(void)
 
     /* Create dev1 */
     dev1 = kzalloc(sizeof(*dev1), GFP_KERNEL);
-    if (!dev1)
-        return -ENOMEM;
+    if (!dev1) {
+        ret = -ENOMEM;
+        goto err_class;
+    }
     dev1->value = 1;
     strscpy(dev1->status, "OK", sizeof(dev1->status));
+    /* buffer must exist before device_create() makes the attributes visible */
+    dev1->buffer = my_alloc_buffer(dev1->value);
+    if (!dev1->buffer) {
+        ret = -ENOMEM;
+        goto err_free_dev1;
+    }
 
     dev1->dev = device_create(my_class, NULL, 0, dev1, "dev1");
     if (IS_ERR(dev1->dev)) {
-        kfree(dev1);
-        return PTR_ERR(dev1->dev);
+        /* dev1 is freed below, keep the error code first */
+        ret = PTR_ERR(dev1->dev);
+        goto err_free_dev1;
     }
     dev_set_drvdata(dev1->dev, dev1);
+    dev1->value_kn = sysfs_get_dirent(dev1->dev->kobj.sd, "value");
 
     /* Create dev2 */
     dev2 = kzalloc(sizeof(*dev2), GFP_KERNEL);
-    if (!dev2)
-        return -ENOMEM;
+    if (!dev2) {
+        ret = -ENOMEM;
+        goto err_unregister_dev1;
+    }
     dev2->value = 42;
     strscpy(dev2->status, "OK", sizeof(dev2->status));
+    /* buffer must exist before device_create() makes the attributes visible */
+    dev2->buffer = my_alloc_buffer(dev2->value);
+    if (!dev2->buffer) {
+        ret = -ENOMEM;
+        goto err_free_dev2;
+    }
 
     dev2->dev = device_create(my_class, NULL, 0, dev2, "dev2");
     if (IS_ERR(dev2->dev)) {
-        kfree(dev2);
-        return PTR_ERR(dev2->dev);
+        ret = PTR_ERR(dev2->dev);
+        goto err_free_dev2;
     }
     dev_set_drvdata(dev2->dev, dev2);
+    dev2->value_kn = sysfs_get_dirent(dev2->dev->kobj.sd, "value");
 
     pr_info("my_devices: created /sys/class/my_devices/dev1 and dev2\n");
     return 0;
+
+err_free_dev2:
+    vfree(dev2->buffer);
+    kfree(dev2);
+    dev2 = NULL;
+err_unregister_dev1:
+    device_unregister(dev1->dev);
+    sysfs_put(dev1->value_kn);
+err_free_dev1:
+    vfree(dev1->buffer);
+    kfree(dev1);
+    dev1 = NULL;
+err_class:
+    class_destroy(my_class);
+    my_class = NULL;
+    return ret;
 }
 
 static void __exit my_module_exit(void)
@@ -112,10 +272,14 @@ static void __exit my_module_exit(void)
 
     if (dev2 && dev2->dev) {
         device_unregister(dev2->dev);
+        sysfs_put(dev2->value_kn);
+        vfree(dev2->buffer);
         kfree(dev2);
     }
     if (dev1 && dev1->dev) {
         device_unregister(dev1->dev);
+        sysfs_put(dev1->value_kn);
+        vfree(dev1->buffer);
         kfree(dev1);
     }
 
@@ -0,0 +1,115 @@
+/*
+ * bench_pwm.c - CPU cost and duty-cycle accuracy of the software PWM.
+ *
+ * Gives LED i brightness (i * 251 / nr_leds) + 2 so most LEDs have a
+ * distinct duty, lets the engine run, then compares duty_measured with
+ * the requested level and reports system CPU usage over the run.
+ *
+ * gcc -O2 -o bench_pwm bench_pwm.c
+ * sudo ./bench_pwm <nr_leds> [seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+
+#define CLASS "/sys/class/myled"
+
+static void write_attr(const char *path, int val)
+{
+	char buf[16];
+	int fd = open(path, O_WRONLY);
+
+	snprintf(buf, sizeof(buf), "%d", val);
+	if (fd < 0 || write(fd, buf, strlen(buf)) < 0) {
+		perror(path);
+		exit(2);
+	}
+	close(fd);
+}
+
+static long read_attr(const char *path)
+{
+	char buf[64] = "";
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0 || read(fd, buf, sizeof(buf) - 1) < 0) {
+		perror(path);
+		exit(2);
+	}
+	close(fd);
+	return atol(buf);
+}
+
+/* busy and total jiffies summed over all CPUs */
+static void cpu_times(unsigned long long *busy, unsigned long long *total)
+{
+	unsigned long long v[10] = { 0 };
+	FILE *f = fopen("/proc/stat", "r");
+	int i;
+
+	if (fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+		   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9]) < 4)
+		exit(2);
+	fclose(f);
+	*total = 0;
+	for (i = 0; i < 8; i++)
+		*total += v[i];
+	*busy = *total - v[3] - v[4];	/* minus idle and iowait */
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long b0, t0, b1, t1;
+	double err_sum = 0, err_max = 0;
+	int n, seconds = 5, i;
+	char path[128];
+	char stats[256] = "";
+	int fd;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <nr_leds> [seconds]\n", argv[0]);
+		return 1;
+	}
+	n = atoi(argv[1]);
+	if (argc > 2)
+		seconds = atoi(argv[2]);
+
+	for (i = 0; i < n; i++) {
+		snprintf(path, sizeof(path), CLASS "/led%d/brightness", i);
+		write_attr(path, i * 251 / n + 2);
+	}
+
+	cpu_times(&b0, &t0);
+	sleep(seconds);
+	cpu_times(&b1, &t1);
+
+	for (i = 0; i < n; i++) {
+		double want = (i * 251 / n + 2) * 1000.0 / 255, err;
+
+		snprintf(path, sizeof(path), CLASS "/led%d/duty_measured", i);
+		err = fabs(read_attr(path) - want) / 10.0;	/* in % of full scale */
+		err_sum += err;
+		if (err > err_max)
+			err_max = err;
+	}
+
+	fd = open(CLASS "/pwm_stats", O_RDONLY);
+	if (fd >= 0) {
+		if (read(fd, stats, sizeof(stats) - 1) < 0)
+			stats[0] = '\0';
+		close(fd);
+	}
+
+	printf("%d LEDs, %d s: system CPU %.2f%%, duty error avg %.3f%% max %.3f%%\n",
+	       n, seconds, 100.0 * (b1 - b0) / (t1 - t0), err_sum / n, err_max);
+	printf("%s", stats);
+
+	for (i = 0; i < n; i++) {
+		snprintf(path, sizeof(path), CLASS "/led%d/brightness", i);
+		write_attr(path, 0);
+	}
+	return 0;
+}
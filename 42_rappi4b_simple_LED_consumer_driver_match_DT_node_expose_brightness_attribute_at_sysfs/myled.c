@@ -5,105 +5,464 @@
 #include <linux/gpio/consumer.h> // For gpiod interface
 #include <linux/fs.h>
 #include <linux/device.h>
+#include <linux/hrtimer.h>      // For the shared PWM timer
+#include <linux/kthread.h>      // PWM thread for GPIOs that can sleep
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/bitmap.h>
+
+#define MYLED_MAX_BRIGHTNESS 255
+
+// PWM period; 256 levels over 10 ms = ~39 us per step, 100 Hz (no visible flicker)
+static unsigned int pwm_period_us = 10000;
+module_param(pwm_period_us, uint, 0444);
+MODULE_PARM_DESC(pwm_period_us, "Software PWM period in microseconds (default 10000)");
 
 // ---------------- GLOBALS ----------------
 
-// Pointer to gpio descriptor (abstract representation of pin)
-static struct gpio_desc *led_gpiod;
+// One LED = one GPIO line = one /sys/class/myled/ledN
+struct pwm_led {
+    struct gpio_desc *gpiod;    // abstract representation of pin
+    struct device *dev;         // /sys/class/myled/ledN
+    u8 brightness;              // requested level 0..255 (sysfs)
+    u8 duty;                    // level the engine uses for the current period
+    bool on;                    // pin level as last driven by the engine
+    ktime_t on_since;           // measured duty: when the pin went high
+    u64 on_ns;                  // measured duty: accumulated high time
+    ktime_t measure_start;      // measured duty: since last brightness write
+};
+
+// All GPIO lines listed in the DT "gpios" property
+static struct gpio_descs *led_gpios;
+static struct pwm_led *leds;
+static unsigned int nr_leds;
 
 // The class for sysfs: /sys/class/myled/
 static struct class *led_class;
 
-// The device inside class: /sys/class/myled/led0
-static struct device *led_device;
+
+// ---------------- SOFTWARE PWM ENGINE ----------------
+//
+// One shared timer services every LED:
+//   - at the start of a period all LEDs with duty > 0 go high (one batched GPIO call)
+//   - LEDs are kept sorted by duty, so the off-edges come in order; each timer
+//     callback switches off every LED whose edge is due (again one batched call)
+//     and re-arms the timer for the next distinct edge
+// So the number of callbacks per period is bounded by the number of *distinct*
+// duty values (<= 256), not by the number of LEDs.
+//
+// GPIOs that cannot sleep are driven straight from the hrtimer. GPIOs behind a
+// sleeping controller (I2C/SPI expanders, gpio-sim) are driven by a kthread that
+// sleeps with schedule_hrtimeout_range() on the same schedule.
+
+static struct hrtimer pwm_timer;
+static struct task_struct *pwm_thread;
+static bool pwm_can_sleep;
+
+static DEFINE_SPINLOCK(pwm_lock);   // protects the engine state below
+static struct pwm_led **pwm_order;  // LEDs sorted by duty for the current period
+static bool pwm_order_dirty;        // a brightness changed: re-sort at next period
+static bool pwm_idle;               // no LED needs PWM: engine stopped
+static unsigned int pwm_next;       // next LED in pwm_order to switch off
+static ktime_t pwm_period_start;
+static ktime_t pwm_period_end;
+
+// statistics (/sys/class/myled/pwm_stats)
+static u64 pwm_periods;
+static u64 pwm_callbacks;
+static u64 pwm_late_max_ns;
+
+// Scratch for batched GPIO updates; only touched by the engine context
+static struct gpio_desc **pwm_descs;
+static unsigned long *pwm_bits;
+
+static int pwm_cmp_duty(const void *a, const void *b)
+{
+    const struct pwm_led *la = *(const struct pwm_led * const *)a;
+    const struct pwm_led *lb = *(const struct pwm_led * const *)b;
+
+    return la->duty - lb->duty;
+}
+
+static ktime_t pwm_off_time(const struct pwm_led *led)
+{
+    return ktime_add_ns(pwm_period_start,
+                        div_u64((u64)led->duty * pwm_period_us * NSEC_PER_USEC,
+                                MYLED_MAX_BRIGHTNESS));
+}
+
+// Record a level change for @led in the batch; caller holds pwm_lock
+static void pwm_batch_add(struct pwm_led *led, bool on, unsigned int *n, ktime_t now)
+{
+    if (led->on == on)
+        return;
+
+    led->on = on;
+    if (on)
+        led->on_since = now;
+    else
+        led->on_ns += ktime_to_ns(ktime_sub(now, led->on_since));
+
+    pwm_descs[*n] = led->gpiod;
+    __assign_bit(*n, pwm_bits, on);
+    (*n)++;
+}
+
+// Run the engine at the scheduled time @expires; returns the next expiry or KTIME_MAX when idle
+static ktime_t pwm_step(ktime_t expires)
+{
+    ktime_t now = ktime_get();
+    ktime_t next;
+    unsigned int i, n = 0;
+    unsigned long flags;
+    bool active = false;
+    s64 late;
+
+    spin_lock_irqsave(&pwm_lock, flags);
+
+    pwm_callbacks++;
+    late = ktime_to_ns(ktime_sub(now, expires));
+    if (late > 0 && (u64)late > pwm_late_max_ns)
+        pwm_late_max_ns = late;
+
+    if (ktime_compare(expires, pwm_period_end) >= 0) {
+        // ---- new period: latch brightness, sort, switch everything on ----
+        pwm_periods++;
+        pwm_period_start = expires;
+        pwm_period_end = ktime_add_us(expires, pwm_period_us);
+
+        if (pwm_order_dirty) {
+            for (i = 0; i < nr_leds; i++)
+                leds[i].duty = READ_ONCE(leds[i].brightness);
+            sort(pwm_order, nr_leds, sizeof(*pwm_order), pwm_cmp_duty, NULL);
+            pwm_order_dirty = false;
+        }
+
+        pwm_next = nr_leds;
+        for (i = 0; i < nr_leds; i++) {
+            struct pwm_led *led = pwm_order[i];
+
+            pwm_batch_add(led, led->duty > 0, &n, now);
+            if (led->duty > 0 && led->duty < MYLED_MAX_BRIGHTNESS) {
+                active = true;
+                if (pwm_next == nr_leds)
+                    pwm_next = i;
+            }
+        }
+
+        if (!active) {
+            // only fully on/off LEDs: levels are set, nothing to time
+            pwm_idle = true;
+            next = KTIME_MAX;
+            goto out;
+        }
+    } else {
+        // ---- off-edge(s): every LED whose duty has elapsed ----
+        while (pwm_next < nr_leds &&
+               pwm_order[pwm_next]->duty < MYLED_MAX_BRIGHTNESS &&
+               ktime_compare(pwm_off_time(pwm_order[pwm_next]), expires) <= 0)
+            pwm_batch_add(pwm_order[pwm_next++], false, &n, now);
+    }
+
+    if (pwm_next < nr_leds && pwm_order[pwm_next]->duty < MYLED_MAX_BRIGHTNESS)
+        next = pwm_off_time(pwm_order[pwm_next]);
+    else
+        next = pwm_period_end;
+
+out:
+    spin_unlock_irqrestore(&pwm_lock, flags);
+
+    // one GPIO call for the whole batch
+    if (n) {
+        if (pwm_can_sleep)
+            gpiod_set_array_value_cansleep(n, pwm_descs, NULL, pwm_bits);
+        else
+            gpiod_set_array_value(n, pwm_descs, NULL, pwm_bits);
+    }
+    return next;
+}
+
+static enum hrtimer_restart pwm_timer_fn(struct hrtimer *timer)
+{
+    ktime_t next = pwm_step(hrtimer_get_expires(timer));
+
+    if (next == KTIME_MAX)
+        return HRTIMER_NORESTART;
+
+    hrtimer_set_expires(timer, next);
+    return HRTIMER_RESTART;
+}
+
+static int pwm_thread_fn(void *arg)
+{
+    ktime_t expires = ktime_get();
+
+    while (!kthread_should_stop()) {
+        ktime_t next = pwm_step(expires);
+
+        set_current_state(TASK_INTERRUPTIBLE);
+        if (kthread_should_stop()) {
+            __set_current_state(TASK_RUNNING);
+            break;
+        }
+
+        if (next == KTIME_MAX) {
+            // idle until pwm_kick() clears pwm_idle and wakes us
+            if (READ_ONCE(pwm_idle))
+                schedule();
+            else
+                __set_current_state(TASK_RUNNING);
+            expires = ktime_get();
+        } else {
+            schedule_hrtimeout_range(&next, 0, HRTIMER_MODE_ABS);
+            expires = next;
+        }
+    }
+    return 0;
+}
+
+// A brightness changed: re-sort at the next period, restart the engine if idle
+static void pwm_kick(void)
+{
+    unsigned long flags;
+    bool was_idle;
+
+    spin_lock_irqsave(&pwm_lock, flags);
+    pwm_order_dirty = true;
+    was_idle = pwm_idle;
+    if (was_idle) {
+        pwm_idle = false;
+        pwm_period_end = 0;     // next step starts a new period
+    }
+    spin_unlock_irqrestore(&pwm_lock, flags);
+
+    if (!was_idle)
+        return;
+
+    if (pwm_can_sleep)
+        wake_up_process(pwm_thread);
+    else
+        hrtimer_start(&pwm_timer, ktime_get(), HRTIMER_MODE_ABS);
+}
+
+static int pwm_engine_start(struct device *dev)
+{
+    unsigned int i;
+
+    pwm_order = devm_kcalloc(dev, nr_leds, sizeof(*pwm_order), GFP_KERNEL);
+    pwm_descs = devm_kcalloc(dev, nr_leds, sizeof(*pwm_descs), GFP_KERNEL);
+    pwm_bits = devm_kcalloc(dev, BITS_TO_LONGS(nr_leds), sizeof(long), GFP_KERNEL);
+    if (!pwm_order || !pwm_descs || !pwm_bits)
+        return -ENOMEM;
+
+    // decided again on every probe: an unbind + bind may bring other lines
+    pwm_can_sleep = false;
+    for (i = 0; i < nr_leds; i++) {
+        pwm_order[i] = &leds[i];
+        pwm_can_sleep |= gpiod_cansleep(leds[i].gpiod);
+    }
+
+    // everything is off (GPIOD_OUT_LOW) and no LED needs PWM yet
+    pwm_idle = true;
+
+    if (pwm_can_sleep) {
+        pwm_thread = kthread_run(pwm_thread_fn, NULL, "myled-pwm");
+        if (IS_ERR(pwm_thread))
+            return PTR_ERR(pwm_thread);
+    } else {
+        hrtimer_init(&pwm_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+        pwm_timer.function = pwm_timer_fn;
+    }
+    return 0;
+}
+
+static void pwm_engine_stop(void)
+{
+    if (pwm_can_sleep)
+        kthread_stop(pwm_thread);
+    else
+        hrtimer_cancel(&pwm_timer);
+}
 
 
 // ---------------- SYSFS ATTRIBUTE ----------------
 
 // Sysfs attribute to control LED brightness
-// echo 1 > /sys/class/myled/led0/brightness  --> LED ON
-// echo 0 > /sys/class/myled/led0/brightness  --> LED OFF
-// cat /sys/class/myled/led0/brightness       --> show current value
+// echo 255 > /sys/class/myled/led0/brightness  --> LED fully ON
+// echo 64  > /sys/class/myled/led0/brightness  --> LED at 25% (software PWM)
+// echo 0   > /sys/class/myled/led0/brightness  --> LED OFF
+// cat /sys/class/myled/led0/brightness         --> show requested value
 
 static ssize_t brightness_show(struct device *dev,
                                struct device_attribute *attr, char *buf)
 {
-    int value = gpiod_get_value(led_gpiod);   // read current pin state
-    return sprintf(buf, "%d\n", value);       // print 0 or 1
+    struct pwm_led *led = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%u\n", READ_ONCE(led->brightness));
 }
 
 static ssize_t brightness_store(struct device *dev,
                                 struct device_attribute *attr,
                                 const char *buf, size_t count)
 {
-    int val;
-    if (kstrtoint(buf, 10, &val) < 0)  // convert user input string to int
+    struct pwm_led *led = dev_get_drvdata(dev);
+    unsigned long flags;
+    u8 val;
+
+    if (kstrtou8(buf, 10, &val) < 0)  // convert user input string to 0..255
         return -EINVAL;
 
-    // Control the GPIO pin (0 = off, 1 = on)
-    gpiod_set_value(led_gpiod, val ? 1 : 0);
+    spin_lock_irqsave(&pwm_lock, flags);
+    WRITE_ONCE(led->brightness, val);
+    // restart the duty measurement from now
+    led->on_ns = 0;
+    led->on_since = led->measure_start = ktime_get();
+    spin_unlock_irqrestore(&pwm_lock, flags);
+
+    pwm_kick();
     return count;
 }
 
-// Create a device_attribute struct (ties show/store to sysfs file)
+// Measured duty since the last brightness write, in 1/1000 of full scale
+static ssize_t duty_measured_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct pwm_led *led = dev_get_drvdata(dev);
+    ktime_t now = ktime_get();
+    unsigned long flags;
+    u64 on_ns, total_ns;
+
+    spin_lock_irqsave(&pwm_lock, flags);
+    on_ns = led->on_ns;
+    if (led->on)
+        on_ns += ktime_to_ns(ktime_sub(now, led->on_since));
+    total_ns = ktime_to_ns(ktime_sub(now, led->measure_start));
+    spin_unlock_irqrestore(&pwm_lock, flags);
+
+    return sprintf(buf, "%llu\n", total_ns ? div64_u64(on_ns * 1000, total_ns) : 0);
+}
+
+// Create device_attribute structs (ties show/store to sysfs files)
 static DEVICE_ATTR_RW(brightness);
+static DEVICE_ATTR_RO(duty_measured);
 // Equivalent to:
 // struct device_attribute dev_attr_brightness = __ATTR_RW(brightness);
 
+static struct attribute *myled_attrs[] = {
+    &dev_attr_brightness.attr,
+    &dev_attr_duty_measured.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(myled);
+
+// Engine statistics: /sys/class/myled/pwm_stats
+static ssize_t pwm_stats_show(struct class *class,
+                              struct class_attribute *attr, char *buf)
+{
+    unsigned long flags;
+    u64 periods, callbacks, late;
+
+    spin_lock_irqsave(&pwm_lock, flags);
+    periods = pwm_periods;
+    callbacks = pwm_callbacks;
+    late = pwm_late_max_ns;
+    spin_unlock_irqrestore(&pwm_lock, flags);
+
+    return sprintf(buf, "leds=%u mode=%s periods=%llu callbacks=%llu late_max_ns=%llu\n",
+                   nr_leds, pwm_can_sleep ? "kthread" : "hrtimer",
+                   periods, callbacks, late);
+}
+static CLASS_ATTR_RO(pwm_stats);
+
 
 
 // ---------------- PROBE & REMOVE ----------------
 
 static int myled_probe(struct platform_device *pdev)
 {
+    unsigned int i;
     int ret;
 
     pr_info("myled: Probing LED driver\n");
 
-    // 1. Request the GPIO from device tree
-    led_gpiod = devm_gpiod_get(&pdev->dev, NULL, GPIOD_OUT_LOW);
-    if (IS_ERR(led_gpiod)) {
+    if (!pwm_period_us)
+        return -EINVAL;
+
+    // 1. Request the GPIOs from device tree (one LED per line in "gpios")
+    led_gpios = devm_gpiod_get_array(&pdev->dev, NULL, GPIOD_OUT_LOW);
+    if (IS_ERR(led_gpios)) {
         pr_err("myled: Failed to get GPIO from device tree\n");
-        return PTR_ERR(led_gpiod);
+        return PTR_ERR(led_gpios);
     }
+    nr_leds = led_gpios->ndescs;
+
+    leds = devm_kcalloc(&pdev->dev, nr_leds, sizeof(*leds), GFP_KERNEL);
+    if (!leds)
+        return -ENOMEM;
+    for (i = 0; i < nr_leds; i++)
+        leds[i].gpiod = led_gpios->desc[i];
 
-    // 2. Create class in /sys/class/
+    // 2. Start the (idle) PWM engine
+    ret = pwm_engine_start(&pdev->dev);
+    if (ret)
+        return ret;
+
+    // 3. Create class in /sys/class/
     led_class = class_create(THIS_MODULE, "myled");
     if (IS_ERR(led_class)) {
         pr_err("myled: Failed to create class\n");
-        return PTR_ERR(led_class);
-    }
-
-    // 3. Create device inside class
-    led_device = device_create(led_class, NULL, 0, NULL, "led0");
-    if (IS_ERR(led_device)) {
-        pr_err("myled: Failed to create device\n");
-        class_destroy(led_class);
-        return PTR_ERR(led_device);
+        ret = PTR_ERR(led_class);
+        goto err_engine;
     }
 
-    // 4. Add sysfs file: /sys/class/myled/led0/brightness
-    ret = device_create_file(led_device, &dev_attr_brightness);
-    if (ret) {
-        pr_err("myled: Failed to create sysfs attribute\n");
-        device_destroy(led_class, 0);
-        class_destroy(led_class);
-        return ret;
+    ret = class_create_file(led_class, &class_attr_pwm_stats);
+    if (ret)
+        goto err_class;
+
+    // 4. Create one device per LED inside the class, with its sysfs files:
+    //    /sys/class/myled/ledN/{brightness,duty_measured}
+    for (i = 0; i < nr_leds; i++) {
+        leds[i].dev = device_create_with_groups(led_class, NULL, 0, &leds[i],
+                                                myled_groups, "led%u", i);
+        if (IS_ERR(leds[i].dev)) {
+            pr_err("myled: Failed to create device\n");
+            ret = PTR_ERR(leds[i].dev);
+            goto err_devices;
+        }
     }
 
-    pr_info("myled: Probe successful, LED sysfs ready\n");
+    pr_info("myled: Probe successful, %u LED(s), PWM driven by %s\n",
+            nr_leds, pwm_can_sleep ? "kthread" : "hrtimer");
     return 0;
+
+err_devices:
+    while (i--)
+        device_unregister(leds[i].dev);
+    class_remove_file(led_class, &class_attr_pwm_stats);
+err_class:
+    class_destroy(led_class);
+err_engine:
+    pwm_engine_stop();
+    return ret;
 }
 
 static int myled_remove(struct platform_device *pdev)
 {
-    // Remove sysfs file
-    device_remove_file(led_device, &dev_attr_brightness);
+    unsigned int i;
 
-    // Remove device + class
-    device_destroy(led_class, 0);
+    // Remove devices (and their sysfs files) + class
+    for (i = 0; i < nr_leds; i++)
+        device_unregister(leds[i].dev);
+    class_remove_file(led_class, &class_attr_pwm_stats);
     class_destroy(led_class);
 
+    // Stop the engine and leave the LEDs off
+    pwm_engine_stop();
+    for (i = 0; i < nr_leds; i++)
+        gpiod_set_value_cansleep(leds[i].gpiod, 0);
+
     pr_info("myled: Removed LED driver\n");
     return 0;
 }
@@ -135,4 +494,4 @@ module_platform_driver(myled_driver);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Ragab Elsayed");
-MODULE_DESCRIPTION("GPIO LED consumer driver with sysfs control");
+MODULE_DESCRIPTION("GPIO LED consumer driver with sysfs control and software PWM brightness");
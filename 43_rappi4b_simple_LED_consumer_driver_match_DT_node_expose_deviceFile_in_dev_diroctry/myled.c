@@ -23,9 +23,9 @@ static ssize_t myled_write(struct file *file, const char __user *buf,
         return -EFAULT;
 
     if (kbuf[0] == '1')
-        gpiod_set_value(led_gpio, 1);
+        gpiod_set_value_cansleep(led_gpio, 1);
     else if (kbuf[0] == '0')
-        gpiod_set_value(led_gpio, 0);
+        gpiod_set_value_cansleep(led_gpio, 0);
 
     return len;
 }
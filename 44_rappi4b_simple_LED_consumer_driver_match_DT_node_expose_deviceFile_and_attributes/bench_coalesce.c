@@ -0,0 +1,87 @@
+/*
+ * bench_coalesce.c - burst of LED writes to /dev/led0, per-write latency
+ * plus the driver's GPIO operation count.
+ *
+ * gcc -O2 -o bench_coalesce bench_coalesce.c
+ * sudo ./bench_coalesce [writes] [gap_us]
+ *   default: 100000 writes, back to back (gap 0)
+ *
+ * Set the mode first, e.g.
+ *   echo 0 | sudo tee /sys/class/myled/led0/coalesce_ms     # every write hits the GPIO
+ *   echo 5 | sudo tee /sys/class/myled/led0/coalesce_ms     # 5 ms window
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#define STATS "/sys/class/myled/led0/write_stats"
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void print_stats(const char *when)
+{
+	char buf[128] = "";
+	int fd = open(STATS, O_RDONLY);
+
+	if (fd >= 0) {
+		if (read(fd, buf, sizeof(buf) - 1) < 0)
+			buf[0] = '\0';
+		close(fd);
+	}
+	printf("%-6s %s", when, buf[0] ? buf : "(no " STATS ")\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int n = argc > 1 ? atoi(argv[1]) : 100000;
+	int gap_us = argc > 2 ? atoi(argv[2]) : 0;
+	uint64_t *lat = calloc(n, sizeof(*lat));
+	uint64_t t0, start;
+	int fd, i;
+
+	fd = open("/dev/led0", O_WRONLY);
+	if (fd < 0) {
+		perror("/dev/led0");
+		return 2;
+	}
+
+	print_stats("before");
+	start = now_ns();
+	for (i = 0; i < n; i++) {
+		t0 = now_ns();
+		if (write(fd, i & 1 ? "0\n" : "1\n", 2) != 2) {
+			perror("write");
+			return 2;
+		}
+		lat[i] = now_ns() - t0;
+		if (gap_us)
+			usleep(gap_us);
+	}
+	printf("%d writes in %.3f s\n", n, (now_ns() - start) / 1e9);
+
+	usleep(200000);		/* let the last window close */
+	print_stats("after");
+
+	qsort(lat, n, sizeof(*lat), cmp_u64);
+	printf("write latency: p50 %.2f us, p99 %.2f us, max %.2f us\n",
+	       lat[n / 2] / 1e3, lat[n * 99 / 100] / 1e3, lat[n - 1] / 1e3);
+	close(fd);
+	return 0;
+}
@@ -5,6 +5,11 @@
 #include <linux/fs.h>
 #include <linux/cdev.h>
 #include <linux/device.h>
+#include <linux/uaccess.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
 
 #define DRIVER_NAME "myled"
 
@@ -14,6 +19,98 @@ static struct class *myled_class;
 static struct device *myled_dev;
 static struct gpio_desc *led_gpio;
 
+/*
+ * Write coalescing: a write only records the requested state; a delayed
+ * work item applies the latest one after coalesce_ms, so a burst of writes
+ * costs one GPIO access. min_hold_ms keeps each applied state on the line
+ * for at least that long. Both 0 = apply every write immediately.
+ */
+static unsigned int coalesce_ms;
+module_param(coalesce_ms, uint, 0644);
+MODULE_PARM_DESC(coalesce_ms, "Default coalescing window for LED writes (ms, 0 = off)");
+
+static unsigned int min_hold_ms;
+module_param(min_hold_ms, uint, 0644);
+MODULE_PARM_DESC(min_hold_ms, "Default minimum time an applied LED state is held (ms, 0 = off)");
+
+static DEFINE_MUTEX(led_gpio_lock);     /* serializes GPIO updates */
+static DEFINE_SPINLOCK(led_state_lock); /* protects the state below */
+static int led_pending = -1;            /* requested, not applied yet (-1 = none) */
+static int led_applied;                 /* level last driven on the line */
+static unsigned long led_changed_at;    /* jiffies of the last applied change */
+static unsigned int led_coalesce_ms, led_hold_ms;
+static u64 led_writes, led_gpio_ops;
+static struct delayed_work led_work;
+
+/* -------------------------
+ * Coalesced GPIO updates
+ * -------------------------
+ */
+static void led_work_fn(struct work_struct *work)
+{
+    unsigned long hold_until, now;
+    int val;
+
+    mutex_lock(&led_gpio_lock);
+    spin_lock(&led_state_lock);
+    val = led_pending;
+    if (val < 0)
+        goto out;
+    /* one sample: a tick between a check and a subtraction would underflow the delay */
+    now = jiffies;
+    hold_until = led_changed_at + msecs_to_jiffies(led_hold_ms);
+    if (val != led_applied && led_hold_ms && time_before(now, hold_until)) {
+        /* previous state has not been shown long enough: come back later */
+        schedule_delayed_work(&led_work, hold_until - now);
+        goto out;
+    }
+    led_pending = -1;
+    if (val == led_applied)     /* the burst ended where it started: nothing to drive */
+        goto out;
+    led_applied = val;
+    led_changed_at = now;
+    led_gpio_ops++;
+    spin_unlock(&led_state_lock);
+
+    gpiod_set_value_cansleep(led_gpio, val);
+    mutex_unlock(&led_gpio_lock);
+    return;
+
+out:
+    spin_unlock(&led_state_lock);
+    mutex_unlock(&led_gpio_lock);
+}
+
+/* Record a requested LED state; apply it now or let led_work pick it up */
+static void led_request(int val)
+{
+    bool direct;
+
+    spin_lock(&led_state_lock);
+    led_writes++;
+    direct = !led_coalesce_ms && !led_hold_ms;
+    if (!direct)
+        led_pending = val;
+    spin_unlock(&led_state_lock);
+
+    if (!direct) {
+        /* first write of a burst opens the window, later ones just update led_pending */
+        schedule_delayed_work(&led_work, msecs_to_jiffies(led_coalesce_ms));
+        return;
+    }
+
+    mutex_lock(&led_gpio_lock);
+    spin_lock(&led_state_lock);
+    led_pending = -1;   /* coalescing was just turned off: this write wins */
+    led_applied = val;
+    led_changed_at = jiffies;
+    led_gpio_ops++;
+    spin_unlock(&led_state_lock);
+
+    gpiod_set_value_cansleep(led_gpio, val);
+    mutex_unlock(&led_gpio_lock);
+}
+
 /* -------------------------
  * Sysfs "direction" attribute
  * -------------------------
@@ -32,13 +129,28 @@ static ssize_t direction_store(struct device *dev,
                                struct device_attribute *attr,
                                const char *buf, size_t count)
 {
+    bool out;
+
     if (sysfs_streq(buf, "out"))
-        gpiod_direction_output(led_gpio, 0);
+        out = true;
     else if (sysfs_streq(buf, "in"))
-        gpiod_direction_input(led_gpio);
+        out = false;
     else
         return -EINVAL;
 
+    mutex_lock(&led_gpio_lock);
+    if (out) {
+        gpiod_direction_output(led_gpio, 0);
+        /* the line now shows 0: keep led_work from skipping a pending 0 */
+        spin_lock(&led_state_lock);
+        led_applied = 0;
+        led_changed_at = jiffies;
+        spin_unlock(&led_state_lock);
+    } else {
+        gpiod_direction_input(led_gpio);
+    }
+    mutex_unlock(&led_gpio_lock);
+
     return count;
 }
 static DEVICE_ATTR_RW(direction);
@@ -50,7 +162,7 @@ static DEVICE_ATTR_RW(direction);
 static ssize_t value_show(struct device *dev,
                           struct device_attribute *attr, char *buf)
 {
-    int val = gpiod_get_value(led_gpio);
+    int val = gpiod_get_value_cansleep(led_gpio);
     return sprintf(buf, "%d\n", val);
 }
 
@@ -64,7 +176,7 @@ static ssize_t value_store(struct device *dev,
         return ret;
 
     if (val == 0 || val == 1)
-        gpiod_set_value(led_gpio, val);
+        led_request(val);
     else
         return -EINVAL;
 
@@ -72,22 +184,100 @@ static ssize_t value_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(value);
 
+/* -------------------------
+ * Sysfs coalescing attributes
+ * -------------------------
+ */
+static ssize_t coalesce_ms_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%u\n", READ_ONCE(led_coalesce_ms));
+}
+
+static ssize_t coalesce_ms_store(struct device *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    unsigned int val;
+    int ret = kstrtouint(buf, 0, &val);
+    if (ret)
+        return ret;
+
+    spin_lock(&led_state_lock);
+    led_coalesce_ms = val;
+    spin_unlock(&led_state_lock);
+    return count;
+}
+static DEVICE_ATTR_RW(coalesce_ms);
+
+static ssize_t min_hold_ms_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%u\n", READ_ONCE(led_hold_ms));
+}
+
+static ssize_t min_hold_ms_store(struct device *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    unsigned int val;
+    int ret = kstrtouint(buf, 0, &val);
+    if (ret)
+        return ret;
+
+    spin_lock(&led_state_lock);
+    led_hold_ms = val;
+    spin_unlock(&led_state_lock);
+    return count;
+}
+static DEVICE_ATTR_RW(min_hold_ms);
+
+static ssize_t write_stats_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    u64 writes, ops;
+
+    spin_lock(&led_state_lock);
+    writes = led_writes;
+    ops = led_gpio_ops;
+    spin_unlock(&led_state_lock);
+
+    return sprintf(buf, "writes=%llu gpio_ops=%llu saved=%llu\n",
+                   writes, ops, writes - ops);
+}
+static DEVICE_ATTR_RO(write_stats);
+
 /* -------------------------
  * Character device write()
  * -------------------------
  */
+/*
+ * A write may carry several states ("1010\n", "1 0 1"): every '0'/'1' is a
+ * state, whitespace is ignored, and only the last one matters - the ones
+ * before it would be overwritten within the same write anyway.
+ */
 static ssize_t myled_write(struct file *file, const char __user *buf,
                            size_t len, loff_t *ppos)
 {
-    char kbuf[2];
-    if (len > 1) len = 1;
-    if (copy_from_user(kbuf, buf, len))
-        return -EFAULT;
+    char kbuf[64];
+    size_t done = 0, n, i;
+    int val = -1;
+
+    while (done < len) {
+        n = min(len - done, sizeof(kbuf));
+        if (copy_from_user(kbuf, buf + done, n))
+            return -EFAULT;
+
+        /* anything but '0'/'1' is ignored, as it always was */
+        for (i = 0; i < n; i++) {
+            if (kbuf[i] == '0' || kbuf[i] == '1')
+                val = kbuf[i] - '0';
+        }
+        done += n;
+    }
 
-    if (kbuf[0] == '1')
-        gpiod_set_value(led_gpio, 1);
-    else if (kbuf[0] == '0')
-        gpiod_set_value(led_gpio, 0);
+    if (val >= 0)
+        led_request(val);
 
     return len;
 }
@@ -110,6 +300,14 @@ static int myled_probe(struct platform_device *pdev)
     if (IS_ERR(led_gpio))
         return PTR_ERR(led_gpio);
 
+    led_pending = -1;
+    led_applied = 0;
+    led_changed_at = jiffies;
+    led_coalesce_ms = coalesce_ms;
+    led_hold_ms = min_hold_ms;
+    led_writes = led_gpio_ops = 0;
+    INIT_DELAYED_WORK(&led_work, led_work_fn);
+
     // Allocate char dev
     ret = alloc_chrdev_region(&devno, 0, 1, DRIVER_NAME);
     if (ret < 0) return ret;
@@ -135,10 +333,22 @@ static int myled_probe(struct platform_device *pdev)
     if (ret) goto destroy_device;
     ret = device_create_file(myled_dev, &dev_attr_value);
     if (ret) goto remove_direction;
+    ret = device_create_file(myled_dev, &dev_attr_coalesce_ms);
+    if (ret) goto remove_value;
+    ret = device_create_file(myled_dev, &dev_attr_min_hold_ms);
+    if (ret) goto remove_coalesce;
+    ret = device_create_file(myled_dev, &dev_attr_write_stats);
+    if (ret) goto remove_hold;
 
     dev_info(&pdev->dev, "myled driver probed\n");
     return 0;
 
+remove_hold:
+    device_remove_file(myled_dev, &dev_attr_min_hold_ms);
+remove_coalesce:
+    device_remove_file(myled_dev, &dev_attr_coalesce_ms);
+remove_value:
+    device_remove_file(myled_dev, &dev_attr_value);
 remove_direction:
     device_remove_file(myled_dev, &dev_attr_direction);
 destroy_device:
@@ -154,12 +364,18 @@ unregister_region:
 
 static int myled_remove(struct platform_device *pdev)
 {
+    device_remove_file(myled_dev, &dev_attr_write_stats);
+    device_remove_file(myled_dev, &dev_attr_min_hold_ms);
+    device_remove_file(myled_dev, &dev_attr_coalesce_ms);
     device_remove_file(myled_dev, &dev_attr_value);
     device_remove_file(myled_dev, &dev_attr_direction);
     device_destroy(myled_class, devno);
     class_destroy(myled_class);
     cdev_del(&myled_cdev);
     unregister_chrdev_region(devno, 1);
+
+    /* no writer left: drop a state still waiting in the window */
+    cancel_delayed_work_sync(&led_work);
     return 0;
 }
 
@@ -0,0 +1,104 @@
+/*
+ * bench_dump.c - dump the full 256-register map, byte by byte through the
+ * reg_addr/reg_data sysfs pair versus one pread() on /dev/myi2c-<bus>-<addr>.
+ *
+ * gcc -O2 -o bench_dump bench_dump.c
+ * sudo ./bench_dump <sysfs_dir> <dev> [loops]
+ *   e.g. ./bench_dump /sys/bus/i2c/devices/11-0050 /dev/myi2c-11-50 100
+ *
+ * Put the driver in cache_mode=bypass first, so the sysfs path really
+ * reads every register from the bus as well.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#define NR_REGS 256
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int open_attr(const char *dir, const char *name, int flags)
+{
+	char path[512];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fd = open(path, flags);
+	if (fd < 0) {
+		perror(path);
+		exit(2);
+	}
+	return fd;
+}
+
+static void dump_sysfs(int addr_fd, int data_fd, uint8_t *map)
+{
+	char buf[16];
+	int reg, n;
+
+	for (reg = 0; reg < NR_REGS; reg++) {
+		n = snprintf(buf, sizeof(buf), "%d", reg);
+		if (pwrite(addr_fd, buf, n, 0) != n) {
+			perror("reg_addr");
+			exit(2);
+		}
+		n = pread(data_fd, buf, sizeof(buf) - 1, 0);
+		if (n <= 0) {
+			perror("reg_data");
+			exit(2);
+		}
+		buf[n] = '\0';
+		map[reg] = strtoul(buf, NULL, 0);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t a[NR_REGS], b[NR_REGS];
+	int loops = argc > 3 ? atoi(argv[3]) : 100;
+	int addr_fd, data_fd, dev_fd, i;
+	uint64_t t0, t_sysfs, t_dev;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <sysfs_dir> <dev> [loops]\n", argv[0]);
+		return 1;
+	}
+	addr_fd = open_attr(argv[1], "reg_addr", O_WRONLY);
+	data_fd = open_attr(argv[1], "reg_data", O_RDONLY);
+	dev_fd = open(argv[2], O_RDONLY);
+	if (dev_fd < 0) {
+		perror(argv[2]);
+		return 2;
+	}
+
+	t0 = now_ns();
+	for (i = 0; i < loops; i++)
+		dump_sysfs(addr_fd, data_fd, a);
+	t_sysfs = (now_ns() - t0) / loops;
+
+	t0 = now_ns();
+	for (i = 0; i < loops; i++) {
+		if (pread(dev_fd, b, NR_REGS, 0) != NR_REGS) {
+			perror("pread");
+			return 2;
+		}
+	}
+	t_dev = (now_ns() - t0) / loops;
+
+	/* STATUS (0x30) clears on read and the samples move: compare the rest */
+	printf("sysfs : %8.1f us per dump (%d syscalls)\n", t_sysfs / 1e3, 2 * NR_REGS);
+	printf("block : %8.1f us per dump (1 syscall)\n", t_dev / 1e3);
+	printf("speedup %.1fx, static registers %s\n", (double)t_sysfs / t_dev,
+	       memcmp(a, b, 0x20) ? "DIFFER" : "match");
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * bench_queue.c - N threads pread() small, overlapping windows of the
+ * DATA registers (0x20..0x2f) on /dev/myi2c-<bus>-<addr>, once with the
+ * driver's request merging on and once with it off.
+ *
+ * gcc -O2 -pthread -o bench_queue bench_queue.c
+ * sudo ./bench_queue <sysfs_dir> <dev> [threads] [seconds]
+ *   e.g. ./bench_queue /sys/bus/i2c/devices/11-0050 /dev/myi2c-11-50 8 5
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define DATA_REG	0x20
+#define DATA_LEN	16
+#define MAX_LAT		(1 << 20)
+
+struct worker {
+	pthread_t tid;
+	int fd;
+	unsigned int seed;
+	uint64_t *lat;
+	size_t nlat;
+	uint64_t ops;
+};
+
+static const char *sysfs_dir;
+static volatile int stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void write_attr(const char *name, const char *val)
+{
+	char path[512];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_dir, name);
+	f = fopen(path, "w");
+	if (!f || fputs(val, f) < 0 || fclose(f)) {
+		perror(path);
+		exit(2);
+	}
+}
+
+static void read_stats(unsigned long long *req, unsigned long long *xfer)
+{
+	char path[512];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/queue_stats", sysfs_dir);
+	f = fopen(path, "r");
+	if (!f || fscanf(f, "requests=%llu transfers=%llu", req, xfer) != 2) {
+		perror(path);
+		exit(2);
+	}
+	fclose(f);
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	uint8_t buf[DATA_LEN];
+	uint64_t t0;
+	int off, len;
+
+	while (!stop) {
+		/* 2..8 registers somewhere inside DATA, so windows overlap */
+		len = 2 + rand_r(&w->seed) % 7;
+		off = rand_r(&w->seed) % (DATA_LEN - len + 1);
+
+		t0 = now_ns();
+		if (pread(w->fd, buf, len, DATA_REG + off) != len) {
+			perror("pread");
+			exit(2);
+		}
+		if (w->nlat < MAX_LAT)
+			w->lat[w->nlat++] = now_ns() - t0;
+		w->ops++;
+	}
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void run(const char *dev, int nthreads, int seconds, int merge)
+{
+	struct worker *w = calloc(nthreads, sizeof(*w));
+	unsigned long long req0, xfer0, req1, xfer1;
+	uint64_t *all, ops = 0;
+	size_t n = 0;
+	int i;
+
+	write_attr("queue_merge", merge ? "1" : "0");
+	read_stats(&req0, &xfer0);
+
+	stop = 0;
+	for (i = 0; i < nthreads; i++) {
+		w[i].fd = open(dev, O_RDONLY);
+		if (w[i].fd < 0) {
+			perror(dev);
+			exit(2);
+		}
+		w[i].seed = i + 1;
+		w[i].lat = malloc(MAX_LAT * sizeof(uint64_t));
+		pthread_create(&w[i].tid, NULL, worker_fn, &w[i]);
+	}
+	sleep(seconds);
+	stop = 1;
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(w[i].tid, NULL);
+		close(w[i].fd);
+		n += w[i].nlat;
+		ops += w[i].ops;
+	}
+	read_stats(&req1, &xfer1);
+
+	all = malloc((n ? n : 1) * sizeof(uint64_t));
+	for (n = 0, i = 0; i < nthreads; i++) {
+		memcpy(all + n, w[i].lat, w[i].nlat * sizeof(uint64_t));
+		n += w[i].nlat;
+		free(w[i].lat);
+	}
+	qsort(all, n, sizeof(uint64_t), cmp_u64);
+
+	printf("merge=%d: %8.0f req/s  p50 %7.1f us  p99 %7.1f us  "
+	       "%llu requests -> %llu transfers (%.2f req/transfer)\n",
+	       merge, (double)ops / seconds,
+	       n ? all[n / 2] / 1e3 : 0.0, n ? all[n * 99 / 100] / 1e3 : 0.0,
+	       req1 - req0, xfer1 - xfer0,
+	       xfer1 > xfer0 ? (double)(req1 - req0) / (xfer1 - xfer0) : 0.0);
+	free(all);
+	free(w);
+}
+
+int main(int argc, char *argv[])
+{
+	int nthreads = argc > 3 ? atoi(argv[3]) : 8;
+	int seconds = argc > 4 ? atoi(argv[4]) : 5;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <sysfs_dir> <dev> [threads] [seconds]\n", argv[0]);
+		return 1;
+	}
+	sysfs_dir = argv[1];
+
+	run(argv[2], nthreads, seconds, 0);
+	run(argv[2], nthreads, seconds, 1);
+	return 0;
+}
@@ -0,0 +1,85 @@
+#!/bin/sh
+# Bind many myi2cdev clients on one adapter, time how long until all of them
+# are probed, then let the shared sampler run on the ones that answer and
+# report the aggregate sample rate.
+#
+#   sudo ./i2c_scale_test.sh [clients] [period_us] [seconds]
+#
+# Needs CONFIG_I2C_STUB and myi2c.ko built (make) in this directory.
+# i2c-stub emulates at most 10 chips, so only the first 10 addresses have a
+# register file behind them; the rest still probe (probe does no bus I/O)
+# but are left out of the sampling part.
+
+CLIENTS=${1:-64}
+PERIOD=${2:-1000}
+SECS=${3:-10}
+FIRST=16        # 0x10: addresses 0x10.. avoid the reserved 0x00-0x07
+CHIPS=10
+
+addr() { printf "0x%02x" $((FIRST + $1)); }
+
+STUB=$(addr 0)
+i=1
+while [ $i -lt $CHIPS ] && [ $i -lt $CLIENTS ]; do
+    STUB=$STUB,$(addr $i)
+    i=$((i + 1))
+done
+
+modprobe i2c-stub chip_addr=$STUB || exit 1
+insmod myi2c.ko || exit 1
+
+BUS=$(grep -l "SMBus stub driver" /sys/bus/i2c/devices/i2c-*/name | head -1 | xargs dirname)
+NR=$(basename $BUS | cut -d- -f2)
+DRV=/sys/bus/i2c/drivers/myi2cdev
+
+START=$(date +%s%N)
+i=0
+while [ $i -lt $CLIENTS ]; do
+    echo myi2cdev $(addr $i) > $BUS/new_device
+    i=$((i + 1))
+done
+# probes run asynchronously: wait until every client is bound
+while [ $(ls -d $DRV/$NR-* 2>/dev/null | wc -l) -lt $CLIENTS ]; do
+    sleep 0.001
+done
+END=$(date +%s%N)
+echo "probe: $CLIENTS clients bound in $(( (END - START) / 1000000 )) ms"
+
+dev() { printf "%s/%s-00%02x" $BUS $NR $((FIRST + $1)); }
+
+SAMPLED=$CHIPS
+[ $CLIENTS -lt $SAMPLED ] && SAMPLED=$CLIENTS
+i=0
+while [ $i -lt $SAMPLED ]; do
+    echo $PERIOD > $(dev $i)/sample_period_us
+    i=$((i + 1))
+done
+sleep $SECS
+i=0
+while [ $i -lt $SAMPLED ]; do
+    echo 0 > $(dev $i)/sample_period_us
+    i=$((i + 1))
+done
+
+TOTAL=0
+MISSED=0
+i=0
+while [ $i -lt $SAMPLED ]; do
+    STATS=$(cat $(dev $i)/sample_stats)
+    N=$(echo "$STATS" | sed 's/.*samples=\([0-9]*\).*/\1/')
+    M=$(echo "$STATS" | sed 's/.*missed=\([0-9]*\).*/\1/')
+    TOTAL=$((TOTAL + N))
+    MISSED=$((MISSED + M))
+    i=$((i + 1))
+done
+echo "sampling: $SAMPLED clients @ ${PERIOD} us: $((TOTAL / SECS)) samples/s" \
+     "(ideal $((SAMPLED * 1000000 / PERIOD))), $MISSED missed"
+echo "queue: $(cat $(dev 0)/queue_stats)"
+
+i=0
+while [ $i -lt $CLIENTS ]; do
+    echo $(addr $i) > $BUS/delete_device
+    i=$((i + 1))
+done
+rmmod myi2c
+rmmod i2c-stub
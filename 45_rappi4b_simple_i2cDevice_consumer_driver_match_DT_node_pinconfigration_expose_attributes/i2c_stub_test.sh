@@ -0,0 +1,49 @@
+#!/bin/sh
+# Count real bus transactions of a typical polling loop against i2c-stub,
+# once through the regcache (cache_mode=normal) and once with every access
+# going to the bus (cache_mode=bypass).
+#
+#   sudo ./i2c_stub_test.sh [loops]
+#
+# Needs CONFIG_I2C_STUB, tracefs, and myi2c.ko built (make) in this directory.
+# Transactions are counted with the i2c:smbus_read/smbus_write tracepoints.
+
+LOOPS=${1:-1000}
+ADDR=0x50
+T=/sys/kernel/tracing
+[ -d $T/events ] || T=/sys/kernel/debug/tracing
+
+modprobe i2c-stub chip_addr=$ADDR || exit 1
+insmod myi2c.ko || exit 1
+
+BUS=$(grep -l "SMBus stub driver" /sys/bus/i2c/devices/i2c-*/name | head -1 | xargs dirname)
+echo myi2cdev $ADDR > $BUS/new_device
+DEV=$BUS/$(basename $BUS | cut -d- -f2)-00${ADDR#0x}
+
+echo 1 > $T/events/i2c/smbus_read/enable
+echo 1 > $T/events/i2c/smbus_write/enable
+
+poll_loop() {
+    i=0
+    while [ $i -lt $LOOPS ]; do
+        cat $DEV/info $DEV/value $DEV/data > /dev/null
+        i=$((i + 1))
+    done
+}
+
+for MODE in bypass normal; do
+    echo $MODE > $DEV/cache_mode
+    echo > $T/trace
+    START=$(date +%s%N)
+    poll_loop
+    END=$(date +%s%N)
+    N=$(grep -c "smbus_\(read\|write\):" $T/trace)
+    echo "$MODE: $LOOPS polls, $N bus transactions, $(( (END - START) / LOOPS / 1000 )) us/poll"
+done
+
+echo 0 > $T/events/i2c/smbus_read/enable
+echo 0 > $T/events/i2c/smbus_write/enable
+
+echo $ADDR > $BUS/delete_device
+rmmod myi2c
+rmmod i2c-stub
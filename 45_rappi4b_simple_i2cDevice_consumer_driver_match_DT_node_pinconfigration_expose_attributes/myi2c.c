@@ -3,11 +3,214 @@
 #include <linux/i2c.h>
 #include <linux/device.h>
 #include <linux/slab.h>
+#include <linux/regmap.h>
+#include <linux/mutex.h>
+#include <linux/fs.h>
+#include <linux/cdev.h>
+#include <linux/idr.h>
+#include <linux/uaccess.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/log2.h>
+#include <linux/list.h>
+#include <linux/list_sort.h>
+#include <linux/completion.h>
+#include <linux/math64.h>
+#include <linux/kref.h>
+#include <linux/rwsem.h>
+#include "sample_ring.h"
 
-/* Private device data */
+/*
+ * Register map of the (fake) device, 256 x 8-bit registers:
+ *
+ *   0x00        WHO_AM_I   read-only, never changes  -> cached
+ *   0x01..0x0f  CONFIG     read/write                -> cached
+ *   0x10        VALUE      read/write                -> cached ("value")
+ *   0x20..0x2f  DATA       read-only sensor samples  -> volatile
+ *   0x30        STATUS     read clears it            -> volatile + precious
+ *
+ * Anything cached is read from the bus once and then served from the
+ * regcache, so polling static registers costs no bus traffic at all.
+ */
+#define MYI2C_REG_WHO_AM_I      0x00
+#define MYI2C_REG_CONFIG        0x01
+#define MYI2C_REG_CONFIG_END    0x0f
+#define MYI2C_REG_VALUE         0x10
+#define MYI2C_REG_DATA          0x20
+#define MYI2C_REG_DATA_END      0x2f
+#define MYI2C_REG_STATUS        0x30
+#define MYI2C_REG_MAX           0xff
+#define MYI2C_NR_REGS           (MYI2C_REG_MAX + 1)
+
+#define MYI2C_MAX_MINORS        256 /* /dev/myi2c-* nodes this driver can serve */
+#define MYI2C_MAX_RING_RECORDS  (1U << 20) /* ring_records cap, 56 MiB of vmalloc per device */
+
+static unsigned int ring_records = 4096;
+module_param(ring_records, uint, 0444);
+MODULE_PARM_DESC(ring_records, "Samples kept per device (rounded up to a power of 2, at most 1M)");
+
+struct myi2cdev_data;
+
+/* One queued register access; lives on the submitter's stack */
+struct myi2c_req {
+    struct list_head node;
+    struct myi2cdev_data *data;     /* client it is addressed to */
+    bool write;
+    u8 reg;
+    u16 len;
+    u8 *buf;
+    int status;
+    struct completion done;
+};
+
+struct myi2c_queue_stats {
+    u64 requests;
+    u64 transfers;          /* block transfers the worker issued for them */
+};
+
+struct myi2c_sampler_stats {
+    u64 samples;
+    u64 errors;             /* failed transfers */
+    u64 missed;             /* periods skipped because the last read was still running */
+    u64 late_max_ns;        /* worst (transfer start - scheduled time) */
+    u64 read_ns;            /* sum of queue wait + transfer, from queuing each read to
+                               publishing it; latency, not CPU time */
+};
+
+/*
+ * State shared by every myi2cdev client on one adapter: a rack board with
+ * dozens of identical sensors on a bus gets one request worker owning the
+ * bus and one timer + work item sampling all of them, not one of each per
+ * sensor fighting over the adapter lock.
+ */
+struct myi2c_bus {
+    struct list_head node;      /* on myi2c_buses */
+    struct i2c_adapter *adap;
+    unsigned int users;         /* clients bound; protected by myi2c_buses_lock */
+
+    /* request queue (see REQUEST QUEUE below) */
+    spinlock_t req_lock;        /* protects req_list and qstats */
+    struct list_head req_list;
+    struct work_struct req_work;
+    bool merge;                 /* combine adjacent/overlapping requests */
+    u8 span_buf[MYI2C_NR_REGS]; /* worker-only bounce buffer for merged spans */
+    struct myi2c_queue_stats qstats;
+
+    /* sampler (see SAMPLER below) */
+    struct mutex sample_lock;   /* clients list, their sampling config, a sampling pass */
+    struct list_head clients;
+    struct hrtimer sample_timer;
+    struct work_struct sample_work;
+};
+
+enum myi2c_cache_mode {
+    MYI2C_CACHE_NORMAL,
+    MYI2C_CACHE_ONLY,
+    MYI2C_CACHE_BYPASS,
+};
+
+static const char * const myi2c_cache_modes[] = {
+    [MYI2C_CACHE_NORMAL] = "normal",
+    [MYI2C_CACHE_ONLY]   = "cache_only",
+    [MYI2C_CACHE_BYPASS] = "bypass",
+};
+
+/*
+ * Private device data. Not devm: open files of the two char devices may
+ * outlive the binding, so it is freed on the last myi2c_data_put() of
+ * probe, the two struct devices and every open file.
+ */
 struct myi2cdev_data {
+    struct kref kref;
     struct i2c_client *client;
-    u8 value;   /* fake register value */
+    struct regmap *regmap;
+    struct mutex mode_lock;     /* serializes cache_mode switches */
+    enum myi2c_cache_mode cache_mode;
+    u8 reg_addr;                /* register selected for "reg_data" */
+    struct myi2c_bus *bus;
+    struct rw_semaphore remove_sem; /* held for reading across a bus access */
+    bool removed;               /* unbound: file ops fail with -ENODEV */
+
+    /* /dev/myi2c-<bus>-<addr>: file offset = register address */
+    struct cdev cdev;
+    dev_t devt;
+    struct device chrdev;
+
+    /* sampling config, protected by bus->sample_lock */
+    struct list_head bus_node;  /* on bus->clients */
+    u32 sample_period_us;       /* 0 = stopped */
+    u8 sample_reg;
+    u8 sample_len;
+    ktime_t sample_due;         /* next scheduled sample */
+    struct myi2c_req sample_req;
+    bool sampling;              /* sample_req is queued in this pass */
+
+    /* sample ring, written only by the sampling pass */
+    struct myi2c_ring_hdr *ring;        /* vmalloc_user(): header page + records */
+    struct myi2c_sample *records;
+    u32 ring_mask;
+    wait_queue_head_t sample_wq;
+    spinlock_t stats_lock;
+    struct myi2c_sampler_stats stats;
+
+    /* /dev/myi2c-<bus>-<addr>-samples: blocking/pollable stream + mmap */
+    struct cdev samples_cdev;
+    dev_t samples_devt;
+    struct device samples_dev;
+};
+
+/* Shared by every client: one class, one chrdev region, minors from an IDA */
+static struct class *myi2c_class;
+static dev_t myi2c_devt_base;
+static DEFINE_IDA(myi2c_ida);
+
+/* One struct myi2c_bus per adapter with at least one client bound */
+static LIST_HEAD(myi2c_buses);
+static DEFINE_MUTEX(myi2c_buses_lock);
+
+static const struct regmap_range myi2cdev_volatile_ranges[] = {
+    regmap_reg_range(MYI2C_REG_DATA, MYI2C_REG_DATA_END),
+    regmap_reg_range(MYI2C_REG_STATUS, MYI2C_REG_STATUS),
+};
+
+static const struct regmap_access_table myi2cdev_volatile_table = {
+    .yes_ranges = myi2cdev_volatile_ranges,
+    .n_yes_ranges = ARRAY_SIZE(myi2cdev_volatile_ranges),
+};
+
+static const struct regmap_range myi2cdev_precious_ranges[] = {
+    regmap_reg_range(MYI2C_REG_STATUS, MYI2C_REG_STATUS),
+};
+
+static const struct regmap_access_table myi2cdev_precious_table = {
+    .yes_ranges = myi2cdev_precious_ranges,
+    .n_yes_ranges = ARRAY_SIZE(myi2cdev_precious_ranges),
+};
+
+/* WHO_AM_I, the samples and STATUS are read-only */
+static const struct regmap_range myi2cdev_ro_ranges[] = {
+    regmap_reg_range(MYI2C_REG_WHO_AM_I, MYI2C_REG_WHO_AM_I),
+    regmap_reg_range(MYI2C_REG_DATA, MYI2C_REG_STATUS),
+};
+
+static const struct regmap_access_table myi2cdev_wr_table = {
+    .no_ranges = myi2cdev_ro_ranges,
+    .n_no_ranges = ARRAY_SIZE(myi2cdev_ro_ranges),
+};
+
+static const struct regmap_config myi2cdev_regmap_config = {
+    .reg_bits = 8,
+    .val_bits = 8,
+    .max_register = MYI2C_REG_MAX,
+    .volatile_table = &myi2cdev_volatile_table,
+    .precious_table = &myi2cdev_precious_table,
+    .wr_table = &myi2cdev_wr_table,
+    .cache_type = REGCACHE_RBTREE,
 };
 
 /* Sysfs show/store for "value" */
@@ -15,7 +218,14 @@ static ssize_t value_show(struct device *dev,
                           struct device_attribute *attr, char *buf)
 {
     struct myi2cdev_data *data = dev_get_drvdata(dev);
-    return sprintf(buf, "%u\n", data->value);
+    unsigned int val;
+    int ret;
+
+    ret = regmap_read(data->regmap, MYI2C_REG_VALUE, &val);
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "%u\n", val);
 }
 
 static ssize_t value_store(struct device *dev,
@@ -30,10 +240,12 @@ static ssize_t value_store(struct device *dev,
     if (ret)
         return ret;
 
-    data->value = val;
+    /* write-through: the cache is updated, the bus sees one byte write */
+    ret = regmap_write(data->regmap, MYI2C_REG_VALUE, val);
+    if (ret)
+        return ret;
 
-    /* here you would normally talk to the device via i2c_smbus_write_byte_data */
-    dev_info(dev, "New value written: %u\n", data->value);
+    dev_dbg(dev, "New value written: %u\n", val);
 
     return count;
 }
@@ -45,55 +257,1202 @@ static ssize_t info_show(struct device *dev,
                          struct device_attribute *attr, char *buf)
 {
     struct myi2cdev_data *data = dev_get_drvdata(dev);
+    unsigned int id, val;
+    int ret;
+
+    ret = regmap_read(data->regmap, MYI2C_REG_WHO_AM_I, &id);
+    if (!ret)
+        ret = regmap_read(data->regmap, MYI2C_REG_VALUE, &val);
+    if (ret)
+        return ret;
 
     return sprintf(buf,
-        "Fake I2C device @ addr 0x%02x, last value=%u\n",
-        data->client->addr, data->value);
+        "Fake I2C device @ addr 0x%02x, id=0x%02x, last value=%u\n",
+        data->client->addr, id, val);
 }
 
 static DEVICE_ATTR_RO(info);
 
+/* Sysfs show for "data": the sample registers, always read from the bus */
+static ssize_t data_show(struct device *dev,
+                         struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    u8 raw[MYI2C_REG_DATA_END - MYI2C_REG_DATA + 1];
+    int ret;
+
+    ret = regmap_bulk_read(data->regmap, MYI2C_REG_DATA, raw, sizeof(raw));
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "%*phN\n", (int)sizeof(raw), raw);
+}
+
+static DEVICE_ATTR_RO(data);
+
+/* Sysfs show for "status": reading it clears it on the device */
+static ssize_t status_show(struct device *dev,
+                           struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    unsigned int val;
+    int ret;
+
+    ret = regmap_read(data->regmap, MYI2C_REG_STATUS, &val);
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "0x%02x\n", val);
+}
+
+static DEVICE_ATTR_RO(status);
+
+/*
+ * Sysfs "cache_mode":
+ *   normal     - cached registers come from the regcache, writes go through
+ *   cache_only - no bus access; writes only update the cache (device asleep)
+ *   bypass     - every access goes to the bus, the cache is left alone
+ * Leaving cache_only syncs the writes made meanwhile to the device.
+ */
+static ssize_t cache_mode_show(struct device *dev,
+                               struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%s\n", myi2c_cache_modes[READ_ONCE(data->cache_mode)]);
+}
+
+static ssize_t cache_mode_store(struct device *dev,
+                                struct device_attribute *attr,
+                                const char *buf, size_t count)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    int mode, ret = 0;
+
+    mode = sysfs_match_string(myi2c_cache_modes, buf);
+    if (mode < 0)
+        return mode;
+
+    mutex_lock(&data->mode_lock);
+    /* regmap refuses (WARNs) cache_only and bypass at once: clear both first */
+    regcache_cache_only(data->regmap, false);
+    regcache_cache_bypass(data->regmap, false);
+    if (data->cache_mode == MYI2C_CACHE_ONLY && mode != MYI2C_CACHE_ONLY)
+        ret = regcache_sync(data->regmap);
+    if (mode == MYI2C_CACHE_ONLY)
+        regcache_cache_only(data->regmap, true);
+    else if (mode == MYI2C_CACHE_BYPASS)
+        regcache_cache_bypass(data->regmap, true);
+    WRITE_ONCE(data->cache_mode, mode);
+    mutex_unlock(&data->mode_lock);
+
+    return ret ? ret : count;
+}
+
+static DEVICE_ATTR_RW(cache_mode);
+
+/*
+ * Sysfs "reg_addr" + "reg_data": one register per round trip, through
+ * regmap (so it honours cache_mode). Handy from a shell, slow for dumps.
+ */
+static ssize_t reg_addr_show(struct device *dev,
+                             struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+
+    return sprintf(buf, "0x%02x\n", READ_ONCE(data->reg_addr));
+}
+
+static ssize_t reg_addr_store(struct device *dev,
+                              struct device_attribute *attr,
+                              const char *buf, size_t count)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    u8 reg;
+    int ret;
+
+    ret = kstrtou8(buf, 0, &reg);
+    if (ret)
+        return ret;
+
+    WRITE_ONCE(data->reg_addr, reg);
+    return count;
+}
+
+static DEVICE_ATTR_RW(reg_addr);
+
+static ssize_t reg_data_show(struct device *dev,
+                             struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    unsigned int val;
+    int ret;
+
+    ret = regmap_read(data->regmap, READ_ONCE(data->reg_addr), &val);
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "0x%02x\n", val);
+}
+
+static ssize_t reg_data_store(struct device *dev,
+                              struct device_attribute *attr,
+                              const char *buf, size_t count)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    u8 val;
+    int ret;
+
+    ret = kstrtou8(buf, 0, &val);
+    if (ret)
+        return ret;
+
+    ret = regmap_write(data->regmap, READ_ONCE(data->reg_addr), val);
+    return ret ? ret : count;
+}
+
+static DEVICE_ATTR_RW(reg_data);
+
+/*
+ * Block register access for the character device. The best transfer the
+ * adapter supports is used:
+ *   I2C_FUNC_I2C              - one i2c_transfer() for the whole range
+ *   SMBus I2C block           - 32-byte i2c_smbus_{read,write}_i2c_block_data()
+ *   otherwise                 - one SMBus byte op per register
+ * This goes around regmap (it is a raw window, like i2cdump/i2cset), so
+ * cached copies of written registers are dropped afterwards.
+ */
+static int myi2cdev_block_read(struct myi2cdev_data *data, u8 reg, u8 *buf, size_t len)
+{
+    struct i2c_client *client = data->client;
+    size_t done = 0;
+    int ret, n;
+
+    if (i2c_check_functionality(client->adapter, I2C_FUNC_I2C)) {
+        struct i2c_msg msgs[2] = {
+            { .addr = client->addr, .flags = 0, .len = 1, .buf = &reg },
+            { .addr = client->addr, .flags = I2C_M_RD, .len = len, .buf = buf },
+        };
+
+        ret = i2c_transfer(client->adapter, msgs, 2);
+        return ret == 2 ? 0 : ret < 0 ? ret : -EIO;
+    }
+
+    while (done < len) {
+        if (i2c_check_functionality(client->adapter, I2C_FUNC_SMBUS_READ_I2C_BLOCK)) {
+            n = min_t(size_t, len - done, I2C_SMBUS_BLOCK_MAX);
+            ret = i2c_smbus_read_i2c_block_data(client, reg + done, n, buf + done);
+            if (ret < 0)
+                return ret;
+            if (ret == 0)
+                return -EIO;
+            done += ret;
+        } else {
+            ret = i2c_smbus_read_byte_data(client, reg + done);
+            if (ret < 0)
+                return ret;
+            buf[done++] = ret;
+        }
+    }
+    return 0;
+}
+
+static int myi2cdev_block_write(struct myi2cdev_data *data, u8 reg,
+                                const u8 *buf, size_t len)
+{
+    struct i2c_client *client = data->client;
+    size_t done = 0;
+    int ret = 0, n;
+
+    if (i2c_check_functionality(client->adapter, I2C_FUNC_I2C)) {
+        struct i2c_msg msg = { .addr = client->addr, .flags = 0, .len = len + 1 };
+        u8 *tmp = kmalloc(len + 1, GFP_KERNEL);
+
+        if (!tmp)
+            return -ENOMEM;
+        tmp[0] = reg;
+        memcpy(tmp + 1, buf, len);
+        msg.buf = tmp;
+
+        ret = i2c_transfer(client->adapter, &msg, 1);
+        kfree(tmp);
+        ret = ret == 1 ? 0 : ret < 0 ? ret : -EIO;
+        goto out;
+    }
+
+    while (done < len) {
+        if (i2c_check_functionality(client->adapter, I2C_FUNC_SMBUS_WRITE_I2C_BLOCK)) {
+            n = min_t(size_t, len - done, I2C_SMBUS_BLOCK_MAX);
+            ret = i2c_smbus_write_i2c_block_data(client, reg + done, n, buf + done);
+        } else {
+            n = 1;
+            ret = i2c_smbus_write_byte_data(client, reg + done, buf[done]);
+        }
+        if (ret < 0)
+            goto out;
+        done += n;
+    }
+
+out:
+    /* whatever reached the device, the cache no longer knows it */
+    regcache_drop_region(data->regmap, reg, reg + len - 1);
+    return ret;
+}
+
+/*
+ * REQUEST QUEUE
+ *
+ * Every raw access (character device, sampler) of every client on the
+ * adapter is submitted to the bus queue and waits for its completion,
+ * instead of each caller fighting for the adapter lock on its own. One
+ * work item drains the queue in batches:
+ *   - a run of reads is sorted by client and register, and overlapping or
+ *     adjacent ranges of one client are read with one block transfer
+ *     (duplicate reads collapse);
+ *   - a run of writes is kept in order, and writes that continue exactly
+ *     where the previous one to the same client ended are sent as one block.
+ * Reads never move across writes, so the order a caller sees is preserved.
+ */
+static int myi2c_req_cmp(void *priv, const struct list_head *a,
+                         const struct list_head *b)
+{
+    const struct myi2c_req *ra = list_entry(a, struct myi2c_req, node);
+    const struct myi2c_req *rb = list_entry(b, struct myi2c_req, node);
+
+    if (ra->data != rb->data)
+        return ra->data->client->addr - rb->data->client->addr;
+    return ra->reg - rb->reg;
+}
+
+static void myi2c_req_done(struct myi2c_req *req, int status)
+{
+    list_del(&req->node);
+    req->status = status;
+    complete(&req->done);
+}
+
+/* Move the leading run of reads (or writes) of @batch to @run */
+static void myi2c_req_take_run(struct list_head *batch, struct list_head *run, bool write)
+{
+    struct myi2c_req *req, *tmp;
+
+    list_for_each_entry_safe(req, tmp, batch, node) {
+        if (req->write != write)
+            break;
+        list_move_tail(&req->node, run);
+    }
+}
+
+static unsigned int myi2c_run_reads(struct myi2c_bus *bus,
+                                    struct list_head *run, bool merge)
+{
+    struct myi2c_req *req, *first, *tmp;
+    unsigned int transfers = 0;
+    unsigned int start, end;
+    int ret;
+
+    if (merge)
+        list_sort(NULL, run, myi2c_req_cmp);
+
+    while (!list_empty(run)) {
+        first = list_first_entry(run, struct myi2c_req, node);
+        start = first->reg;
+        end = first->reg + first->len;
+
+        /* grow the span while the next range of the same client touches it */
+        if (merge) {
+            list_for_each_entry(req, run, node) {
+                if (req->data != first->data || req->reg > end)
+                    break;
+                end = max_t(unsigned int, end, req->reg + req->len);
+            }
+        }
+
+        ret = myi2cdev_block_read(first->data, start, bus->span_buf + start,
+                                  end - start);
+        transfers++;
+
+        list_for_each_entry_safe(req, tmp, run, node) {
+            if (req->data != first->data || req->reg >= end)
+                break;
+            if (!ret)
+                memcpy(req->buf, bus->span_buf + req->reg, req->len);
+            myi2c_req_done(req, ret);
+            if (!merge)
+                break;
+        }
+    }
+    return transfers;
+}
+
+static unsigned int myi2c_run_writes(struct myi2c_bus *bus,
+                                     struct list_head *run, bool merge)
+{
+    struct myi2c_req *req, *first, *last, *tmp;
+    unsigned int transfers = 0;
+    unsigned int start, end;
+    int ret;
+
+    while (!list_empty(run)) {
+        first = list_first_entry(run, struct myi2c_req, node);
+        start = first->reg;
+        end = start;
+        last = first;
+
+        /* in submission order: append while the next write starts at 'end' */
+        list_for_each_entry(req, run, node) {
+            if (req != first &&
+                (!merge || req->data != first->data || req->reg != end))
+                break;
+            memcpy(bus->span_buf + req->reg, req->buf, req->len);
+            end = req->reg + req->len;
+            last = req;
+        }
+
+        ret = myi2cdev_block_write(first->data, start, bus->span_buf + start,
+                                   end - start);
+        transfers++;
+
+        list_for_each_entry_safe(req, tmp, run, node) {
+            myi2c_req_done(req, ret);
+            if (req == last)
+                break;
+        }
+    }
+    return transfers;
+}
+
+static void myi2c_req_work(struct work_struct *work)
+{
+    struct myi2c_bus *bus = container_of(work, struct myi2c_bus, req_work);
+    bool merge = READ_ONCE(bus->merge);
+    unsigned int transfers = 0;
+    LIST_HEAD(batch);
+    LIST_HEAD(run);
+    bool write;
+
+    spin_lock(&bus->req_lock);
+    list_splice_init(&bus->req_list, &batch);
+    spin_unlock(&bus->req_lock);
+
+    while (!list_empty(&batch)) {
+        write = list_first_entry(&batch, struct myi2c_req, node)->write;
+        myi2c_req_take_run(&batch, &run, write);
+        transfers += write ? myi2c_run_writes(bus, &run, merge) :
+                             myi2c_run_reads(bus, &run, merge);
+    }
+
+    spin_lock(&bus->req_lock);
+    bus->qstats.transfers += transfers;
+    spin_unlock(&bus->req_lock);
+}
+
+/* Add @req to the bus queue; the caller kicks req_work and waits on req->done */
+static void myi2c_req_queue(struct myi2c_bus *bus, struct myi2c_req *req)
+{
+    init_completion(&req->done);
+
+    spin_lock(&bus->req_lock);
+    list_add_tail(&req->node, &bus->req_list);
+    bus->qstats.requests++;
+    spin_unlock(&bus->req_lock);
+}
+
+/* Queue one access and sleep until the worker has done it */
+static int myi2c_submit(struct myi2cdev_data *data, bool write, u8 reg,
+                        u8 *buf, size_t len)
+{
+    struct myi2c_req req = {
+        .data = data,
+        .write = write,
+        .reg = reg,
+        .len = len,
+        .buf = buf,
+    };
+
+    if (!len)
+        return 0;
+
+    /* remove() waits for us before it drops the bus and the regmap goes */
+    down_read(&data->remove_sem);
+    if (data->removed) {
+        up_read(&data->remove_sem);
+        return -ENODEV;
+    }
+
+    myi2c_req_queue(data->bus, &req);
+    queue_work(system_highpri_wq, &data->bus->req_work);
+    /* req lives on this stack: the worker must be done with it */
+    wait_for_completion(&req.done);
+    up_read(&data->remove_sem);
+
+    return req.status;
+}
+
+/* "queue_merge" and "queue_stats" are per adapter: every client shows the same */
+static ssize_t queue_merge_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%d\n", READ_ONCE(data->bus->merge));
+}
+
+static ssize_t queue_merge_store(struct device *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    bool merge;
+    int ret;
+
+    ret = kstrtobool(buf, &merge);
+    if (ret)
+        return ret;
+
+    /* the worker samples it once per batch */
+    WRITE_ONCE(data->bus->merge, merge);
+    return count;
+}
+
+static DEVICE_ATTR_RW(queue_merge);
+
+static ssize_t queue_stats_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    struct myi2c_bus *bus = data->bus;
+    struct myi2c_queue_stats st;
+
+    spin_lock(&bus->req_lock);
+    st = bus->qstats;
+    spin_unlock(&bus->req_lock);
+
+    return sprintf(buf, "requests=%llu transfers=%llu merged=%llu\n",
+                   st.requests, st.transfers, st.requests - st.transfers);
+}
+
+static DEVICE_ATTR_RO(queue_stats);
+
+static void myi2c_data_release(struct kref *kref)
+{
+    struct myi2cdev_data *data = container_of(kref, struct myi2cdev_data, kref);
+
+    vfree(data->ring);
+    kfree(data);
+}
+
+static void myi2c_data_put(struct myi2cdev_data *data)
+{
+    kref_put(&data->kref, myi2c_data_release);
+}
+
+/* Character device: pread/pwrite at offset N = registers N.. in one go */
+static int myi2cdev_open(struct inode *inode, struct file *file)
+{
+    struct myi2cdev_data *data = container_of(inode->i_cdev, struct myi2cdev_data, cdev);
+
+    /* the cdev pins chrdev, which holds a reference, so data is still here */
+    kref_get(&data->kref);
+    file->private_data = data;
+    return 0;
+}
+
+static int myi2cdev_release(struct inode *inode, struct file *file)
+{
+    myi2c_data_put(file->private_data);
+    return 0;
+}
+
+static loff_t myi2cdev_llseek(struct file *file, loff_t offset, int whence)
+{
+    return fixed_size_llseek(file, offset, whence, MYI2C_NR_REGS);
+}
+
+static ssize_t myi2cdev_read(struct file *file, char __user *ubuf,
+                             size_t len, loff_t *ppos)
+{
+    struct myi2cdev_data *data = file->private_data;
+    u8 *kbuf;
+    int ret;
+
+    if (*ppos >= MYI2C_NR_REGS)
+        return 0;
+    len = min_t(size_t, len, MYI2C_NR_REGS - *ppos);
+    if (!len)
+        return 0;
+
+    /* the device is asleep in cache_only: keep off the bus */
+    if (READ_ONCE(data->cache_mode) == MYI2C_CACHE_ONLY)
+        return -EBUSY;
+
+    kbuf = kmalloc(len, GFP_KERNEL);
+    if (!kbuf)
+        return -ENOMEM;
+
+    ret = myi2c_submit(data, false, *ppos, kbuf, len);
+    if (!ret && copy_to_user(ubuf, kbuf, len))
+        ret = -EFAULT;
+    kfree(kbuf);
+    if (ret)
+        return ret;
+
+    *ppos += len;
+    return len;
+}
+
+static ssize_t myi2cdev_write(struct file *file, const char __user *ubuf,
+                              size_t len, loff_t *ppos)
+{
+    struct myi2cdev_data *data = file->private_data;
+    u8 *kbuf;
+    int ret;
+
+    if (*ppos >= MYI2C_NR_REGS)
+        return -ENOSPC;
+    len = min_t(size_t, len, MYI2C_NR_REGS - *ppos);
+    if (!len)
+        return 0;
+
+    if (READ_ONCE(data->cache_mode) == MYI2C_CACHE_ONLY)
+        return -EBUSY;
+
+    kbuf = memdup_user(ubuf, len);
+    if (IS_ERR(kbuf))
+        return PTR_ERR(kbuf);
+
+    ret = myi2c_submit(data, true, *ppos, kbuf, len);
+    kfree(kbuf);
+    if (ret)
+        return ret;
+
+    *ppos += len;
+    return len;
+}
+
+static const struct file_operations myi2cdev_fops = {
+    .owner = THIS_MODULE,
+    .open = myi2cdev_open,
+    .release = myi2cdev_release,
+    .llseek = myi2cdev_llseek,
+    .read = myi2cdev_read,
+    .write = myi2cdev_write,
+};
+
+/*
+ * SAMPLER
+ *
+ * One hrtimer per adapter is armed for the earliest sample due among its
+ * clients, each of which keeps its own sample_period_us on an absolute
+ * schedule. The timer queues a high-priority sampling pass, which queues
+ * one read per due client on the bus request queue, kicks the worker once
+ * (so all of them go out as one batch) and appends {timestamp, bytes} to
+ * each client's ring. The pass is the only writer of the rings; readers
+ * (read() or mmap) never take a lock and detect overwritten records from
+ * 'head'.
+ */
+
+/* Queue the sample read of @data if it is due; called with bus->sample_lock held */
+static bool myi2c_sample_begin(struct myi2cdev_data *data, ktime_t now)
+{
+    struct myi2c_sample *rec;
+    u64 head = data->ring->head;
+
+    if (!data->sample_period_us || ktime_after(data->sample_due, now))
+        return false;
+    if (READ_ONCE(data->cache_mode) == MYI2C_CACHE_ONLY)
+        return false;   /* device asleep: no bus traffic, the schedule still moves */
+
+    /*
+     * This slot still holds record head - nr until it is overwritten now,
+     * so readers treat it as gone from the moment head reaches it. The
+     * barrier makes that head visible before any of the stores below;
+     * pairs with smp_rmb() in the readers.
+     */
+    smp_wmb();
+    rec = &data->records[head & data->ring_mask];
+    rec->timestamp_ns = ktime_to_ns(now);
+    rec->seq = head;
+    rec->reg = data->sample_reg;
+    rec->len = data->sample_len;
+
+    data->sample_req = (struct myi2c_req) {
+        .data = data,
+        .reg = rec->reg,
+        .len = rec->len,
+        .buf = rec->data,
+    };
+    myi2c_req_queue(data->bus, &data->sample_req);
+    return true;
+}
+
+/* Wait for the queued read and publish it; called with bus->sample_lock held */
+static void myi2c_sample_end(struct myi2cdev_data *data, ktime_t start)
+{
+    u64 head = data->ring->head;
+    s64 late;
+    int ret;
+
+    wait_for_completion(&data->sample_req.done);
+    ret = data->sample_req.status;
+
+    if (!ret) {
+        /* record complete before head moves past it */
+        smp_store_release(&data->ring->head, head + 1);
+        wake_up_interruptible(&data->sample_wq);
+    }
+
+    late = ktime_to_ns(ktime_sub(start, data->sample_due));
+    spin_lock(&data->stats_lock);
+    if (ret)
+        data->stats.errors++;
+    else
+        data->stats.samples++;
+    if (late > data->stats.late_max_ns)
+        data->stats.late_max_ns = late;
+    data->stats.read_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+    spin_unlock(&data->stats_lock);
+}
+
+/* Move sample_due past @now, counting the periods that went by unsampled */
+static void myi2c_sample_advance(struct myi2cdev_data *data, ktime_t now)
+{
+    s64 period = (s64)data->sample_period_us * NSEC_PER_USEC;
+    s64 behind;
+    u64 skipped;
+
+    data->sample_due = ktime_add_ns(data->sample_due, period);
+    behind = ktime_to_ns(ktime_sub(now, data->sample_due));
+    if (behind <= 0)
+        return;
+
+    skipped = div64_u64(behind, period) + 1;
+    data->sample_due = ktime_add_ns(data->sample_due, skipped * period);
+    spin_lock(&data->stats_lock);
+    data->stats.missed += skipped;
+    spin_unlock(&data->stats_lock);
+}
+
+static void myi2c_sample_work(struct work_struct *work)
+{
+    struct myi2c_bus *bus = container_of(work, struct myi2c_bus, sample_work);
+    struct myi2cdev_data *data;
+    ktime_t next = KTIME_MAX;
+    bool queued = false;
+    ktime_t now;
+
+    mutex_lock(&bus->sample_lock);
+    now = ktime_get();
+
+    list_for_each_entry(data, &bus->clients, bus_node) {
+        data->sampling = myi2c_sample_begin(data, now);
+        queued |= data->sampling;
+    }
+    if (queued)
+        queue_work(system_highpri_wq, &bus->req_work);
+
+    list_for_each_entry(data, &bus->clients, bus_node) {
+        if (data->sampling)
+            myi2c_sample_end(data, now);
+        if (!data->sample_period_us)
+            continue;
+        if (!ktime_after(data->sample_due, now))
+            myi2c_sample_advance(data, ktime_get());
+        if (ktime_before(data->sample_due, next))
+            next = data->sample_due;
+    }
+
+    if (next != KTIME_MAX)
+        hrtimer_start(&bus->sample_timer, next, HRTIMER_MODE_ABS);
+    mutex_unlock(&bus->sample_lock);
+}
+
+static enum hrtimer_restart myi2c_sample_timer(struct hrtimer *timer)
+{
+    struct myi2c_bus *bus = container_of(timer, struct myi2c_bus, sample_timer);
+
+    /* the pass re-arms the timer for the next client due */
+    queue_work(system_highpri_wq, &bus->sample_work);
+    return HRTIMER_NORESTART;
+}
+
+/* (Re)start or stop sampling @data; called with bus->sample_lock held */
+static void myi2c_sampler_set(struct myi2cdev_data *data, u32 period_us)
+{
+    data->sample_period_us = period_us;
+    data->ring->period_us = period_us;
+    if (!period_us)
+        return;     /* the next pass just skips this client */
+
+    spin_lock(&data->stats_lock);
+    memset(&data->stats, 0, sizeof(data->stats));
+    spin_unlock(&data->stats_lock);
+
+    data->sample_due = ktime_add_us(ktime_get(), period_us);
+    /* an empty pass re-arms the bus timer, now including this client */
+    queue_work(system_highpri_wq, &data->bus->sample_work);
+}
+
+static ssize_t sample_period_us_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%u\n", READ_ONCE(data->sample_period_us));
+}
+
+static ssize_t sample_period_us_store(struct device *dev,
+                                      struct device_attribute *attr,
+                                      const char *buf, size_t count)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    u32 period;
+    int ret;
+
+    ret = kstrtou32(buf, 0, &period);
+    if (ret)
+        return ret;
+    if (period && period < 100)     /* 10 kHz is already more than a 400 kHz bus can do */
+        return -EINVAL;
+
+    mutex_lock(&data->bus->sample_lock);
+    myi2c_sampler_set(data, period);
+    mutex_unlock(&data->bus->sample_lock);
+
+    return count;
+}
+
+static DEVICE_ATTR_RW(sample_period_us);
+
+/* "sample_regs": "<first register> <count>", e.g. "0x20 16" */
+static ssize_t sample_regs_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+
+    return sprintf(buf, "0x%02x %u\n", data->sample_reg, data->sample_len);
+}
+
+static ssize_t sample_regs_store(struct device *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    unsigned int reg, len;
+
+    if (sscanf(buf, "%i %u", &reg, &len) != 2)
+        return -EINVAL;
+    if (reg > MYI2C_REG_MAX || !len || len > MYI2C_SAMPLE_MAX_BYTES ||
+        reg + len > MYI2C_NR_REGS)
+        return -EINVAL;
+
+    /* no pass is running while we hold the lock: the next one uses the new window */
+    mutex_lock(&data->bus->sample_lock);
+    data->sample_reg = reg;
+    data->sample_len = len;
+    myi2c_sampler_set(data, data->sample_period_us);
+    mutex_unlock(&data->bus->sample_lock);
+
+    return count;
+}
+
+static DEVICE_ATTR_RW(sample_regs);
+
+static ssize_t sample_stats_show(struct device *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+    struct myi2cdev_data *data = dev_get_drvdata(dev);
+    struct myi2c_sampler_stats st;
+
+    spin_lock(&data->stats_lock);
+    st = data->stats;
+    spin_unlock(&data->stats_lock);
+
+    return sprintf(buf, "samples=%llu errors=%llu missed=%llu late_max_ns=%llu read_ns=%llu\n",
+                   st.samples, st.errors, st.missed, st.late_max_ns, st.read_ns);
+}
+
+static DEVICE_ATTR_RO(sample_stats);
+
+/* Stream reader: each open() has its own position, starting at "now" */
+struct myi2c_sample_reader {
+    struct myi2cdev_data *data;
+    u64 pos;
+};
+
+static int myi2c_samples_open(struct inode *inode, struct file *file)
+{
+    struct myi2cdev_data *data = container_of(inode->i_cdev, struct myi2cdev_data,
+                                              samples_cdev);
+    struct myi2c_sample_reader *rd;
+
+    rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+    if (!rd)
+        return -ENOMEM;
+
+    kref_get(&data->kref);
+    rd->data = data;
+    rd->pos = smp_load_acquire(&data->ring->head);
+    file->private_data = rd;
+    return 0;
+}
+
+static int myi2c_samples_release(struct inode *inode, struct file *file)
+{
+    struct myi2c_sample_reader *rd = file->private_data;
+
+    myi2c_data_put(rd->data);
+    kfree(rd);
+    return 0;
+}
+
+/* read(): whole struct myi2c_sample records; blocks unless O_NONBLOCK */
+static ssize_t myi2c_samples_read(struct file *file, char __user *ubuf,
+                                  size_t len, loff_t *ppos)
+{
+    struct myi2c_sample_reader *rd = file->private_data;
+    struct myi2cdev_data *data = rd->data;
+    u32 nr = data->ring_mask + 1;
+    struct myi2c_sample rec;
+    size_t copied = 0;
+    u64 head;
+    int ret;
+
+    if (len < sizeof(rec))
+        return -EINVAL;
+
+    for (;;) {
+        /* unbound: nothing will be sampled any more */
+        if (READ_ONCE(data->removed))
+            return -ENODEV;
+        head = smp_load_acquire(&data->ring->head);
+        if (head != rd->pos)
+            break;
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(data->sample_wq,
+                                       smp_load_acquire(&data->ring->head) != rd->pos ||
+                                       READ_ONCE(data->removed));
+        if (ret)
+            return ret;
+    }
+
+    while (copied + sizeof(rec) <= len && rd->pos != head) {
+        /*
+         * Slot head & mask is the one the sampler fills next, so only the
+         * last nr - 1 records are stable: skip to the oldest of them.
+         */
+        if (head - rd->pos >= nr)
+            rd->pos = head - nr + 1;
+
+        rec = data->records[rd->pos & data->ring_mask];
+
+        /* the writer may have lapped us while we copied */
+        smp_rmb();
+        head = READ_ONCE(data->ring->head);
+        if (head - rd->pos >= nr)
+            continue;
+
+        if (copy_to_user(ubuf + copied, &rec, sizeof(rec)))
+            return copied ? copied : -EFAULT;
+        copied += sizeof(rec);
+        rd->pos++;
+    }
+
+    return copied;
+}
+
+static __poll_t myi2c_samples_poll(struct file *file, poll_table *wait)
+{
+    struct myi2c_sample_reader *rd = file->private_data;
+    struct myi2cdev_data *data = rd->data;
+
+    poll_wait(file, &data->sample_wq, wait);
+
+    if (READ_ONCE(data->removed))
+        return EPOLLHUP | EPOLLERR;
+    return smp_load_acquire(&data->ring->head) != rd->pos ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+static int myi2c_samples_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct myi2c_sample_reader *rd = file->private_data;
+
+    if (READ_ONCE(rd->data->removed))
+        return -ENODEV;
+
+    /* the ring belongs to the sampler: readers map it read-only, for good */
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    vma->vm_flags &= ~VM_MAYWRITE;     /* no mprotect(PROT_WRITE) later */
+
+    return remap_vmalloc_range(vma, rd->data->ring, vma->vm_pgoff);
+}
+
+static const struct file_operations myi2c_samples_fops = {
+    .owner = THIS_MODULE,
+    .open = myi2c_samples_open,
+    .release = myi2c_samples_release,
+    .read = myi2c_samples_read,
+    .poll = myi2c_samples_poll,
+    .mmap = myi2c_samples_mmap,
+    .llseek = no_llseek,
+};
+
+static int myi2c_sampler_init(struct myi2cdev_data *data)
+{
+    /* past 2^31 the rounding would overflow nr to 0 */
+    u32 nr = roundup_pow_of_two(clamp(ring_records, 2U, MYI2C_MAX_RING_RECORDS));
+
+    data->ring = vmalloc_user(PAGE_SIZE + (size_t)nr * sizeof(struct myi2c_sample));
+    if (!data->ring)
+        return -ENOMEM;
+
+    data->records = (void *)data->ring + PAGE_SIZE;
+    data->ring_mask = nr - 1;
+    data->ring->nr_records = nr;
+    data->ring->record_size = sizeof(struct myi2c_sample);
+    data->ring->data_offset = PAGE_SIZE;
+
+    spin_lock_init(&data->stats_lock);
+    init_waitqueue_head(&data->sample_wq);
+    data->sample_reg = MYI2C_REG_DATA;
+    data->sample_len = MYI2C_REG_DATA_END - MYI2C_REG_DATA + 1;
+    return 0;
+}
+
+/* Find or create the shared state of @adap and take a reference on it */
+static struct myi2c_bus *myi2c_bus_get(struct i2c_adapter *adap)
+{
+    struct myi2c_bus *bus;
+
+    mutex_lock(&myi2c_buses_lock);
+    list_for_each_entry(bus, &myi2c_buses, node) {
+        if (bus->adap == adap)
+            goto found;
+    }
+
+    bus = kzalloc(sizeof(*bus), GFP_KERNEL);
+    if (!bus)
+        goto out;
+
+    bus->adap = adap;
+    spin_lock_init(&bus->req_lock);
+    INIT_LIST_HEAD(&bus->req_list);
+    INIT_WORK(&bus->req_work, myi2c_req_work);
+    bus->merge = true;
+    mutex_init(&bus->sample_lock);
+    INIT_LIST_HEAD(&bus->clients);
+    hrtimer_init(&bus->sample_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+    bus->sample_timer.function = myi2c_sample_timer;
+    INIT_WORK(&bus->sample_work, myi2c_sample_work);
+    list_add(&bus->node, &myi2c_buses);
+found:
+    bus->users++;
+out:
+    mutex_unlock(&myi2c_buses_lock);
+    return bus;
+}
+
+/* Drop a reference; the last client on the adapter frees it */
+static void myi2c_bus_put(struct myi2c_bus *bus)
+{
+    mutex_lock(&myi2c_buses_lock);
+    if (--bus->users) {
+        mutex_unlock(&myi2c_buses_lock);
+        return;
+    }
+    list_del(&bus->node);
+    mutex_unlock(&myi2c_buses_lock);
+
+    /* no clients left, so a pass that still runs won't re-arm the timer */
+    hrtimer_cancel(&bus->sample_timer);
+    cancel_work_sync(&bus->sample_work);
+    flush_work(&bus->req_work);
+    kfree(bus);
+}
+
+static void myi2c_bus_add_client(struct myi2cdev_data *data)
+{
+    mutex_lock(&data->bus->sample_lock);
+    list_add_tail(&data->bus_node, &data->bus->clients);
+    mutex_unlock(&data->bus->sample_lock);
+}
+
+/* After this no sampling pass touches @data any more */
+static void myi2c_bus_del_client(struct myi2cdev_data *data)
+{
+    mutex_lock(&data->bus->sample_lock);
+    data->sample_period_us = 0;
+    list_del(&data->bus_node);
+    mutex_unlock(&data->bus->sample_lock);
+}
+
 static struct attribute *myi2cdev_attrs[] = {
     &dev_attr_value.attr,
     &dev_attr_info.attr,
+    &dev_attr_data.attr,
+    &dev_attr_status.attr,
+    &dev_attr_cache_mode.attr,
+    &dev_attr_reg_addr.attr,
+    &dev_attr_reg_data.attr,
+    &dev_attr_sample_period_us.attr,
+    &dev_attr_sample_regs.attr,
+    &dev_attr_sample_stats.attr,
+    &dev_attr_queue_merge.attr,
+    &dev_attr_queue_stats.attr,
     NULL,
 };
 
-static const struct attribute_group myi2cdev_attr_group = {
-    .attrs = myi2cdev_attrs,
-};
+/* Added by the driver core once probe succeeds, before the bind uevent goes out */
+ATTRIBUTE_GROUPS(myi2cdev);
+
+static void myi2c_chrdev_release(struct device *dev)
+{
+    myi2c_data_put(dev_get_drvdata(dev));
+}
+
+/*
+ * Prepare @dev for cdev_device_add(). It holds a reference on @data, and
+ * the cdev pins @dev while a file is open, so open() always finds @data.
+ * After this, @dev is dropped with put_device(), not freed.
+ */
+static void myi2c_chrdev_init(struct myi2cdev_data *data, struct device *dev,
+                              dev_t devt)
+{
+    device_initialize(dev);
+    dev->class = myi2c_class;
+    dev->parent = &data->client->dev;
+    dev->devt = devt;
+    dev->release = myi2c_chrdev_release;
+    dev_set_drvdata(dev, data);
+    kref_get(&data->kref);
+}
 
 /* Probe/remove */
 static int myi2cdev_probe(struct i2c_client *client,
                           const struct i2c_device_id *id)
 {
     struct myi2cdev_data *data;
+    int minor;
     int ret;
 
     dev_info(&client->dev, "Probing myi2cdev at addr 0x%02x\n", client->addr);
 
-    data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
+    data = kzalloc(sizeof(*data), GFP_KERNEL);
     if (!data)
         return -ENOMEM;
 
+    kref_init(&data->kref);
     data->client = client;
-    data->value = 0;
+    mutex_init(&data->mode_lock);
+    init_rwsem(&data->remove_sem);
+    data->cache_mode = MYI2C_CACHE_NORMAL;
+
+    /* regmap picks i2c_transfer, SMBus block or SMBus byte ops from the adapter */
+    data->regmap = devm_regmap_init_i2c(client, &myi2cdev_regmap_config);
+    if (IS_ERR(data->regmap)) {
+        ret = PTR_ERR(data->regmap);
+        goto err_put;
+    }
 
     i2c_set_clientdata(client, data);
 
-    /* Create sysfs files */
-    ret = sysfs_create_group(&client->dev.kobj, &myi2cdev_attr_group);
+    ret = myi2c_sampler_init(data);
     if (ret)
-        return ret;
+        goto err_put;
+
+    /* Join the queue and sampler shared by all clients on this adapter */
+    data->bus = myi2c_bus_get(client->adapter);
+    if (!data->bus) {
+        ret = -ENOMEM;
+        goto err_put;
+    }
+    myi2c_bus_add_client(data);
+
+    /* Register window /dev/myi2c-<bus>-<addr> */
+    minor = ida_alloc_max(&myi2c_ida, MYI2C_MAX_MINORS - 1, GFP_KERNEL);
+    if (minor < 0) {
+        ret = minor;
+        goto err_bus;
+    }
+    data->devt = MKDEV(MAJOR(myi2c_devt_base), minor);
+
+    cdev_init(&data->cdev, &myi2cdev_fops);
+    data->cdev.owner = THIS_MODULE;
+    myi2c_chrdev_init(data, &data->chrdev, data->devt);
+    ret = dev_set_name(&data->chrdev, "myi2c-%d-%02x",
+                       i2c_adapter_id(client->adapter), client->addr);
+    if (!ret)
+        ret = cdev_device_add(&data->cdev, &data->chrdev);
+    if (ret) {
+        put_device(&data->chrdev);
+        goto err_ida;
+    }
+
+    /* Sample stream /dev/myi2c-<bus>-<addr>-samples */
+    minor = ida_alloc_max(&myi2c_ida, MYI2C_MAX_MINORS - 1, GFP_KERNEL);
+    if (minor < 0) {
+        ret = minor;
+        goto err_chrdev;
+    }
+    data->samples_devt = MKDEV(MAJOR(myi2c_devt_base), minor);
+
+    cdev_init(&data->samples_cdev, &myi2c_samples_fops);
+    data->samples_cdev.owner = THIS_MODULE;
+    myi2c_chrdev_init(data, &data->samples_dev, data->samples_devt);
+    ret = dev_set_name(&data->samples_dev, "myi2c-%d-%02x-samples",
+                       i2c_adapter_id(client->adapter), client->addr);
+    if (!ret)
+        ret = cdev_device_add(&data->samples_cdev, &data->samples_dev);
+    if (ret) {
+        put_device(&data->samples_dev);
+        goto err_samples_ida;
+    }
 
     dev_info(&client->dev, "myi2cdev initialized successfully\n");
     return 0;
+
+err_samples_ida:
+    ida_free(&myi2c_ida, MINOR(data->samples_devt));
+err_chrdev:
+    cdev_device_del(&data->cdev, &data->chrdev);
+    put_device(&data->chrdev);
+    minor = MINOR(data->devt);
+err_ida:
+    ida_free(&myi2c_ida, minor);
+err_bus:
+    myi2c_bus_del_client(data);
+    myi2c_bus_put(data->bus);
+err_put:
+    myi2c_data_put(data);
+    return ret;
 }
 
 static int myi2cdev_remove(struct i2c_client *client)
 {
-    sysfs_remove_group(&client->dev.kobj, &myi2cdev_attr_group);
+    struct myi2cdev_data *data = i2c_get_clientdata(client);
+
+    myi2c_bus_del_client(data);
+
+    /* Wait out register accesses in flight; later ones get -ENODEV */
+    down_write(&data->remove_sem);
+    data->removed = true;
+    up_write(&data->remove_sem);
+    /* and so do sample readers, including those asleep in read()/poll() */
+    wake_up_interruptible(&data->sample_wq);
+
+    cdev_device_del(&data->samples_cdev, &data->samples_dev);
+    ida_free(&myi2c_ida, MINOR(data->samples_devt));
+    cdev_device_del(&data->cdev, &data->chrdev);
+    ida_free(&myi2c_ida, MINOR(data->devt));
+    myi2c_bus_put(data->bus);
     dev_info(&client->dev, "myi2cdev removed\n");
+
+    /* files still open keep data (and the ring they may have mapped) */
+    put_device(&data->samples_dev);
+    put_device(&data->chrdev);
+    myi2c_data_put(data);
     return 0;
 }
 
@@ -116,13 +1475,50 @@ static struct i2c_driver myi2cdev_driver = {
     .driver = {
         .name = "myi2cdev",
         .of_match_table = myi2cdev_of_match,
+        .dev_groups = myi2cdev_groups,
+        /* dozens of sensors per bus: don't probe them one after another at boot */
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
     },
     .probe = myi2cdev_probe,
     .remove = myi2cdev_remove,
     .id_table = myi2cdev_id,
 };
 
-module_i2c_driver(myi2cdev_driver);
+static int __init myi2cdev_init(void)
+{
+    int ret;
+
+    myi2c_class = class_create(THIS_MODULE, "myi2c");
+    if (IS_ERR(myi2c_class))
+        return PTR_ERR(myi2c_class);
+
+    ret = alloc_chrdev_region(&myi2c_devt_base, 0, MYI2C_MAX_MINORS, "myi2c");
+    if (ret)
+        goto err_class;
+
+    ret = i2c_add_driver(&myi2cdev_driver);
+    if (ret)
+        goto err_chrdev;
+
+    return 0;
+
+err_chrdev:
+    unregister_chrdev_region(myi2c_devt_base, MYI2C_MAX_MINORS);
+err_class:
+    class_destroy(myi2c_class);
+    return ret;
+}
+
+static void __exit myi2cdev_exit(void)
+{
+    i2c_del_driver(&myi2cdev_driver);
+    unregister_chrdev_region(myi2c_devt_base, MYI2C_MAX_MINORS);
+    class_destroy(myi2c_class);
+    ida_destroy(&myi2c_ida);
+}
+
+module_init(myi2cdev_init);
+module_exit(myi2cdev_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Ragab");
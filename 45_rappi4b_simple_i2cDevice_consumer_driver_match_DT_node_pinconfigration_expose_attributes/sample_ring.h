@@ -0,0 +1,37 @@
+#ifndef __SAMPLE_RING_H
+#define __SAMPLE_RING_H
+
+#include <linux/types.h>
+
+#define MYI2C_SAMPLE_MAX_BYTES  32      /* one SMBus I2C block */
+
+/* One sample: the configured registers, read in one block transfer */
+struct myi2c_sample {
+    __u64 timestamp_ns;     /* CLOCK_MONOTONIC, right before the transfer */
+    __u64 seq;              /* 0, 1, 2, ... - a gap means samples were lost */
+    __u8  reg;              /* first register */
+    __u8  len;              /* valid bytes in data[] */
+    __u8  reserved[6];
+    __u8  data[MYI2C_SAMPLE_MAX_BYTES];
+};
+
+/*
+ * mmap() of /dev/myi2c-<bus>-<addr>-samples (read-only):
+ *   page 0:  struct myi2c_ring_hdr
+ *   page 1+: nr_records struct myi2c_sample, record i at index i % nr_records
+ * 'head' is the number of samples written so far (load it with acquire
+ * semantics); a record is complete once head has moved past it. The slot
+ * of record head is refilled in place, which destroys record
+ * head - nr_records, so only records head - nr_records + 1 .. head - 1 are
+ * stable. To read one: copy it out, issue a read barrier, load head again
+ * and drop the copy if head - pos >= nr_records by then.
+ */
+struct myi2c_ring_hdr {
+    __u64 head;
+    __u32 nr_records;       /* power of 2 */
+    __u32 record_size;      /* sizeof(struct myi2c_sample) */
+    __u32 data_offset;      /* byte offset of record 0 in the mapping */
+    __u32 period_us;
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * sample_test.c - consume the kernel sampler of myi2cdev and report how
+ * regular the samples are and what they cost.
+ *
+ * gcc -O2 -o sample_test sample_test.c -lm
+ * echo 1000 | sudo tee <sysfs_dir>/sample_period_us          # 1 kHz
+ * sudo ./sample_test <sysfs_dir> <samples_dev> [seconds] [read|mmap]
+ *   e.g. ./sample_test /sys/bus/i2c/devices/11-0050 /dev/myi2c-11-50-samples 10
+ *
+ * jitter = deviation of each sample interval from the configured period.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "sample_ring.h"
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static char *read_attr(const char *dir, const char *name)
+{
+	static char buf[256];
+	char path[512];
+	int fd, n;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fd = open(path, O_RDONLY);
+	n = fd < 0 ? -1 : read(fd, buf, sizeof(buf) - 1);
+	buf[n > 0 ? n : 0] = '\0';
+	if (fd >= 0)
+		close(fd);
+	return buf;
+}
+
+static struct myi2c_sample *samples;
+static size_t nsamples, max_samples;
+static uint64_t gaps;
+
+static void keep(const struct myi2c_sample *s)
+{
+	if (nsamples && s->seq != samples[nsamples - 1].seq + 1)
+		gaps += s->seq - samples[nsamples - 1].seq - 1;
+	if (nsamples < max_samples)
+		samples[nsamples++] = *s;
+}
+
+static void run_read(int fd, uint64_t end)
+{
+	struct myi2c_sample buf[64];
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	ssize_t n, i;
+
+	while (now_ns() < end) {
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		n = read(fd, buf, sizeof(buf));
+		for (i = 0; i < n / (ssize_t)sizeof(buf[0]); i++)
+			keep(&buf[i]);
+	}
+}
+
+static void run_mmap(int fd, uint64_t end)
+{
+	struct myi2c_ring_hdr *hdr;
+	struct myi2c_sample *rec, copy;
+	uint64_t pos, head, nr;
+	size_t size;
+
+	hdr = mmap(NULL, 4096, PROT_READ, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		perror("mmap");
+		exit(2);
+	}
+	size = hdr->data_offset + (size_t)hdr->nr_records * hdr->record_size;
+	munmap(hdr, 4096);
+	hdr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		perror("mmap");
+		exit(2);
+	}
+	rec = (void *)((char *)hdr + hdr->data_offset);
+	nr = hdr->nr_records;
+
+	pos = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	while (now_ns() < end) {
+		head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+		if (head == pos) {
+			usleep(1000);	/* a real consumer would batch even more */
+			continue;
+		}
+		/* the slot of record head is being refilled: nr - 1 stable ones */
+		if (head - pos >= nr)
+			pos = head - nr + 1;
+		for (; pos != head; pos++) {
+			copy = rec[pos & (nr - 1)];
+			/* lapped while copying? then the copy may be torn */
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			head = __atomic_load_n(&hdr->head, __ATOMIC_RELAXED);
+			if (head - pos >= nr) {
+				pos = head - nr;        /* ++ below makes it head - nr + 1 */
+				continue;
+			}
+			keep(&copy);
+		}
+	}
+	munmap(hdr, size);
+}
+
+int main(int argc, char *argv[])
+{
+	int seconds = argc > 3 ? atoi(argv[3]) : 10;
+	int use_mmap = argc > 4 && !strcmp(argv[4], "mmap");
+	double period_ns, *dev, sum = 0, sq = 0;
+	struct rusage ru;
+	unsigned long long ksamples;
+	char *stats, *p;
+	uint64_t start;
+	size_t i;
+	int fd;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <sysfs_dir> <samples_dev> [seconds] [read|mmap]\n", argv[0]);
+		return 1;
+	}
+	period_ns = atof(read_attr(argv[1], "sample_period_us")) * 1000;
+	if (period_ns <= 0) {
+		fprintf(stderr, "sampler is off: write %s/sample_period_us first\n", argv[1]);
+		return 1;
+	}
+
+	fd = open(argv[2], O_RDONLY);
+	if (fd < 0) {
+		perror(argv[2]);
+		return 2;
+	}
+	max_samples = (size_t)(seconds * 1e9 / period_ns) * 2 + 1024;
+	samples = calloc(max_samples, sizeof(*samples));
+
+	start = now_ns();
+	if (use_mmap)
+		run_mmap(fd, start + seconds * 1000000000ULL);
+	else
+		run_read(fd, start + seconds * 1000000000ULL);
+	close(fd);
+
+	if (nsamples < 2) {
+		fprintf(stderr, "got %zu samples\n", nsamples);
+		return 2;
+	}
+	dev = calloc(nsamples, sizeof(*dev));
+	for (i = 1; i < nsamples; i++) {
+		dev[i - 1] = (double)(samples[i].timestamp_ns - samples[i - 1].timestamp_ns) /
+			     (samples[i].seq - samples[i - 1].seq) - period_ns;
+		sum += dev[i - 1];
+		sq += dev[i - 1] * dev[i - 1];
+	}
+	for (i = 0; i < nsamples - 1; i++)
+		dev[i] = fabs(dev[i]);
+	qsort(dev, nsamples - 1, sizeof(*dev), cmp_double);
+
+	getrusage(RUSAGE_SELF, &ru);
+	printf("%s: %zu samples in %d s (%.0f Hz), %llu lost\n",
+	       use_mmap ? "mmap" : "read", nsamples, seconds, nsamples / (double)seconds,
+	       (unsigned long long)gaps);
+	printf("jitter: mean %.1f us, stddev %.1f us, p99 |dev| %.1f us, max %.1f us\n",
+	       sum / (nsamples - 1) / 1e3,
+	       sqrt(sq / (nsamples - 1) - pow(sum / (nsamples - 1), 2)) / 1e3,
+	       dev[(nsamples - 1) * 99 / 100] / 1e3, dev[nsamples - 2] / 1e3);
+	printf("reader CPU: %.2f%%\n",
+	       100.0 * (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+			(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6) / seconds);
+	stats = read_attr(argv[1], "sample_stats");
+	printf("kernel: %s", stats);
+	p = strstr(stats, "read_ns=");
+	if (p && sscanf(stats, "samples=%llu", &ksamples) == 1 && ksamples)
+		printf("kernel read latency: %.1f us/sample (queue wait + transfer)\n",
+		       strtoull(p + 8, NULL, 10) / (double)ksamples / 1e3);
+	return 0;
+}
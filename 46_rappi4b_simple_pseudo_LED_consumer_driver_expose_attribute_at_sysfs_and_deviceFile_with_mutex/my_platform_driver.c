@@ -6,19 +6,24 @@
 #include <linux/mutex.h>
 #include <linux/device.h>
 #include <linux/cdev.h>
+#include <linux/idr.h>
 
 #define DRIVER_NAME "mydevice"
+#define MYDEVICE_MAX_MINORS 1024 // instances (DT nodes) this driver can serve
 
 struct mydevice_data {
-    struct device *dev;        // pointer to device
-    struct class *class;       // sysfs class
+    struct device *dev;        // the mydeviceN class device
     struct cdev cdev;          // char device structure
-    dev_t devt;                // device number
-    struct mutex lock;         // protects concurrent access
-    int value;                 // simulated data
+    dev_t devt;                // shared major, minor = N from mydevice_ida
+    struct mutex lock;         // serializes writers (update + notify)
+    int value;                 // simulated data; readers use READ_ONCE, no lock
+    struct kernfs_node *value_kn; // "value" sysfs node, for poll() change notification
 };
 
-static struct mydevice_data *g_data;
+// Shared by every instance: one class, one chrdev region, minors from an IDA
+static struct class *mydevice_class;
+static dev_t mydevice_devt_base;
+static DEFINE_IDA(mydevice_ida);
 
 //
 // ───────────────────────────── SYSFS ATTRIBUTE HANDLERS ─────────────────────────────
@@ -28,13 +33,9 @@ static ssize_t value_show(struct device *dev,
                           struct device_attribute *attr, char *buf)
 {
     struct mydevice_data *data = dev_get_drvdata(dev);
-    int val;
 
-    mutex_lock(&data->lock);
-    val = data->value;
-    mutex_unlock(&data->lock);
-
-    return sprintf(buf, "%d\n", val);
+    // lockless: a reader never waits for (or slows down) the writer path
+    return sprintf(buf, "%d\n", READ_ONCE(data->value));
 }
 
 static ssize_t value_store(struct device *dev,
@@ -43,15 +44,21 @@ static ssize_t value_store(struct device *dev,
 {
     struct mydevice_data *data = dev_get_drvdata(dev);
     int new_value;
+    bool changed;
 
     if (kstrtoint(buf, 10, &new_value))
         return -EINVAL;
 
     mutex_lock(&data->lock);
-    data->value = new_value;
+    changed = data->value != new_value;
+    WRITE_ONCE(data->value, new_value);
     mutex_unlock(&data->lock);
 
-    dev_info(dev, "value updated to %d\n", new_value);
+    // wake userspace poll(POLLPRI) waiters on the value attribute
+    if (changed && data->value_kn)
+        sysfs_notify_dirent(data->value_kn);
+
+    dev_dbg(dev, "value updated to %d\n", new_value);
 
     return count;
 }
@@ -72,9 +79,7 @@ static struct attribute *mydevice_attrs[] = {
     NULL,
 };
 
-static const struct attribute_group mydevice_attr_group = {
-    .attrs = mydevice_attrs,
-};
+ATTRIBUTE_GROUPS(mydevice);
 
 //
 // ───────────────────────────── CHAR DEVICE FILE OPS ─────────────────────────────
@@ -93,14 +98,9 @@ static ssize_t mydevice_read(struct file *file, char __user *buf,
 {
     struct mydevice_data *data = file->private_data;
     char tmp[32];
-    int val;
     int n;
 
-    mutex_lock(&data->lock);
-    val = data->value;
-    mutex_unlock(&data->lock);
-
-    n = snprintf(tmp, sizeof(tmp), "%d\n", val);
+    n = snprintf(tmp, sizeof(tmp), "%d\n", READ_ONCE(data->value));
 
     if (*offset >= n)
         return 0;
@@ -121,6 +121,7 @@ static ssize_t mydevice_write(struct file *file, const char __user *buf,
     struct mydevice_data *data = file->private_data;
     char tmp[32];
     int val;
+    bool changed;
 
     if (len >= sizeof(tmp))
         return -EINVAL;
@@ -134,10 +135,14 @@ static ssize_t mydevice_write(struct file *file, const char __user *buf,
         return -EINVAL;
 
     mutex_lock(&data->lock);
-    data->value = val;
+    changed = data->value != val;
+    WRITE_ONCE(data->value, val);
     mutex_unlock(&data->lock);
 
-    dev_info(data->dev, "value written from /dev: %d\n", val);
+    if (changed && data->value_kn)
+        sysfs_notify_dirent(data->value_kn);
+
+    dev_dbg(data->dev, "value written from /dev: %d\n", val);
     return len;
 }
 
@@ -155,74 +160,61 @@ static const struct file_operations mydevice_fops = {
 static int mydevice_probe(struct platform_device *pdev)
 {
     int ret;
+    int minor;
     struct mydevice_data *data;
 
-    dev_info(&pdev->dev, "Probing mydevice platform driver...\n");
+    dev_dbg(&pdev->dev, "Probing mydevice platform driver...\n");
 
     data = devm_kzalloc(&pdev->dev, sizeof(*data), GFP_KERNEL);
     if (!data)
         return -ENOMEM;
 
-    g_data = data;
-    data->dev = &pdev->dev;
+    platform_set_drvdata(pdev, data);
     mutex_init(&data->lock);
     data->value = 0;
 
-    // 1. Create a device class for sysfs visibility
-    data->class = class_create(THIS_MODULE, DRIVER_NAME);
-    if (IS_ERR(data->class))
-        return PTR_ERR(data->class);
+    // 1. Take a free minor in the shared region (the IDA has its own lock)
+    minor = ida_alloc_max(&mydevice_ida, MYDEVICE_MAX_MINORS - 1, GFP_KERNEL);
+    if (minor < 0)
+        return minor;
+    data->devt = MKDEV(MAJOR(mydevice_devt_base), minor);
 
-    // 2. Allocate major/minor numbers
-    ret = alloc_chrdev_region(&data->devt, 0, 1, DRIVER_NAME);
-    if (ret)
-        goto err_class;
-
-    // 3. Initialize char device
+    // 2. Initialize char device
     cdev_init(&data->cdev, &mydevice_fops);
     data->cdev.owner = THIS_MODULE;
     ret = cdev_add(&data->cdev, data->devt, 1);
     if (ret)
-        goto err_chrdev;
+        goto err_ida;
 
-    // 4. Create device under /dev
-    data->dev = device_create(data->class, NULL, data->devt,
-                              NULL, DRIVER_NAME);
+    // 3. Create /dev/mydeviceN; attributes exist before the uevent goes out
+    data->dev = device_create_with_groups(mydevice_class, &pdev->dev, data->devt,
+                                          data, mydevice_groups,
+                                          DRIVER_NAME "%d", minor);
     if (IS_ERR(data->dev)) {
         ret = PTR_ERR(data->dev);
         goto err_cdev;
     }
+    data->value_kn = sysfs_get_dirent(data->dev->kobj.sd, "value");
 
-    dev_set_drvdata(data->dev, data);
-
-    // 5. Add sysfs attributes
-    ret = sysfs_create_group(&data->dev->kobj, &mydevice_attr_group);
-    if (ret)
-        goto err_device;
-
-    dev_info(&pdev->dev, "mydevice successfully registered!\n");
+    dev_info(&pdev->dev, "%s successfully registered!\n", dev_name(data->dev));
     return 0;
 
-err_device:
-    device_destroy(data->class, data->devt);
 err_cdev:
     cdev_del(&data->cdev);
-err_chrdev:
-    unregister_chrdev_region(data->devt, 1);
-err_class:
-    class_destroy(data->class);
+err_ida:
+    ida_free(&mydevice_ida, minor);
     return ret;
 }
 
 static int mydevice_remove(struct platform_device *pdev)
 {
-    struct mydevice_data *data = g_data;
+    struct mydevice_data *data = platform_get_drvdata(pdev);
 
-    sysfs_remove_group(&data->dev->kobj, &mydevice_attr_group);
-    device_destroy(data->class, data->devt);
+    device_destroy(mydevice_class, data->devt);
     cdev_del(&data->cdev);
-    unregister_chrdev_region(data->devt, 1);
-    class_destroy(data->class);
+    // the attribute went with the device, drop the cached node last
+    sysfs_put(data->value_kn);
+    ida_free(&mydevice_ida, MINOR(data->devt));
 
     dev_info(&pdev->dev, "mydevice removed\n");
     return 0;
@@ -240,10 +232,46 @@ static struct platform_driver mydevice_driver = {
     .driver = {
         .name = DRIVER_NAME,
         .of_match_table = mydevice_of_match,
+        // instances are independent: let many DT nodes bind in parallel
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
     },
 };
 
-module_platform_driver(mydevice_driver);
+static int __init mydevice_init(void)
+{
+    int ret;
+
+    mydevice_class = class_create(THIS_MODULE, DRIVER_NAME);
+    if (IS_ERR(mydevice_class))
+        return PTR_ERR(mydevice_class);
+
+    ret = alloc_chrdev_region(&mydevice_devt_base, 0, MYDEVICE_MAX_MINORS, DRIVER_NAME);
+    if (ret)
+        goto err_class;
+
+    ret = platform_driver_register(&mydevice_driver);
+    if (ret)
+        goto err_chrdev;
+
+    return 0;
+
+err_chrdev:
+    unregister_chrdev_region(mydevice_devt_base, MYDEVICE_MAX_MINORS);
+err_class:
+    class_destroy(mydevice_class);
+    return ret;
+}
+
+static void __exit mydevice_exit(void)
+{
+    platform_driver_unregister(&mydevice_driver);
+    unregister_chrdev_region(mydevice_devt_base, MYDEVICE_MAX_MINORS);
+    class_destroy(mydevice_class);
+    ida_destroy(&mydevice_ida);
+}
+
+module_init(mydevice_init);
+module_exit(mydevice_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Ragab Elsayed");
@@ -0,0 +1,127 @@
+/*
+ * stress_rw.c - many lockless readers vs one writer on the "value".
+ *
+ * N reader threads pread() the value in a loop; one writer thread
+ * writes alternating values and records how long each write() takes.
+ *
+ * gcc -O2 -pthread -o stress_rw stress_rw.c
+ * sudo ./stress_rw [readers] [seconds] [read_path] [write_path]
+ *   default: 64 readers, 5 s, /sys/class/mydevice/mydevice0/value, /dev/mydevice0
+ * (for example 47 use /sys/class/myled/myled0/value and /dev/myled0)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define MAX_WRITES 10000000
+
+static const char *read_path = "/sys/class/mydevice/mydevice0/value";
+static const char *write_path = "/dev/mydevice0";
+static volatile int stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *reader(void *arg)
+{
+	uint64_t *ops = arg;
+	char buf[32];
+	int fd = open(read_path, O_RDONLY);
+
+	if (fd < 0) {
+		perror(read_path);
+		exit(2);
+	}
+	while (!stop) {
+		if (pread(fd, buf, sizeof(buf), 0) <= 0) {
+			perror("read");
+			exit(2);
+		}
+		(*ops)++;
+	}
+	close(fd);
+	return NULL;
+}
+
+static uint64_t *lat;
+static size_t nlat;
+
+static void *writer(void *arg)
+{
+	int fd = open(write_path, O_WRONLY);
+	int v = 0;
+
+	if (fd < 0) {
+		perror(write_path);
+		exit(2);
+	}
+	while (!stop && nlat < MAX_WRITES) {
+		uint64_t t0 = now_ns();
+
+		if (write(fd, v ? "1" : "0", 1) != 1) {
+			perror("write");
+			exit(2);
+		}
+		lat[nlat++] = now_ns() - t0;
+		v = !v;
+	}
+	close(fd);
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[])
+{
+	int nreaders = argc > 1 ? atoi(argv[1]) : 64;
+	int seconds = argc > 2 ? atoi(argv[2]) : 5;
+	pthread_t *th, wth;
+	uint64_t *ops, total = 0;
+	int i;
+
+	if (argc > 3)
+		read_path = argv[3];
+	if (argc > 4)
+		write_path = argv[4];
+
+	th = calloc(nreaders, sizeof(*th));
+	ops = calloc(nreaders * 8, sizeof(*ops));	/* 64 B apart: no false sharing */
+	lat = malloc(MAX_WRITES * sizeof(*lat));
+
+	for (i = 0; i < nreaders; i++)
+		pthread_create(&th[i], NULL, reader, &ops[i * 8]);
+	pthread_create(&wth, NULL, writer, NULL);
+
+	sleep(seconds);
+	stop = 1;
+
+	for (i = 0; i < nreaders; i++) {
+		pthread_join(th[i], NULL);
+		total += ops[i * 8];
+	}
+	pthread_join(wth, NULL);
+
+	qsort(lat, nlat, sizeof(*lat), cmp_u64);
+	printf("%d readers: %.0f reads/s total, %.0f reads/s per thread\n",
+	       nreaders, (double)total / seconds, (double)total / seconds / nreaders);
+	if (nlat)
+		printf("writer: %zu writes, latency p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		       nlat, lat[nlat / 2] / 1e3, lat[nlat * 99 / 100] / 1e3,
+		       lat[nlat - 1] / 1e3);
+	return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * bench_frames.c - push LED panel frames to /dev/myled0 as fast as possible.
+ * Each write() is one full frame (bitmask of all lines).
+ *
+ * gcc -O2 -o bench_frames bench_frames.c
+ * sudo ./bench_frames <nr_lines> [seconds] [device]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	int lines, seconds = 5, fd, len;
+	const char *dev = "/dev/myled0";
+	uint64_t mask_all, frame = 0, frames = 0;
+	double t0, t;
+	char buf[32];
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <nr_lines> [seconds] [device]\n", argv[0]);
+		return 1;
+	}
+	lines = atoi(argv[1]);
+	if (argc > 2)
+		seconds = atoi(argv[2]);
+	if (argc > 3)
+		dev = argv[3];
+	mask_all = lines >= 64 ? ~0ULL : (1ULL << lines) - 1;
+
+	fd = open(dev, O_WRONLY);
+	if (fd < 0) {
+		perror(dev);
+		return 2;
+	}
+
+	t0 = now_sec();
+	do {
+		/* walking pattern: every frame changes a different subset */
+		frame = (frame * 6364136223846793005ULL + 1442695040888963407ULL);
+		len = snprintf(buf, sizeof(buf), "0x%llx",
+			       (unsigned long long)(frame & mask_all));
+		if (write(fd, buf, len) != len) {
+			perror("write");
+			return 2;
+		}
+		frames++;
+		t = now_sec() - t0;
+	} while (t < seconds);
+
+	printf("%d lines: %llu frames in %.2f s = %.0f frames/s (%.0f line updates/s)\n",
+	       lines, (unsigned long long)frames, t, frames / t, frames * lines / t);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,69 @@
+#!/bin/sh
+# Bind many myled instances at once and report how long until every
+# /dev/myledN node exists.
+#
+#   sudo ./bind_test.sh dt  [overlay.dts]   # DT overlay (default: myled-sim-128-overlay.dts)
+#   sudo ./bind_test.sh sim [ndevs]         # configfs gpio-sim + myled_sim_device.ko
+#
+# dt mode needs cpp, dtc and configfs overlays (CONFIG_OF_OVERLAY +
+# CONFIG_OF_CONFIGFS); sim mode only needs CONFIG_GPIO_SIM.
+# my_gpio_led_driver.ko must be built (make) in this directory.
+
+MODE=${1:-dt}
+KDIR=/lib/modules/$(uname -r)/build
+WORK=$(mktemp -d)
+OVL=/sys/kernel/config/device-tree/overlays/myled_bind
+SIM=/sys/kernel/config/gpio-sim/myled_bind
+
+now_us() { echo $(($(date +%s%N) / 1000)); }
+
+wait_nodes() {
+    while [ "$(ls /dev/myled* 2>/dev/null | wc -l)" -lt "$1" ]; do
+        sleep 0.001
+    done
+}
+
+modprobe gpio-sim
+insmod my_gpio_led_driver.ko || exit 1
+
+case $MODE in
+dt)
+    DTS=${2:-myled-sim-128-overlay.dts}
+    N=$(grep -c '"ragab,myled"' $DTS)
+    cpp -nostdinc -I $KDIR/include -undef -x assembler-with-cpp $DTS > $WORK/bind.dts
+    dtc -@ -I dts -O dtb -o $WORK/bind.dtbo $WORK/bind.dts || exit 1
+    mkdir $OVL
+    T0=$(now_us)
+    cat $WORK/bind.dtbo > $OVL/dtbo
+    wait_nodes $N
+    T1=$(now_us)
+    ;;
+sim)
+    N=${2:-128}
+    mkdir -p $SIM/bank0
+    echo $N > $SIM/bank0/num_lines
+    echo myled-sim > $SIM/bank0/label
+    echo 1 > $SIM/live
+    T0=$(now_us)
+    insmod myled_sim_device.ko nlines=1 ndevs=$N || exit 1
+    wait_nodes $N
+    T1=$(now_us)
+    ;;
+*)
+    echo "usage: $0 dt [overlay.dts] | sim [ndevs]"
+    rmmod my_gpio_led_driver
+    exit 1
+    ;;
+esac
+
+echo "$N instances bound in $((T1 - T0)) us ($(( (T1 - T0) / N )) us/instance)"
+
+# minors must be unique, one per instance
+echo "distinct minors: $(cat /sys/class/myled/myled*/dev | sort -u | wc -l)"
+
+case $MODE in
+dt)  rmdir $OVL ;;
+sim) rmmod myled_sim_device; echo 0 > $SIM/live; rmdir $SIM/bank0 $SIM ;;
+esac
+rmmod my_gpio_led_driver
+rm -rf $WORK
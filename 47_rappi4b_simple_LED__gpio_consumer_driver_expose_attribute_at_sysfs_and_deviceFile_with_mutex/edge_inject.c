@@ -0,0 +1,155 @@
+/*
+ * edge_inject.c - flip a gpio-sim input line at a fixed rate and check
+ * what comes out of /dev/myledN in input mode.
+ *
+ * The line is toggled through gpio-sim's "pull" attribute on an absolute
+ * schedule. A reader thread drains struct myled_event records; at the end
+ * we report lost edges and latency = kernel edge timestamp - time the
+ * injecting write() started (both CLOCK_MONOTONIC).
+ *
+ * gcc -O2 -pthread -o edge_inject edge_inject.c
+ * echo in | sudo tee /sys/class/myled/myled0/direction
+ * sudo ./edge_inject <pull_path> [edges_per_sec] [seconds] [dev]
+ *   pull_path: e.g. /sys/devices/platform/gpio-sim.0/gpiochip0/sim_gpio0/pull
+ *   defaults:  100000 edges/s, 2 s, /dev/myled0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <time.h>
+#include "ioctl_cmd.h"
+
+static const char *dev = "/dev/myled0";
+static volatile int stop;
+
+static struct myled_event *events;
+static size_t nevents, max_events;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void *reader(void *arg)
+{
+	struct pollfd pfd = { .events = POLLIN };
+	ssize_t n;
+
+	pfd.fd = open(dev, O_RDONLY | O_NONBLOCK);
+	if (pfd.fd < 0) {
+		perror(dev);
+		exit(2);
+	}
+	while (!stop || poll(&pfd, 1, 0) > 0) {
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		if (nevents == max_events)
+			break;
+		n = read(pfd.fd, &events[nevents],
+			 (max_events - nevents) * sizeof(*events));
+		if (n < 0)
+			continue;	/* EAGAIN */
+		if (n == 0) {
+			fprintf(stderr, "%s is not in input mode\n", dev);
+			exit(2);
+		}
+		nevents += n / sizeof(*events);
+	}
+	close(pfd.fd);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	long rate = argc > 2 ? atol(argv[2]) : 100000;
+	int seconds = argc > 3 ? atoi(argv[3]) : 2;
+	size_t n = (size_t)rate * seconds, i, j;
+	uint64_t *inject, *lat, period, start;
+	char path[256], tmp[32];
+	pthread_t th;
+	int fd;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <pull_path> [edges_per_sec] [seconds] [dev]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 4)
+		dev = argv[4];
+
+	fd = open(argv[1], O_WRONLY);
+	if (fd < 0) {
+		perror(argv[1]);
+		return 2;
+	}
+	pwrite(fd, "pull-down", 9, 0);
+
+	inject = calloc(n, sizeof(*inject));
+	max_events = n * 2;	/* room for spurious edges */
+	events = calloc(max_events, sizeof(*events));
+	lat = calloc(max_events, sizeof(*lat));
+
+	pthread_create(&th, NULL, reader, NULL);
+	usleep(100000);
+
+	period = 1000000000ULL / rate;
+	start = now_ns();
+	for (i = 0; i < n; i++) {
+		uint64_t t = start + i * period;
+
+		while ((inject[i] = now_ns()) < t)
+			;
+		if (i & 1)
+			pwrite(fd, "pull-down", 9, 0);
+		else
+			pwrite(fd, "pull-up", 7, 0);
+	}
+	printf("injected %zu edges in %.3f s (%.0f edges/s)\n", n,
+	       (now_ns() - start) / 1e9, n / ((now_ns() - start) / 1e9));
+
+	usleep(200000);
+	stop = 1;
+	pthread_join(th, NULL);
+	close(fd);
+
+	/* each event belongs to the last injection that started before it */
+	for (i = 0, j = 0; i < nevents; i++) {
+		while (j + 1 < n && inject[j + 1] <= events[i].timestamp_ns)
+			j++;
+		lat[i] = events[i].timestamp_ns - inject[j];
+	}
+
+	snprintf(path, sizeof(path), "/sys/class/myled/%s/events_dropped",
+		 basename((char *)dev));
+	fd = open(path, O_RDONLY);
+	if (fd >= 0 && read(fd, tmp, sizeof(tmp) - 1) > 0)
+		tmp[strcspn(tmp, "\n")] = '\0';
+	else
+		strcpy(tmp, "?");
+
+	printf("received %zu events, lost %zd (%.3f%%), fifo overflows %s\n",
+	       nevents, (ssize_t)(n - nevents),
+	       nevents < n ? 100.0 * (n - nevents) / n : 0.0, tmp);
+	if (nevents) {
+		qsort(lat, nevents, sizeof(*lat), cmp_u64);
+		printf("inject->irq latency: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		       lat[nevents / 2] / 1e3, lat[nevents * 99 / 100] / 1e3,
+		       lat[nevents - 1] / 1e3);
+	}
+	return 0;
+}
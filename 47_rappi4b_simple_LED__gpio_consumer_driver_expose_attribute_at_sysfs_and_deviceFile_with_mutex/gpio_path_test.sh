@@ -0,0 +1,54 @@
+#!/bin/sh
+# Compare the atomic and the kthread (deferred) GPIO paths of
+# my_gpio_led_driver: frame throughput from /dev and pattern playback at a
+# short step period.
+#
+#   sudo ./gpio_path_test.sh [nr_lines] [period_us] [dt|sim]
+#
+# The atomic path needs lines that never sleep, i.e. SoC GPIOs: use "dt"
+# (the default) on a Pi with the overlay applied, there "auto" picks the
+# atomic path and force_deferred=1 the kthread one.
+#
+# gpio-sim lines always sleep (gpiod_cansleep() is true), so "sim" (the
+# gpio-sim chip from the readme + myled_sim_device.ko) can only run the
+# kthread path; the auto run is skipped when it does not come up atomic.
+
+LINES=${1:-8}
+PERIOD=${2:-50}
+SRC=${3:-dt}
+EDGES=$((2000000 / PERIOD))     # ~2 s of pattern
+
+case $SRC in
+dt|sim) ;;
+*) echo "usage: $0 [nr_lines] [period_us] [dt|sim]"; exit 1 ;;
+esac
+
+gcc -O2 -o bench_frames bench_frames.c || exit 1
+gcc -O2 -o pattern_jitter pattern_jitter.c || exit 1
+
+for MODE in auto deferred; do
+    if [ $MODE = deferred ]; then
+        insmod my_gpio_led_driver.ko force_deferred=1 || exit 1
+    else
+        insmod my_gpio_led_driver.ko || exit 1
+    fi
+    if [ $SRC = sim ]; then
+        insmod myled_sim_device.ko nlines=$LINES || exit 1
+    fi
+    while [ ! -e /dev/myled0 ]; do sleep 0.01; done
+
+    PATH_NOW=$(cat /sys/class/myled/myled0/gpio_path)
+    if [ $MODE = auto ] && [ "${PATH_NOW%% *}" != atomic ]; then
+        echo "== $MODE: $PATH_NOW, the lines sleep so there is no atomic path to compare; skipped"
+    else
+        echo "== $MODE: $PATH_NOW"
+        ./bench_frames $LINES 2
+        ./pattern_jitter kernel $EDGES $PERIOD
+        echo "   after pattern: $(cat /sys/class/myled/myled0/gpio_path)"
+    fi
+
+    if [ $SRC = sim ]; then
+        rmmod myled_sim_device
+    fi
+    rmmod my_gpio_led_driver
+done
@@ -0,0 +1,49 @@
+#ifndef __IOCTL_CMD_H
+#define __IOCTL_CMD_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define MYLED_MAGIC_NUMBER      0x47
+
+/* one step of a blink pattern: drive 'level' (LED bitmask) for 'duration_us' */
+struct myled_step {
+    __u64 level;
+    __u32 duration_us;
+    __u32 reserved;
+};
+
+#define MYLED_PATTERN_LOOP      (1 << 0)    /* restart at step 0 after the last step */
+#define MYLED_PATTERN_MAX_STEPS 4096
+
+struct myled_pattern {
+    __u32 nr_steps;
+    __u32 flags;        /* MYLED_PATTERN_* */
+    __u64 steps;        /* user pointer to nr_steps struct myled_step */
+};
+
+/* edge timing of the in-kernel player, relative to the ideal schedule */
+struct myled_pattern_stats {
+    __u64 edges;        /* steps applied */
+    __u64 late_ns_sum;  /* sum of (applied - scheduled) */
+    __u64 late_ns_max;
+    __u32 running;
+    __u32 reserved;
+};
+
+/* input mode: one record per edge, read() from /dev/myledN returns an array of these */
+struct myled_event {
+    __u64 timestamp_ns; /* CLOCK_MONOTONIC, taken in the hard IRQ handler */
+    __u32 line;         /* LED/GPIO index within the device */
+    __u32 level;        /* line level read after the edge */
+};
+
+#define MYLED_IOCTL_SET_PATTERN _IOW(MYLED_MAGIC_NUMBER, 1, struct myled_pattern)
+
+#define MYLED_IOCTL_STOP_PATTERN _IO(MYLED_MAGIC_NUMBER, 2)
+
+#define MYLED_IOCTL_GET_STATS   _IOR(MYLED_MAGIC_NUMBER, 3, struct myled_pattern_stats)
+
+#define MYLED_IOCTL_MAX_CMDS    3
+
+#endif
@@ -8,109 +8,675 @@
 #include <linux/device.h>
 #include <linux/uaccess.h>
 #include <linux/mutex.h>
+#include <linux/bitops.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/seqlock.h>
+#include <linux/idr.h>
+#include <linux/interrupt.h>
+#include <linux/kfifo.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/atomic.h>
+#include <linux/kthread.h>
+#include <linux/kref.h>
+#include "ioctl_cmd.h"
 
 #define DRIVER_NAME "myled"
+#define MYLED_MAX_LINES 64  // the whole panel is one u64 bitmask
+#define MYLED_MAX_MINORS 1024 // instances (DT nodes) this driver can serve
 
+// Not devm: a file opened before unbind may still be around after remove(),
+// so this is freed on the last myled_data_put() (probe, dev, open files).
 struct myled_data {
-    struct gpio_desc *gpiod;
-    struct class *class;
-    struct device *dev;
+    struct kref kref;
+    struct gpio_descs *gpios;  // all LED lines from the "gpios" property
+    unsigned int nr_leds;
+    struct device dev;         // the myledN class device
     struct cdev cdev;
-    dev_t devt;
-    struct mutex lock;
-    int value;
+    dev_t devt;                // shared major, minor = N from myled_ida
+    struct mutex lock;         // serializes the GPIO write sequence
+    bool removed;              // unbound, under lock: file ops get -ENODEV
+    u64 value;                 // bit N = LED line N, as last driven
+    seqlock_t value_seq;       // lockless readers of value (u64 may tear on 32-bit)
+    struct kernfs_node *value_kn; // "value" sysfs node, for poll() change notification
+
+    // in-kernel pattern player (see PATTERN ENGINE below)
+    bool can_sleep;            // lines sit behind a sleeping controller (or force_deferred)
+    struct hrtimer timer;
+    struct task_struct *gpio_thread; // deferred path, only when can_sleep
+    struct mutex apply_lock;   // held by gpio_thread while it drives a level
+    spinlock_t pattern_lock;   // protects everything below
+    struct myled_step *steps;
+    u32 nr_steps;
+    u32 cur_step;
+    bool loop;
+    bool running;
+    bool pending;              // deferred path: level + deadline for gpio_thread
+    u64 pending_level;
+    ktime_t pending_expires;
+    u64 deferred_batched;      // levels replaced before gpio_thread got to them
+    struct myled_pattern_stats stats;
+
+    // input mode (see INPUT EVENTS below); input is switched under data->lock
+    bool input;
+    struct myled_line *lines;
+    DECLARE_KFIFO_PTR(events, struct myled_event);
+    spinlock_t events_lock;    // producers: one IRQ per line
+    struct mutex read_lock;    // kfifo_to_user() wants a single consumer
+    wait_queue_head_t events_wq;
+    atomic64_t events_dropped; // edges lost because the fifo was full
 };
 
-static struct myled_data *g_data;
+static bool force_deferred;
+module_param(force_deferred, bool, 0444);
+MODULE_PARM_DESC(force_deferred, "Use the kthread GPIO path even for lines that never sleep (testing)");
+
+static unsigned int event_fifo_size = 4096;
+module_param(event_fifo_size, uint, 0444);
+MODULE_PARM_DESC(event_fifo_size, "Input mode: queued edge events per device (rounded up to a power of 2)");
+
+// Per-line IRQ context for input mode
+struct myled_line {
+    struct myled_data *data;
+    unsigned int idx;
+    int irq;
+    u64 ts;                    // edge time from the hard handler, consumed by the thread
+};
+
+// Shared by every instance: one class, one chrdev region, minors from an IDA
+static struct class *myled_class;
+static dev_t myled_devt_base;
+static DEFINE_IDA(myled_ida);
+
+//
+// ───────────────────────────── GPIO ARRAY HELPERS ─────────────────────────────
+//
+
+// Drive every LED line from one bitmask with a single array call. SoC GPIOs
+// take the atomic variant (also fine from the hrtimer); expander lines must
+// use the _cansleep one and are only ever driven from process context.
+static void myled_set_mask(struct myled_data *data, u64 mask)
+{
+    DECLARE_BITMAP(bits, MYLED_MAX_LINES);
+
+    bitmap_from_u64(bits, mask);
+    if (data->can_sleep)
+        gpiod_set_array_value_cansleep(data->gpios->ndescs, data->gpios->desc,
+                                       data->gpios->info, bits);
+    else
+        gpiod_set_array_value(data->gpios->ndescs, data->gpios->desc,
+                              data->gpios->info, bits);
+}
+
+// A mask is valid if it has no bit set above the last LED line
+static bool myled_mask_valid(struct myled_data *data, u64 mask)
+{
+    return data->nr_leds == 64 || !(mask >> data->nr_leds);
+}
+
+// Read the live level of every line (input mode)
+static u64 myled_get_mask(struct myled_data *data)
+{
+    DECLARE_BITMAP(bits, MYLED_MAX_LINES) = { 0 };
+    u64 val;
+
+    gpiod_get_array_value_cansleep(data->gpios->ndescs, data->gpios->desc,
+                                   data->gpios->info, bits);
+    val = bits[0];
+#if BITS_PER_LONG == 32
+    val |= (u64)bits[1] << 32;
+#endif
+    return val;
+}
+
+// Publish the level just driven on the lines. Writers come from process
+// context (data->lock) and from the hrtimer (pattern player), so the write
+// side is a seqlock taken with IRQs off; readers never take a lock.
+static void myled_publish_value(struct myled_data *data, u64 val)
+{
+    unsigned long flags;
+
+    write_seqlock_irqsave(&data->value_seq, flags);
+    data->value = val;
+    write_sequnlock_irqrestore(&data->value_seq, flags);
+}
+
+static u64 myled_cached_value(struct myled_data *data)
+{
+    unsigned int seq;
+    u64 val;
+
+    do {
+        seq = read_seqbegin(&data->value_seq);
+        val = data->value;
+    } while (read_seqretry(&data->value_seq, seq));
+
+    return val;
+}
+
+//
+// ───────────────────────────── PATTERN ENGINE ─────────────────────────────
+//
+// Userspace uploads (level, duration_us) steps with MYLED_IOCTL_SET_PATTERN
+// and an hrtimer plays them back. Each expiry is advanced from the previous
+// *scheduled* expiry (hrtimer_add_expires_ns), so error never accumulates.
+// GPIO lines that can sleep (I2C/SPI expanders) cannot be touched from the
+// hrtimer, so for them the level is handed to a per-device kthread. If the
+// bus is slower than the pattern, the thread only applies the newest level
+// (older ones are counted in deferred_batched) instead of falling behind.
+//
+
+// Apply a pattern level and account how late it hit the line
+static void myled_pattern_apply(struct myled_data *data, u64 level, ktime_t expires)
+{
+    s64 late;
+    unsigned long flags;
+
+    myled_set_mask(data, level);
+    myled_publish_value(data, level);
+    late = ktime_to_ns(ktime_sub(ktime_get(), expires));
+
+    spin_lock_irqsave(&data->pattern_lock, flags);
+    data->stats.edges++;
+    if (late > 0) {
+        data->stats.late_ns_sum += late;
+        if (late > data->stats.late_ns_max)
+            data->stats.late_ns_max = late;
+    }
+    spin_unlock_irqrestore(&data->pattern_lock, flags);
+}
+
+static int myled_gpio_thread(void *arg)
+{
+    struct myled_data *data = arg;
+    ktime_t expires;
+    u64 level;
+
+    for (;;) {
+        // sleeping state first, so a kthread_stop() wakeup after the checks is not lost
+        set_current_state(TASK_INTERRUPTIBLE);
+        spin_lock_irq(&data->pattern_lock);
+        if (kthread_should_stop()) {
+            spin_unlock_irq(&data->pattern_lock);
+            break;
+        }
+        if (!data->pending) {
+            spin_unlock_irq(&data->pattern_lock);
+            schedule();
+            continue;
+        }
+        __set_current_state(TASK_RUNNING);
+        level = data->pending_level;
+        expires = data->pending_expires;
+        data->pending = false;
+        spin_unlock_irq(&data->pattern_lock);
+
+        mutex_lock(&data->apply_lock);
+        myled_pattern_apply(data, level, expires);
+        mutex_unlock(&data->apply_lock);
+    }
+    __set_current_state(TASK_RUNNING);
+    return 0;
+}
+
+static enum hrtimer_restart myled_pattern_timer(struct hrtimer *timer)
+{
+    struct myled_data *data = container_of(timer, struct myled_data, timer);
+    ktime_t expires = hrtimer_get_expires(timer);
+    u64 level;
+
+    spin_lock(&data->pattern_lock);
+    if (++data->cur_step == data->nr_steps) {
+        if (!data->loop) {
+            // one-shot: the last level stays on the lines
+            data->running = false;
+            spin_unlock(&data->pattern_lock);
+            return HRTIMER_NORESTART;
+        }
+        data->cur_step = 0;
+    }
+    level = data->steps[data->cur_step].level;
+    hrtimer_add_expires_ns(timer, (u64)data->steps[data->cur_step].duration_us * NSEC_PER_USEC);
+    if (data->can_sleep) {
+        if (data->pending)
+            data->deferred_batched++;
+        data->pending = true;
+        data->pending_level = level;
+        data->pending_expires = expires;
+    }
+    spin_unlock(&data->pattern_lock);
+
+    if (data->can_sleep)
+        wake_up_process(data->gpio_thread);
+    else
+        myled_pattern_apply(data, level, expires);
+
+    return HRTIMER_RESTART;
+}
+
+// Stop playback. Every caller, remove() included, holds data->lock so no
+// writer can start the player again behind our back.
+static void myled_pattern_stop(struct myled_data *data)
+{
+    lockdep_assert_held(&data->lock);
+
+    hrtimer_cancel(&data->timer);
+
+    spin_lock_irq(&data->pattern_lock);
+    data->running = false;
+    data->pending = false;
+    spin_unlock_irq(&data->pattern_lock);
+
+    // wait for a level gpio_thread may be driving right now
+    if (data->gpio_thread) {
+        mutex_lock(&data->apply_lock);
+        mutex_unlock(&data->apply_lock);
+    }
+}
+
+static long myled_pattern_start(struct myled_data *data,
+                                const struct myled_pattern *pat)
+{
+    struct myled_step *steps, *old;
+    u32 i;
+
+    if (!pat->nr_steps || pat->nr_steps > MYLED_PATTERN_MAX_STEPS)
+        return -EINVAL;
+    if (pat->flags & ~MYLED_PATTERN_LOOP)
+        return -EINVAL;
+
+    steps = memdup_user(u64_to_user_ptr(pat->steps),
+                        array_size(pat->nr_steps, sizeof(*steps)));
+    if (IS_ERR(steps))
+        return PTR_ERR(steps);
+
+    for (i = 0; i < pat->nr_steps; i++) {
+        if (!steps[i].duration_us || !myled_mask_valid(data, steps[i].level)) {
+            kfree(steps);
+            return -EINVAL;
+        }
+    }
+
+    mutex_lock(&data->lock);
+    if (data->removed || data->input) {
+        long ret = data->removed ? -ENODEV : -EBUSY;
+
+        mutex_unlock(&data->lock);
+        kfree(steps);
+        return ret;
+    }
+    myled_pattern_stop(data);
+
+    spin_lock_irq(&data->pattern_lock);
+    old = data->steps;
+    data->steps = steps;
+    data->nr_steps = pat->nr_steps;
+    data->cur_step = 0;
+    data->loop = pat->flags & MYLED_PATTERN_LOOP;
+    data->running = true;
+    memset(&data->stats, 0, sizeof(data->stats));
+    data->deferred_batched = 0;
+    data->stats.edges = 1;
+    spin_unlock_irq(&data->pattern_lock);
+
+    // step 0 goes out now, the timer takes over from its end
+    myled_set_mask(data, steps[0].level);
+    myled_publish_value(data, steps[0].level);
+    hrtimer_start(&data->timer, ns_to_ktime((u64)steps[0].duration_us * NSEC_PER_USEC),
+                  HRTIMER_MODE_REL);
+    mutex_unlock(&data->lock);
+
+    kfree(old);
+    return 0;
+}
+
+//
+// ───────────────────────────── INPUT EVENTS ─────────────────────────────
+//
+// With direction = "in" every line gets an edge IRQ. The hard handler only
+// timestamps the edge; the level is read there too if the controller allows
+// it, otherwise in the IRQ thread (the line stays masked until then, ONESHOT).
+// Behind an I2C/SPI expander the IRQ is nested and only the thread runs, so
+// it takes the timestamp itself then.
+// Events go into a kfifo that readers drain from /dev/myledN as
+// struct myled_event records, blocking or poll()ing for more.
+//
+
+static void myled_event_push(struct myled_line *line, int level)
+{
+    struct myled_data *data = line->data;
+    struct myled_event ev = {
+        .timestamp_ns = line->ts,
+        .line = line->idx,
+        .level = level,
+    };
+
+    if (!kfifo_in_spinlocked(&data->events, &ev, 1, &data->events_lock))
+        atomic64_inc(&data->events_dropped);
+    wake_up_interruptible(&data->events_wq);
+}
+
+static irqreturn_t myled_edge_irq(int irq, void *dev_id)
+{
+    struct myled_line *line = dev_id;
+
+    line->ts = ktime_get_ns();
+    if (line->data->can_sleep)
+        return IRQ_WAKE_THREAD;
+
+    myled_event_push(line, gpiod_get_value(line->data->gpios->desc[line->idx]));
+    return IRQ_HANDLED;
+}
+
+static irqreturn_t myled_edge_thread(int irq, void *dev_id)
+{
+    struct myled_line *line = dev_id;
+
+    // nested threaded IRQs (I2C/SPI expanders) never run the hard handler
+    if (!line->ts)
+        line->ts = ktime_get_ns();
+    myled_event_push(line, gpiod_get_value_cansleep(line->data->gpios->desc[line->idx]));
+    line->ts = 0;
+    return IRQ_HANDLED;
+}
+
+// Release the IRQs of lines [0, n) and drive them again with the cached level
+static void myled_input_release(struct myled_data *data, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        free_irq(data->lines[i].irq, &data->lines[i]);
+        gpiod_direction_output(data->gpios->desc[i], (data->value >> i) & 1);
+    }
+}
+
+// Called with data->lock held
+static int myled_set_input(struct myled_data *data)
+{
+    struct myled_line *line;
+    unsigned int i;
+    int ret;
+
+    if (data->input)
+        return 0;
+
+    myled_pattern_stop(data);
+
+    // no producer yet: start from an empty queue
+    mutex_lock(&data->read_lock);
+    kfifo_reset(&data->events);
+    mutex_unlock(&data->read_lock);
+    atomic64_set(&data->events_dropped, 0);
+
+    for (i = 0; i < data->nr_leds; i++) {
+        line = &data->lines[i];
+
+        ret = gpiod_direction_input(data->gpios->desc[i]);
+        if (ret)
+            goto err_release;
+
+        line->irq = gpiod_to_irq(data->gpios->desc[i]);
+        if (line->irq < 0) {
+            ret = line->irq;
+            goto err_output;
+        }
+
+        ret = request_threaded_irq(line->irq, myled_edge_irq, myled_edge_thread,
+                                   IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING |
+                                   IRQF_ONESHOT, dev_name(&data->dev), line);
+        if (ret)
+            goto err_output;
+    }
+
+    WRITE_ONCE(data->input, true);
+    return 0;
+
+err_output:
+    gpiod_direction_output(data->gpios->desc[i], (data->value >> i) & 1);
+err_release:
+    myled_input_release(data, i);
+    dev_err(&data->dev, "input mode on line %u failed: %d\n", i, ret);
+    return ret;
+}
+
+// Called with data->lock held
+static void myled_set_output(struct myled_data *data)
+{
+    if (!data->input)
+        return;
+
+    myled_input_release(data, data->nr_leds);
+    WRITE_ONCE(data->input, false);
+    wake_up_interruptible(&data->events_wq);   // blocked readers see EOF
+}
+
+static ssize_t myled_read_events(struct myled_data *data, struct file *file,
+                                 char __user *buf, size_t len)
+{
+    unsigned int copied;
+    int ret;
+
+    if (len < sizeof(struct myled_event))
+        return -EINVAL;
+
+    if (mutex_lock_interruptible(&data->read_lock))
+        return -ERESTARTSYS;
+
+    while (kfifo_is_empty(&data->events)) {
+        mutex_unlock(&data->read_lock);
+
+        if (!READ_ONCE(data->input))
+            return 0;
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(data->events_wq,
+                                     !kfifo_is_empty(&data->events) ||
+                                     !READ_ONCE(data->input)))
+            return -ERESTARTSYS;
+
+        if (mutex_lock_interruptible(&data->read_lock))
+            return -ERESTARTSYS;
+    }
+
+    // whole records only: kfifo_to_user() rounds len down to the record size
+    ret = kfifo_to_user(&data->events, buf, len, &copied);
+    mutex_unlock(&data->read_lock);
+
+    return ret ? ret : copied;
+}
 
 //
 // ───────────────────────────── SYSFS ATTRIBUTES ─────────────────────────────
 //
 
-// Read LED value
+// Read LED value (bitmask of all lines, bit N = LED N)
 static ssize_t value_show(struct device *dev,
                           struct device_attribute *attr, char *buf)
 {
     struct myled_data *data = dev_get_drvdata(dev);
-    int val;
 
-    mutex_lock(&data->lock);
-    val = gpiod_get_value(data->gpiod);
-    data->value = val;
-    mutex_unlock(&data->lock);
+    if (READ_ONCE(data->input))
+        return sprintf(buf, "%llu\n", myled_get_mask(data));
 
-    return sprintf(buf, "%d\n", val);
+    // output lines: the cached level is what we drove, no GPIO read or lock needed
+    return sprintf(buf, "%llu\n", myled_cached_value(data));
 }
 
-// Write LED value
+// Write LED value (bitmask, any base accepted by kstrtou64: 5, 0x1f, 0b...)
 static ssize_t value_store(struct device *dev,
                            struct device_attribute *attr,
                            const char *buf, size_t count)
 {
     struct myled_data *data = dev_get_drvdata(dev);
-    int new_value;
+    u64 new_value;
+    bool changed;
 
-    if (kstrtoint(buf, 10, &new_value))
+    if (kstrtou64(buf, 0, &new_value))
         return -EINVAL;
 
-    if (new_value != 0 && new_value != 1)
+    if (!myled_mask_valid(data, new_value))
         return -EINVAL;
 
     mutex_lock(&data->lock);
-    gpiod_set_value(data->gpiod, new_value);
-    data->value = new_value;
+    if (data->input) {
+        mutex_unlock(&data->lock);
+        return -EBUSY;
+    }
+    myled_pattern_stop(data);   // a manual write takes the lines back from the player
+    changed = data->value != new_value;
+    myled_set_mask(data, new_value);
+    myled_publish_value(data, new_value);
     mutex_unlock(&data->lock);
 
-    dev_info(dev, "LED set to %d (via sysfs)\n", new_value);
+    // wake userspace poll(POLLPRI) waiters on the value attribute
+    if (changed && data->value_kn)
+        sysfs_notify_dirent(data->value_kn);
+
+    dev_dbg(dev, "LEDs set to 0x%llx (via sysfs)\n", new_value);
 
     return count;
 }
 
-// Direction attribute (for completeness)
+static DEVICE_ATTR_RW(value);
+
+// Direction of all lines: "out" (LED panel) or "in" (edge event stream)
 static ssize_t direction_show(struct device *dev,
                               struct device_attribute *attr, char *buf)
 {
-    return sprintf(buf, "out\n"); // LED is output only
+    struct myled_data *data = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%s\n", READ_ONCE(data->input) ? "in" : "out");
 }
 
-static DEVICE_ATTR_RW(value);
-static DEVICE_ATTR_RO(direction);
+static ssize_t direction_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+    struct myled_data *data = dev_get_drvdata(dev);
+    int ret = 0;
+
+    mutex_lock(&data->lock);
+    if (sysfs_streq(buf, "in"))
+        ret = myled_set_input(data);
+    else if (sysfs_streq(buf, "out"))
+        myled_set_output(data);
+    else
+        ret = -EINVAL;
+    mutex_unlock(&data->lock);
+
+    return ret ? ret : count;
+}
+
+// Input mode: edges lost because nobody drained /dev/myledN fast enough
+static ssize_t events_dropped_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct myled_data *data = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%lld\n", atomic64_read(&data->events_dropped));
+}
+
+// Number of LED lines driven by this device
+static ssize_t count_show(struct device *dev,
+                          struct device_attribute *attr, char *buf)
+{
+    struct myled_data *data = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%u\n", data->nr_leds);
+}
+
+// Which GPIO path this device uses, and how many deferred levels were merged
+static ssize_t gpio_path_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
+{
+    struct myled_data *data = dev_get_drvdata(dev);
+    u64 batched;
+
+    if (!data->can_sleep)
+        return sprintf(buf, "atomic\n");
+
+    spin_lock_irq(&data->pattern_lock);
+    batched = data->deferred_batched;
+    spin_unlock_irq(&data->pattern_lock);
+
+    return sprintf(buf, "kthread batched=%llu\n", batched);
+}
+
+static DEVICE_ATTR_RW(direction);
+static DEVICE_ATTR_RO(gpio_path);
+static DEVICE_ATTR_RO(count);
+static DEVICE_ATTR_RO(events_dropped);
 
 static struct attribute *myled_attrs[] = {
     &dev_attr_value.attr,
     &dev_attr_direction.attr,
+    &dev_attr_count.attr,
+    &dev_attr_events_dropped.attr,
+    &dev_attr_gpio_path.attr,
     NULL,
 };
 
-static const struct attribute_group myled_attr_group = {
-    .attrs = myled_attrs,
-};
+ATTRIBUTE_GROUPS(myled);
 
 //
 // ───────────────────────────── CHARACTER DEVICE ─────────────────────────────
 //
 
+static void myled_data_release(struct kref *kref)
+{
+    struct myled_data *data = container_of(kref, struct myled_data, kref);
+
+    sysfs_put(data->value_kn);
+    kfree(data->steps);
+    kfifo_free(&data->events);
+    kfree(data);
+}
+
+static void myled_data_put(struct myled_data *data)
+{
+    kref_put(&data->kref, myled_data_release);
+}
+
+static void myled_dev_release(struct device *dev)
+{
+    myled_data_put(dev_get_drvdata(dev));
+}
+
 static int myled_open(struct inode *inode, struct file *file)
 {
     struct myled_data *data = container_of(inode->i_cdev, struct myled_data, cdev);
+
+    // the cdev pins data->dev, which holds a reference, so data is still here
+    kref_get(&data->kref);
     file->private_data = data;
     return 0;
 }
 
+static int myled_release(struct inode *inode, struct file *file)
+{
+    myled_data_put(file->private_data);
+    return 0;
+}
+
 static ssize_t myled_read(struct file *file, char __user *buf,
                           size_t len, loff_t *off)
 {
     struct myled_data *data = file->private_data;
-    char tmp[4];
-    int val;
+    char tmp[24];
     int n;
 
-    mutex_lock(&data->lock);
-    val = gpiod_get_value(data->gpiod);
-    data->value = val;
-    mutex_unlock(&data->lock);
+    if (READ_ONCE(data->removed))
+        return -ENODEV;
+
+    // input mode: binary stream of struct myled_event
+    if (READ_ONCE(data->input))
+        return myled_read_events(data, file, buf, len);
 
-    n = snprintf(tmp, sizeof(tmp), "%d\n", val);
+    n = snprintf(tmp, sizeof(tmp), "%llu\n", myled_cached_value(data));
     if (*off >= n)
         return 0;
     if (len > n - *off)
@@ -122,12 +688,14 @@ static ssize_t myled_read(struct file *file, char __user *buf,
     return len;
 }
 
+// One write = one panel frame: the whole bitmask goes out in one array update
 static ssize_t myled_write(struct file *file, const char __user *buf,
                            size_t len, loff_t *off)
 {
     struct myled_data *data = file->private_data;
-    char tmp[8];
-    int val;
+    char tmp[24];
+    u64 val;
+    bool changed;
 
     if (len >= sizeof(tmp))
         return -EINVAL;
@@ -136,26 +704,93 @@ static ssize_t myled_write(struct file *file, const char __user *buf,
         return -EFAULT;
     tmp[len] = '\0';
 
-    if (kstrtoint(tmp, 10, &val))
+    if (kstrtou64(tmp, 0, &val))
         return -EINVAL;
-    if (val != 0 && val != 1)
+    if (!myled_mask_valid(data, val))
         return -EINVAL;
 
     mutex_lock(&data->lock);
-    gpiod_set_value(data->gpiod, val);
-    data->value = val;
+    if (data->removed || data->input) {
+        int ret = data->removed ? -ENODEV : -EBUSY;
+
+        mutex_unlock(&data->lock);
+        return ret;
+    }
+    myled_pattern_stop(data);
+    changed = data->value != val;
+    myled_set_mask(data, val);
+    myled_publish_value(data, val);
     mutex_unlock(&data->lock);
 
-    dev_info(data->dev, "LED set to %d (via /dev)\n", val);
+    if (changed && data->value_kn)
+        sysfs_notify_dirent(data->value_kn);
+
+    dev_dbg(&data->dev, "LEDs set to 0x%llx (via /dev)\n", val);
 
     return len;
 }
 
+static __poll_t myled_poll(struct file *file, poll_table *wait)
+{
+    struct myled_data *data = file->private_data;
+
+    poll_wait(file, &data->events_wq, wait);
+
+    if (READ_ONCE(data->removed))
+        return EPOLLHUP | EPOLLERR;
+    if (!READ_ONCE(data->input))
+        return EPOLLIN | EPOLLRDNORM | EPOLLOUT | EPOLLWRNORM;
+
+    return kfifo_is_empty(&data->events) ? 0 : EPOLLIN | EPOLLRDNORM;
+}
+
+static long myled_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct myled_data *data = file->private_data;
+    struct myled_pattern pat;
+    struct myled_pattern_stats stats;
+
+    if (_IOC_TYPE(cmd) != MYLED_MAGIC_NUMBER)
+        return -ENOTTY;
+    if (_IOC_NR(cmd) > MYLED_IOCTL_MAX_CMDS)
+        return -ENOTTY;
+
+    switch (cmd) {
+    case MYLED_IOCTL_SET_PATTERN:
+        if (copy_from_user(&pat, (void __user *)arg, sizeof(pat)))
+            return -EFAULT;
+        return myled_pattern_start(data, &pat);
+
+    case MYLED_IOCTL_STOP_PATTERN:
+        mutex_lock(&data->lock);
+        if (data->removed) {
+            mutex_unlock(&data->lock);
+            return -ENODEV;
+        }
+        myled_pattern_stop(data);
+        mutex_unlock(&data->lock);
+        return 0;
+
+    case MYLED_IOCTL_GET_STATS:
+        spin_lock_irq(&data->pattern_lock);
+        stats = data->stats;
+        stats.running = data->running;
+        spin_unlock_irq(&data->pattern_lock);
+        if (copy_to_user((void __user *)arg, &stats, sizeof(stats)))
+            return -EFAULT;
+        return 0;
+    }
+    return -ENOTTY;
+}
+
 static const struct file_operations myled_fops = {
     .owner = THIS_MODULE,
     .open = myled_open,
+    .release = myled_release,
     .read = myled_read,
     .write = myled_write,
+    .poll = myled_poll,
+    .unlocked_ioctl = myled_ioctl,
 };
 
 //
@@ -165,82 +800,143 @@ static const struct file_operations myled_fops = {
 static int myled_probe(struct platform_device *pdev)
 {
     int ret;
+    int minor;
+    unsigned int i;
     struct myled_data *data;
 
-    dev_info(&pdev->dev, "Probing myled platform driver...\n");
+    dev_dbg(&pdev->dev, "Probing myled platform driver...\n");
 
-    data = devm_kzalloc(&pdev->dev, sizeof(*data), GFP_KERNEL);
+    data = kzalloc(sizeof(*data), GFP_KERNEL);
     if (!data)
         return -ENOMEM;
 
-    g_data = data;
+    kref_init(&data->kref);
+    platform_set_drvdata(pdev, data);
     mutex_init(&data->lock);
+    seqlock_init(&data->value_seq);
     data->value = 0;
 
-    // 1. Get GPIO from device tree
-    data->gpiod = devm_gpiod_get(&pdev->dev, NULL, GPIOD_OUT_LOW);
-    if (IS_ERR(data->gpiod)) {
-        dev_err(&pdev->dev, "Failed to get GPIO from DT\n");
-        return PTR_ERR(data->gpiod);
+    // 1. Get all LED GPIOs from device tree ("gpios" may list 1..64 lines)
+    data->gpios = devm_gpiod_get_array(&pdev->dev, NULL, GPIOD_OUT_LOW);
+    if (IS_ERR(data->gpios)) {
+        dev_err(&pdev->dev, "Failed to get GPIOs from DT\n");
+        ret = PTR_ERR(data->gpios);
+        goto err_put;
+    }
+    data->nr_leds = data->gpios->ndescs;
+    if (data->nr_leds > MYLED_MAX_LINES) {
+        dev_err(&pdev->dev, "%u GPIOs, at most %d supported\n",
+                data->nr_leds, MYLED_MAX_LINES);
+        ret = -EINVAL;
+        goto err_put;
     }
 
-    // 2. Create class
-    data->class = class_create(THIS_MODULE, DRIVER_NAME);
-    if (IS_ERR(data->class))
-        return PTR_ERR(data->class);
-
-    // 3. Allocate char device region
-    ret = alloc_chrdev_region(&data->devt, 0, 1, DRIVER_NAME);
+    // hrtimer callbacks cannot sleep: remember if any line needs the deferred path
+    data->can_sleep = force_deferred;
+    for (i = 0; i < data->nr_leds; i++)
+        data->can_sleep |= gpiod_cansleep(data->gpios->desc[i]);
+
+    hrtimer_init(&data->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    data->timer.function = myled_pattern_timer;
+    spin_lock_init(&data->pattern_lock);
+    mutex_init(&data->apply_lock);
+
+    // input mode state; the IRQs themselves are only requested on direction = "in"
+    data->lines = devm_kcalloc(&pdev->dev, data->nr_leds, sizeof(*data->lines),
+                               GFP_KERNEL);
+    if (!data->lines) {
+        ret = -ENOMEM;
+        goto err_put;
+    }
+    for (i = 0; i < data->nr_leds; i++) {
+        data->lines[i].data = data;
+        data->lines[i].idx = i;
+    }
+    spin_lock_init(&data->events_lock);
+    mutex_init(&data->read_lock);
+    init_waitqueue_head(&data->events_wq);
+    ret = kfifo_alloc(&data->events, event_fifo_size, GFP_KERNEL);
     if (ret)
-        goto err_class;
+        goto err_put;
+
+    if (data->can_sleep) {
+        data->gpio_thread = kthread_run(myled_gpio_thread, data, "myled-%s",
+                                        dev_name(&pdev->dev));
+        if (IS_ERR(data->gpio_thread)) {
+            ret = PTR_ERR(data->gpio_thread);
+            data->gpio_thread = NULL;
+            goto err_put;
+        }
+    }
+
+    // 2. Take a free minor in the shared region (the IDA has its own lock)
+    minor = ida_alloc_max(&myled_ida, MYLED_MAX_MINORS - 1, GFP_KERNEL);
+    if (minor < 0) {
+        ret = minor;
+        goto err_thread;
+    }
+    data->devt = MKDEV(MAJOR(myled_devt_base), minor);
 
-    // 4. Init and add cdev
+    // 3. Init cdev and the myledN device, which holds a reference on data
     cdev_init(&data->cdev, &myled_fops);
     data->cdev.owner = THIS_MODULE;
-    ret = cdev_add(&data->cdev, data->devt, 1);
-    if (ret)
-        goto err_chrdev;
-
-    // 5. Create device node in /dev
-    data->dev = device_create(data->class, NULL, data->devt,
-                              NULL, DRIVER_NAME);
-    if (IS_ERR(data->dev)) {
-        ret = PTR_ERR(data->dev);
-        goto err_cdev;
+    device_initialize(&data->dev);
+    data->dev.class = myled_class;
+    data->dev.parent = &pdev->dev;
+    data->dev.devt = data->devt;
+    data->dev.groups = myled_groups;
+    data->dev.release = myled_dev_release;
+    dev_set_drvdata(&data->dev, data);
+    kref_get(&data->kref);
+
+    // 4. Add both: /dev/myledN appears, attributes exist before the uevent goes out
+    ret = dev_set_name(&data->dev, DRIVER_NAME "%d", minor);
+    if (!ret)
+        ret = cdev_device_add(&data->cdev, &data->dev);
+    if (ret) {
+        put_device(&data->dev);
+        goto err_ida;
     }
+    data->value_kn = sysfs_get_dirent(data->dev.kobj.sd, "value");
 
-    dev_set_drvdata(data->dev, data);
-
-    // 6. Create sysfs attributes
-    ret = sysfs_create_group(&data->dev->kobj, &myled_attr_group);
-    if (ret)
-        goto err_device;
-
-    dev_info(&pdev->dev, "myled: driver ready\n");
+    dev_info(&pdev->dev, "%s: driver ready (%u LEDs, %s GPIO path)\n",
+             dev_name(&data->dev), data->nr_leds,
+             data->can_sleep ? "kthread" : "atomic");
     return 0;
 
-err_device:
-    device_destroy(data->class, data->devt);
-err_cdev:
-    cdev_del(&data->cdev);
-err_chrdev:
-    unregister_chrdev_region(data->devt, 1);
-err_class:
-    class_destroy(data->class);
+err_ida:
+    ida_free(&myled_ida, minor);
+err_thread:
+    if (data->gpio_thread)
+        kthread_stop(data->gpio_thread);
+err_put:
+    myled_data_put(data);
     return ret;
 }
 
 static int myled_remove(struct platform_device *pdev)
 {
-    struct myled_data *data = g_data;
+    struct myled_data *data = platform_get_drvdata(pdev);
+
+    cdev_device_del(&data->cdev, &data->dev);
 
-    sysfs_remove_group(&data->dev->kobj, &myled_attr_group);
-    device_destroy(data->class, data->devt);
-    cdev_del(&data->cdev);
-    unregister_chrdev_region(data->devt, 1);
-    class_destroy(data->class);
+    // files still open can't reach the player or the GPIOs any more
+    mutex_lock(&data->lock);
+    data->removed = true;
+    myled_set_output(data);
+    myled_pattern_stop(data);
+    mutex_unlock(&data->lock);
+    wake_up_interruptible(&data->events_wq);   // pollers see EPOLLHUP
+    if (data->gpio_thread)
+        kthread_stop(data->gpio_thread);
+
+    ida_free(&myled_ida, MINOR(data->devt));
 
     dev_info(&pdev->dev, "myled removed\n");
+
+    // the event fifo and value_kn go with the last open file
+    put_device(&data->dev);
+    myled_data_put(data);
     return 0;
 }
 
@@ -256,10 +952,46 @@ static struct platform_driver myled_driver = {
     .driver = {
         .name = DRIVER_NAME,
         .of_match_table = myled_of_match,
+        // instances are independent: let many DT nodes bind in parallel
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
     },
 };
 
-module_platform_driver(myled_driver);
+static int __init myled_init(void)
+{
+    int ret;
+
+    myled_class = class_create(THIS_MODULE, DRIVER_NAME);
+    if (IS_ERR(myled_class))
+        return PTR_ERR(myled_class);
+
+    ret = alloc_chrdev_region(&myled_devt_base, 0, MYLED_MAX_MINORS, DRIVER_NAME);
+    if (ret)
+        goto err_class;
+
+    ret = platform_driver_register(&myled_driver);
+    if (ret)
+        goto err_chrdev;
+
+    return 0;
+
+err_chrdev:
+    unregister_chrdev_region(myled_devt_base, MYLED_MAX_MINORS);
+err_class:
+    class_destroy(myled_class);
+    return ret;
+}
+
+static void __exit myled_exit(void)
+{
+    platform_driver_unregister(&myled_driver);
+    unregister_chrdev_region(myled_devt_base, MYLED_MAX_MINORS);
+    class_destroy(myled_class);
+    ida_destroy(&myled_ida);
+}
+
+module_init(myled_init);
+module_exit(myled_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Ragab Elsayed");
@@ -0,0 +1,120 @@
+/*
+ * pattern_jitter.c - edge timing of the in-kernel pattern player versus
+ * toggling the LEDs from userspace with write() on an absolute schedule.
+ *
+ * gcc -O2 -o pattern_jitter pattern_jitter.c
+ * sudo ./pattern_jitter kernel [edges] [period_us]
+ * sudo ./pattern_jitter user   [edges] [period_us]
+ *
+ * "late" = time the edge reached the GPIO minus its ideal time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include "ioctl_cmd.h"
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void run_kernel(int fd, int edges, int period_us)
+{
+	struct myled_step *steps = calloc(edges, sizeof(*steps));
+	struct myled_pattern pat = { .nr_steps = edges };
+	struct myled_pattern_stats st;
+	int i;
+
+	for (i = 0; i < edges; i++) {
+		steps[i].level = i & 1;
+		steps[i].duration_us = period_us;
+	}
+	pat.steps = (uintptr_t)steps;
+
+	if (ioctl(fd, MYLED_IOCTL_SET_PATTERN, &pat) < 0) {
+		perror("MYLED_IOCTL_SET_PATTERN");
+		exit(2);
+	}
+	do {
+		usleep(100000);
+		if (ioctl(fd, MYLED_IOCTL_GET_STATS, &st) < 0) {
+			perror("MYLED_IOCTL_GET_STATS");
+			exit(2);
+		}
+	} while (st.running);
+
+	printf("kernel: %llu edges, late avg %.1f us, max %.1f us\n",
+	       (unsigned long long)st.edges,
+	       st.edges ? st.late_ns_sum / 1e3 / st.edges : 0.0,
+	       st.late_ns_max / 1e3);
+	free(steps);
+}
+
+static void run_user(int fd, int edges, int period_us)
+{
+	uint64_t *late = calloc(edges, sizeof(*late));
+	uint64_t sum = 0, start, ideal;
+	struct timespec ts;
+	int i;
+
+	start = now_ns() + 1000000;
+	for (i = 0; i < edges; i++) {
+		ideal = start + (uint64_t)i * period_us * 1000;
+		ts.tv_sec = ideal / 1000000000ULL;
+		ts.tv_nsec = ideal % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+		if (write(fd, (i & 1) ? "1" : "0", 1) != 1) {
+			perror("write");
+			exit(2);
+		}
+		late[i] = now_ns() - ideal;
+		sum += late[i];
+	}
+	qsort(late, edges, sizeof(*late), cmp_u64);
+	printf("user:   %d edges, late avg %.1f us, p99 %.1f us, max %.1f us\n",
+	       edges, sum / 1e3 / edges, late[edges * 99 / 100] / 1e3,
+	       late[edges - 1] / 1e3);
+	free(late);
+}
+
+int main(int argc, char *argv[])
+{
+	int edges = 2000, period_us = 500, fd;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s kernel|user [edges] [period_us]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 2)
+		edges = atoi(argv[2]);
+	if (argc > 3)
+		period_us = atoi(argv[3]);
+
+	fd = open("/dev/myled0", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/myled0");
+		return 2;
+	}
+	if (!strcmp(argv[1], "kernel"))
+		run_kernel(fd, edges, period_us);
+	else
+		run_user(fd, edges, period_us);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,1013 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * chardev.h - the char device boilerplate of examples 6 to 29, written once
+ *
+ * Every one of those examples does the same dance: alloc_chrdev_region(),
+ * cdev_init()/cdev_add(), class_create(), device_create(), and the reverse
+ * on exit, then hangs a message buffer off read/write/lseek. This header
+ * does the dance and leaves only the choice of where the bytes live:
+ *
+ *   chardev_store_array   fixed kmalloc'ed array, the msgbuf.h engine
+ *   chardev_store_pages   sparse, pages allocated on first write (xarray)
+ *   chardev_store_ring    FIFO (kfifo): read consumes, no lseek
+ *   chardev_store_dgram   FIFO of whole messages: one write, one read
+ *
+ * What the examples differ in is set in struct chardev before registering:
+ * several nodes (shared or per-node store), the class name, open/release
+ * and ioctl hooks. chardev_register_misc() makes a misc device instead.
+ *
+ * The fops serialize the store behind one mutex per device and count every
+ * call per CPU. The counters are at /sys/class/<class>/<node>/stats; per-call
+ * timing is off until 1 is written to stats_timing, so the hot path is a
+ * mutex and a this_cpu_add() unless asked for more.
+ *
+ * Usage:
+ *   #include "chardev.h"                        (Makefile: ccflags-y += -I$(src)/../common)
+ *   static struct chardev cd;
+ *
+ *   init: cd.ioctl = myIoctl;                 (optional, see struct chardev)
+ *         return chardev_register(&cd, "msg", &chardev_store_array, 1024);
+ *   exit: chardev_unregister(&cd);
+ *
+ * Like msgbuf.h everything here is static inline: each example stays a
+ * single self-contained module, and THIS_MODULE in chardev_fops is the one
+ * of the including driver.
+ */
+#ifndef __CHARDEV_H
+#define __CHARDEV_H
+
+#include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/fs.h>
+#include <linux/kfifo.h>
+#include <linux/ktime.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/xarray.h>
+#include "msgbuf.h"
+
+/*
+ * Storage backend. 'priv' is what alloc() returned. The core holds the
+ * device mutex around every call except alloc/free. llseek == NULL makes
+ * the device a stream (lseek fails with -ESPIPE, read/write may get pos NULL).
+ */
+struct chardev_store_ops {
+    const char *name;
+    void *(*alloc)(size_t size);
+    void (*free)(void *priv);
+    ssize_t (*read)(void *priv, char __user *buf, size_t count, loff_t *pos);
+    ssize_t (*write)(void *priv, const char __user *buf, size_t count, loff_t *pos);
+    loff_t (*llseek)(void *priv, struct file *file, loff_t off, int whence);
+    void (*clear)(void *priv);
+};
+
+enum {
+    CHARDEV_OP_READ,
+    CHARDEV_OP_WRITE,
+    CHARDEV_OP_LSEEK,
+    CHARDEV_OP_IOCTL,
+    CHARDEV_NR_OPS
+};
+
+struct chardev_op_stats {
+    u64 calls;
+    u64 bytes;
+    u64 errors;
+    u64 ns;             /* only while stats_timing is 1 */
+};
+
+struct chardev_stats {
+    struct chardev_op_stats op[CHARDEV_NR_OPS];
+};
+
+struct chardev;
+
+/* one /dev node; file->private_data points here */
+struct chardev_node {
+    struct chardev *cd;
+    void *priv;                 /* this node's store, with node_stores only */
+    struct device *device;
+};
+
+struct chardev {
+    /* optional, set before chardev_register() */
+    const char *class_name;     /* default: the device name */
+    unsigned int baseminor;
+    unsigned int nr_nodes;      /* default 1, /dev/<name>; N > 1: /dev/<name>0..N-1 */
+    bool node_stores;           /* a store per node instead of one for all */
+    umode_t mode;               /* chardev_register_misc() only: /dev node mode */
+    int (*open)(struct chardev *cd, struct inode *inode, struct file *file);
+    int (*release)(struct chardev *cd, struct inode *inode, struct file *file);
+    long (*ioctl)(struct chardev *cd, unsigned int cmd, unsigned long arg);
+    long (*compat_ioctl)(struct chardev *cd, unsigned int cmd, unsigned long arg);
+    void *driver_data;
+
+    /* filled in by chardev_register() */
+    const struct chardev_store_ops *store;     /* NULL: nodes that cannot be opened */
+    void *priv;                 /* the shared store, unless node_stores */
+    size_t size;
+    struct chardev_node *nodes;
+    dev_t devt;
+    struct cdev cdev;
+    struct class *class;
+    struct miscdevice misc;     /* chardev_register_misc() only */
+    struct mutex lock;
+    struct chardev_stats __percpu *stats;
+    bool timing;
+};
+
+/* ---------------- array: the msgbuf.h engine over a kmalloc'ed buffer */
+
+struct chardev_array {
+    struct msgbuf mb;
+    char data[];
+};
+
+static inline void *chardev_array_alloc(size_t size)
+{
+    struct chardev_array *a = kzalloc(struct_size(a, data, size), GFP_KERNEL);
+
+    if (!a)
+        return NULL;
+    msgbuf_init(&a->mb, a->data, size);
+    return a;
+}
+
+static inline void chardev_array_free(void *priv)
+{
+    kfree(priv);
+}
+
+static inline ssize_t chardev_array_read(void *priv, char __user *buf, size_t count, loff_t *pos)
+{
+    struct chardev_array *a = priv;
+
+    return msgbuf_read(&a->mb, buf, count, pos);
+}
+
+static inline ssize_t chardev_array_write(void *priv, const char __user *buf, size_t count,
+                                          loff_t *pos)
+{
+    struct chardev_array *a = priv;
+
+    return msgbuf_write(&a->mb, buf, count, pos);
+}
+
+static inline loff_t chardev_array_llseek(void *priv, struct file *file, loff_t off, int whence)
+{
+    struct chardev_array *a = priv;
+
+    return msgbuf_llseek(&a->mb, file, off, whence);
+}
+
+static inline void chardev_array_clear(void *priv)
+{
+    struct chardev_array *a = priv;
+
+    a->mb.len = 0;
+}
+
+static const struct chardev_store_ops chardev_store_array = {
+    .name = "array",
+    .alloc = chardev_array_alloc,
+    .free = chardev_array_free,
+    .read = chardev_array_read,
+    .write = chardev_array_write,
+    .llseek = chardev_array_llseek,
+    .clear = chardev_array_clear,
+};
+
+/*
+ * ---------------- pages: same file semantics as the array, but memory is
+ * only taken for pages that were written. Holes below 'len' read as zeros.
+ * The msgbuf keeps len/size for the span and seek helpers; its data is unused.
+ */
+
+struct chardev_pages {
+    struct msgbuf mb;
+    struct xarray pages;        /* page index -> struct page */
+};
+
+static inline void *chardev_pages_alloc(size_t size)
+{
+    struct chardev_pages *p = kzalloc(sizeof(*p), GFP_KERNEL);
+
+    if (!p)
+        return NULL;
+    msgbuf_init(&p->mb, NULL, size);
+    xa_init(&p->pages);
+    return p;
+}
+
+static inline void chardev_pages_clear(void *priv)
+{
+    struct chardev_pages *p = priv;
+    struct page *page;
+    unsigned long index;
+
+    xa_for_each(&p->pages, index, page)
+        __free_page(page);
+    xa_destroy(&p->pages);
+    p->mb.len = 0;
+}
+
+static inline void chardev_pages_free(void *priv)
+{
+    chardev_pages_clear(priv);
+    kfree(priv);
+}
+
+static inline ssize_t chardev_pages_read(void *priv, char __user *buf, size_t count, loff_t *pos)
+{
+    struct chardev_pages *p = priv;
+    size_t n = msgbuf_read_span(&p->mb, *pos, count);
+    size_t done = 0;
+
+    while (done < n) {
+        loff_t at = *pos + done;
+        size_t off = offset_in_page(at);
+        size_t chunk = min_t(size_t, n - done, PAGE_SIZE - off);
+        struct page *page = xa_load(&p->pages, at >> PAGE_SHIFT);
+        unsigned long left;
+
+        if (page)
+            left = copy_to_user(buf + done, page_address(page) + off, chunk);
+        else
+            left = clear_user(buf + done, chunk);
+
+        done += chunk - left;
+        if (left)
+            break;
+    }
+
+    if (!done && n)
+        return -EFAULT;
+    *pos += done;
+    return done;
+}
+
+static inline ssize_t chardev_pages_write(void *priv, const char __user *buf, size_t count,
+                                          loff_t *pos)
+{
+    struct chardev_pages *p = priv;
+    ssize_t n = msgbuf_write_span(&p->mb, *pos, count);
+    size_t done = 0;
+    int err = 0;
+
+    if (n <= 0)
+        return n;
+
+    while (done < n) {
+        loff_t at = *pos + done;
+        size_t off = offset_in_page(at);
+        size_t chunk = min_t(size_t, n - done, PAGE_SIZE - off);
+        struct page *page = xa_load(&p->pages, at >> PAGE_SHIFT);
+        unsigned long left;
+
+        if (!page) {
+            page = alloc_page(GFP_KERNEL | __GFP_ZERO);
+            if (!page) {
+                err = -ENOMEM;
+                break;
+            }
+            err = xa_err(xa_store(&p->pages, at >> PAGE_SHIFT, page, GFP_KERNEL));
+            if (err) {
+                __free_page(page);
+                break;
+            }
+        }
+
+        left = copy_from_user(page_address(page) + off, buf + done, chunk);
+        done += chunk - left;
+        if (left) {
+            err = -EFAULT;
+            break;
+        }
+    }
+
+    if (!done)
+        return err;
+    *pos += done;
+    if (*pos > p->mb.len)
+        p->mb.len = *pos;
+    return done;
+}
+
+static inline loff_t chardev_pages_llseek(void *priv, struct file *file, loff_t off, int whence)
+{
+    struct chardev_pages *p = priv;
+
+    return msgbuf_llseek(&p->mb, file, off, whence);
+}
+
+static const struct chardev_store_ops chardev_store_pages = {
+    .name = "pages",
+    .alloc = chardev_pages_alloc,
+    .free = chardev_pages_free,
+    .read = chardev_pages_read,
+    .write = chardev_pages_write,
+    .llseek = chardev_pages_llseek,
+    .clear = chardev_pages_clear,
+};
+
+/*
+ * ---------------- ring: a FIFO. The size is rounded up to a power of two
+ * by kfifo. A write into a full ring is -ENOSPC, like a write at the end of
+ * the array; a read of an empty ring is 0 (EOF).
+ */
+
+struct chardev_ring {
+    struct kfifo fifo;
+};
+
+static inline void *chardev_ring_alloc(size_t size)
+{
+    struct chardev_ring *r = kzalloc(sizeof(*r), GFP_KERNEL);
+
+    if (!r)
+        return NULL;
+    if (kfifo_alloc(&r->fifo, size, GFP_KERNEL)) {
+        kfree(r);
+        return NULL;
+    }
+    return r;
+}
+
+static inline void chardev_ring_free(void *priv)
+{
+    struct chardev_ring *r = priv;
+
+    kfifo_free(&r->fifo);
+    kfree(r);
+}
+
+static inline ssize_t chardev_ring_read(void *priv, char __user *buf, size_t count, loff_t *pos)
+{
+    struct chardev_ring *r = priv;
+    unsigned int copied;
+    int ret;
+
+    ret = kfifo_to_user(&r->fifo, buf, count, &copied);
+    return ret ? ret : copied;
+}
+
+static inline ssize_t chardev_ring_write(void *priv, const char __user *buf, size_t count,
+                                         loff_t *pos)
+{
+    struct chardev_ring *r = priv;
+    unsigned int copied;
+    int ret;
+
+    if (!count)
+        return 0;
+    if (kfifo_is_full(&r->fifo))
+        return -ENOSPC;
+    ret = kfifo_from_user(&r->fifo, buf, count, &copied);
+    return ret ? ret : copied;
+}
+
+static inline void chardev_ring_clear(void *priv)
+{
+    struct chardev_ring *r = priv;
+
+    kfifo_reset(&r->fifo);
+}
+
+static const struct chardev_store_ops chardev_store_ring = {
+    .name = "ring",
+    .alloc = chardev_ring_alloc,
+    .free = chardev_ring_free,
+    .read = chardev_ring_read,
+    .write = chardev_ring_write,
+    .clear = chardev_ring_clear,
+};
+
+/*
+ * ---------------- dgram: a FIFO of messages, each kept with a 2 byte length
+ * header, so one message is at most 65535 bytes (and must fit). write()
+ * queues one whole message or fails with -EAGAIN when it does not fit;
+ * read() returns one message, 0 when the queue is empty, or -EMSGSIZE
+ * (the message stays queued) when the user buffer is too small for it.
+ */
+
+#define CHARDEV_DGRAM_HDR       sizeof(u16)
+
+struct chardev_dgram {
+    struct kfifo_rec_ptr_2 fifo;
+};
+
+static inline void *chardev_dgram_alloc(size_t size)
+{
+    struct chardev_dgram *d = kzalloc(sizeof(*d), GFP_KERNEL);
+
+    if (!d)
+        return NULL;
+    if (kfifo_alloc(&d->fifo, size, GFP_KERNEL)) {
+        kfree(d);
+        return NULL;
+    }
+    return d;
+}
+
+static inline void chardev_dgram_free(void *priv)
+{
+    struct chardev_dgram *d = priv;
+
+    kfifo_free(&d->fifo);
+    kfree(d);
+}
+
+static inline ssize_t chardev_dgram_read(void *priv, char __user *buf, size_t count, loff_t *pos)
+{
+    struct chardev_dgram *d = priv;
+    unsigned int copied;
+    int ret;
+
+    if (kfifo_is_empty(&d->fifo))
+        return 0;
+    if (count < kfifo_peek_len(&d->fifo))
+        return -EMSGSIZE;
+    ret = kfifo_to_user(&d->fifo, buf, count, &copied);
+    return ret ? ret : copied;
+}
+
+static inline ssize_t chardev_dgram_write(void *priv, const char __user *buf, size_t count,
+                                          loff_t *pos)
+{
+    struct chardev_dgram *d = priv;
+    unsigned int copied;
+    int ret;
+
+    if (!count)
+        return 0;
+    if (count > min_t(size_t, U16_MAX, kfifo_size(&d->fifo) - CHARDEV_DGRAM_HDR))
+        return -EMSGSIZE;
+
+    /* a record fifo takes the whole message or nothing */
+    ret = kfifo_from_user(&d->fifo, buf, count, &copied);
+    if (ret)
+        return ret;
+    return copied ? copied : -EAGAIN;
+}
+
+static inline void chardev_dgram_clear(void *priv)
+{
+    struct chardev_dgram *d = priv;
+
+    kfifo_reset(&d->fifo);
+}
+
+static const struct chardev_store_ops chardev_store_dgram = {
+    .name = "dgram",
+    .alloc = chardev_dgram_alloc,
+    .free = chardev_dgram_free,
+    .read = chardev_dgram_read,
+    .write = chardev_dgram_write,
+    .clear = chardev_dgram_clear,
+};
+
+/* Backend by name, for a module parameter. NULL if unknown. */
+static inline const struct chardev_store_ops *chardev_store_find(const char *name)
+{
+    static const struct chardev_store_ops *const stores[] = {
+        &chardev_store_array, &chardev_store_pages, &chardev_store_ring,
+        &chardev_store_dgram,
+    };
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(stores); i++)
+        if (sysfs_streq(name, stores[i]->name))
+            return stores[i];
+    return NULL;
+}
+
+/* ---------------- instrumented fops */
+
+static inline u64 chardev_clock(struct chardev *cd)
+{
+    return READ_ONCE(cd->timing) ? ktime_get_ns() : 0;
+}
+
+static inline void chardev_account(struct chardev *cd, int op, s64 ret, u64 t0)
+{
+    this_cpu_inc(cd->stats->op[op].calls);
+    if (ret < 0)
+        this_cpu_inc(cd->stats->op[op].errors);
+    else if (op == CHARDEV_OP_READ || op == CHARDEV_OP_WRITE)
+        this_cpu_add(cd->stats->op[op].bytes, ret);
+    if (t0)
+        this_cpu_add(cd->stats->op[op].ns, ktime_get_ns() - t0);
+}
+
+/* the store behind a node; call with cd->lock held */
+static inline void *chardev_node_priv(struct chardev_node *node)
+{
+    return node->cd->node_stores ? node->priv : node->cd->priv;
+}
+
+static inline int chardev_open(struct inode *inode, struct file *file)
+{
+    const struct chardev_store_ops *store;
+    struct chardev_node *node;
+    struct chardev *cd;
+
+    /* misc_open() has already pointed private_data at the miscdevice */
+    if (imajor(inode) == MISC_MAJOR) {
+        cd = container_of(file->private_data, struct chardev, misc);
+        node = cd->nodes;
+    } else {
+        cd = container_of(inode->i_cdev, struct chardev, cdev);
+        node = &cd->nodes[iminor(inode) - MINOR(cd->devt)];
+    }
+
+    /* nothing behind the node: what a cdev without fops answers */
+    store = READ_ONCE(cd->store);
+    if (!store)
+        return -ENXIO;
+
+    file->private_data = node;
+    if (!store->llseek)
+        stream_open(inode, file);
+    return cd->open ? cd->open(cd, inode, file) : 0;
+}
+
+static inline int chardev_release(struct inode *inode, struct file *file)
+{
+    struct chardev_node *node = file->private_data;
+    struct chardev *cd = node->cd;
+
+    return cd->release ? cd->release(cd, inode, file) : 0;
+}
+
+static inline ssize_t chardev_read(struct file *file, char __user *buf, size_t count,
+                                   loff_t *pos)
+{
+    struct chardev_node *node = file->private_data;
+    struct chardev *cd = node->cd;
+    u64 t0 = chardev_clock(cd);
+    ssize_t ret;
+
+    if (mutex_lock_interruptible(&cd->lock))
+        return -ERESTARTSYS;
+    /*
+     * Opened while the store was a stream, so the VFS passes no position;
+     * a seekable store swapped in since carries on from f_pos instead.
+     */
+    ret = cd->store->read(chardev_node_priv(node), buf, count, pos ?: &file->f_pos);
+    mutex_unlock(&cd->lock);
+
+    chardev_account(cd, CHARDEV_OP_READ, ret, t0);
+    return ret;
+}
+
+static inline ssize_t chardev_write(struct file *file, const char __user *buf, size_t count,
+                                    loff_t *pos)
+{
+    struct chardev_node *node = file->private_data;
+    struct chardev *cd = node->cd;
+    u64 t0 = chardev_clock(cd);
+    ssize_t ret;
+
+    if (mutex_lock_interruptible(&cd->lock))
+        return -ERESTARTSYS;
+    ret = cd->store->write(chardev_node_priv(node), buf, count, pos ?: &file->f_pos);
+    mutex_unlock(&cd->lock);
+
+    chardev_account(cd, CHARDEV_OP_WRITE, ret, t0);
+    return ret;
+}
+
+static inline loff_t chardev_llseek(struct file *file, loff_t off, int whence)
+{
+    struct chardev_node *node = file->private_data;
+    struct chardev *cd = node->cd;
+    u64 t0 = chardev_clock(cd);
+    loff_t ret;
+
+    mutex_lock(&cd->lock);
+    if (cd->store->llseek)
+        ret = cd->store->llseek(chardev_node_priv(node), file, off, whence);
+    else
+        ret = -ESPIPE;
+    mutex_unlock(&cd->lock);
+
+    chardev_account(cd, CHARDEV_OP_LSEEK, ret, t0);
+    return ret;
+}
+
+static inline long chardev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct chardev_node *node = file->private_data;
+    struct chardev *cd = node->cd;
+    u64 t0 = chardev_clock(cd);
+    long ret;
+
+    if (!cd->ioctl)
+        return -ENOTTY;
+
+    ret = cd->ioctl(cd, cmd, arg);
+    chardev_account(cd, CHARDEV_OP_IOCTL, ret, t0);
+    return ret;
+}
+
+/* 32 bit callers on a 64 bit kernel; without the hook they get -ENOTTY */
+static inline long chardev_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct chardev_node *node = file->private_data;
+    struct chardev *cd = node->cd;
+    u64 t0 = chardev_clock(cd);
+    long ret;
+
+    if (!cd->compat_ioctl)
+        return -ENOIOCTLCMD;
+
+    ret = cd->compat_ioctl(cd, cmd, arg);
+    chardev_account(cd, CHARDEV_OP_IOCTL, ret, t0);
+    return ret;
+}
+
+static const struct file_operations chardev_fops = {
+    .owner = THIS_MODULE,
+    .open = chardev_open,
+    .release = chardev_release,
+    .read = chardev_read,
+    .write = chardev_write,
+    .llseek = chardev_llseek,
+    .unlocked_ioctl = chardev_ioctl,
+    .compat_ioctl = chardev_compat_ioctl,
+};
+
+/* Drop the stored data of every node, e.g. from a driver's "clear" ioctl. */
+static inline void chardev_clear(struct chardev *cd)
+{
+    unsigned int i;
+
+    mutex_lock(&cd->lock);
+    if (cd->node_stores)
+        for (i = 0; i < cd->nr_nodes; i++)
+            cd->store->clear(cd->nodes[i].priv);
+    else if (cd->store)
+        cd->store->clear(cd->priv);
+    mutex_unlock(&cd->lock);
+}
+
+/*
+ * The msgbuf of a shared array store, for ioctls that fill or hand out the
+ * bytes themselves. Call with cd->lock held; NULL for any other store.
+ */
+static inline struct msgbuf *chardev_array_msgbuf(struct chardev *cd)
+{
+    lockdep_assert_held(&cd->lock);
+    if (cd->store != &chardev_store_array || cd->node_stores)
+        return NULL;
+    return &((struct chardev_array *)cd->priv)->mb;
+}
+
+/*
+ * Replace the shared store by an empty 'store' of 'size' bytes, e.g. from a
+ * mode ioctl; the old data is dropped. Files opened while the store was a
+ * stream stay streams: they read and write a seekable one sequentially.
+ */
+static inline int chardev_set_store(struct chardev *cd, const struct chardev_store_ops *store,
+                                    size_t size)
+{
+    const struct chardev_store_ops *old_store;
+    void *priv, *old;
+
+    if (WARN_ON(cd->node_stores || !cd->store))
+        return -EINVAL;
+
+    priv = store->alloc(size);
+    if (!priv)
+        return -ENOMEM;
+
+    mutex_lock(&cd->lock);
+    old_store = cd->store;
+    old = cd->priv;
+    WRITE_ONCE(cd->store, store);
+    cd->priv = priv;
+    WRITE_ONCE(cd->size, size);
+    mutex_unlock(&cd->lock);
+
+    old_store->free(old);
+    return 0;
+}
+
+/*
+ * ---------------- sysfs: store, size, stats, stats_timing. Spelled out
+ * with __ATTR() so the names cannot clash with the including driver's own.
+ */
+
+static inline struct chardev *chardev_from_dev(struct device *dev)
+{
+    /* misc_register() gives device_create() the miscdevice as drvdata */
+    if (MAJOR(dev->devt) == MISC_MAJOR)
+        return container_of((struct miscdevice *)dev_get_drvdata(dev), struct chardev, misc);
+    return dev_get_drvdata(dev);
+}
+
+static inline ssize_t chardev_store_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct chardev *cd = chardev_from_dev(dev);
+    const struct chardev_store_ops *store = READ_ONCE(cd->store);
+
+    return sysfs_emit(buf, "%s\n", store ? store->name : "none");
+}
+static struct device_attribute chardev_attr_store =
+    __ATTR(store, 0444, chardev_store_show, NULL);
+
+static inline ssize_t chardev_size_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct chardev *cd = chardev_from_dev(dev);
+
+    return sysfs_emit(buf, "%zu\n", READ_ONCE(cd->size));
+}
+static struct device_attribute chardev_attr_size =
+    __ATTR(size, 0444, chardev_size_show, NULL);
+
+/* one line per op: calls bytes errors ns; write anything to zero them */
+static inline ssize_t chardev_stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    static const char *const names[CHARDEV_NR_OPS] = { "read", "write", "lseek", "ioctl" };
+    struct chardev *cd = chardev_from_dev(dev);
+    struct chardev_op_stats sum[CHARDEV_NR_OPS] = {};
+    ssize_t len = 0;
+    int cpu, i;
+
+    for_each_possible_cpu(cpu) {
+        struct chardev_stats *s = per_cpu_ptr(cd->stats, cpu);
+
+        for (i = 0; i < CHARDEV_NR_OPS; i++) {
+            sum[i].calls += s->op[i].calls;
+            sum[i].bytes += s->op[i].bytes;
+            sum[i].errors += s->op[i].errors;
+            sum[i].ns += s->op[i].ns;
+        }
+    }
+
+    for (i = 0; i < CHARDEV_NR_OPS; i++)
+        len += sysfs_emit_at(buf, len, "%s %llu %llu %llu %llu\n", names[i],
+                             sum[i].calls, sum[i].bytes, sum[i].errors, sum[i].ns);
+    return len;
+}
+
+static inline ssize_t chardev_stats_store(struct device *dev, struct device_attribute *attr,
+                                          const char *buf, size_t count)
+{
+    struct chardev *cd = chardev_from_dev(dev);
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(cd->stats, cpu), 0, sizeof(struct chardev_stats));
+    return count;
+}
+static struct device_attribute chardev_attr_stats =
+    __ATTR(stats, 0644, chardev_stats_show, chardev_stats_store);
+
+static inline ssize_t chardev_timing_show(struct device *dev, struct device_attribute *attr,
+                                          char *buf)
+{
+    struct chardev *cd = chardev_from_dev(dev);
+
+    return sysfs_emit(buf, "%d\n", READ_ONCE(cd->timing));
+}
+
+static inline ssize_t chardev_timing_store(struct device *dev, struct device_attribute *attr,
+                                           const char *buf, size_t count)
+{
+    struct chardev *cd = chardev_from_dev(dev);
+    bool on;
+    int ret;
+
+    ret = kstrtobool(buf, &on);
+    if (ret)
+        return ret;
+    WRITE_ONCE(cd->timing, on);
+    return count;
+}
+static struct device_attribute chardev_attr_stats_timing =
+    __ATTR(stats_timing, 0644, chardev_timing_show, chardev_timing_store);
+
+static struct attribute *chardev_attrs[] = {
+    &chardev_attr_store.attr,
+    &chardev_attr_size.attr,
+    &chardev_attr_stats.attr,
+    &chardev_attr_stats_timing.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(chardev);
+
+/* ---------------- registration */
+
+static inline int chardev_alloc_stores(struct chardev *cd)
+{
+    unsigned int i;
+
+    if (!cd->store)
+        return 0;
+    if (!cd->node_stores) {
+        cd->priv = cd->store->alloc(cd->size);
+        return cd->priv ? 0 : -ENOMEM;
+    }
+
+    for (i = 0; i < cd->nr_nodes; i++) {
+        cd->nodes[i].priv = cd->store->alloc(cd->size);
+        if (!cd->nodes[i].priv) {
+            while (i--)
+                cd->store->free(cd->nodes[i].priv);
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
+static inline void chardev_free_stores(struct chardev *cd)
+{
+    unsigned int i;
+
+    if (!cd->store)
+        return;
+    if (!cd->node_stores) {
+        cd->store->free(cd->priv);
+        return;
+    }
+    for (i = 0; i < cd->nr_nodes; i++)
+        cd->store->free(cd->nodes[i].priv);
+}
+
+/* everything but the device numbers and nodes: lock, counters, stores */
+static inline int chardev_setup(struct chardev *cd, const struct chardev_store_ops *store,
+                                size_t size)
+{
+    unsigned int i;
+    int ret;
+
+    cd->store = store;
+    cd->size = size;
+    if (!cd->nr_nodes)
+        cd->nr_nodes = 1;
+    mutex_init(&cd->lock);
+
+    cd->stats = alloc_percpu(struct chardev_stats);
+    if (!cd->stats)
+        return -ENOMEM;
+
+    cd->nodes = kcalloc(cd->nr_nodes, sizeof(*cd->nodes), GFP_KERNEL);
+    if (!cd->nodes) {
+        ret = -ENOMEM;
+        goto err_stats;
+    }
+    for (i = 0; i < cd->nr_nodes; i++)
+        cd->nodes[i].cd = cd;
+
+    ret = chardev_alloc_stores(cd);
+    if (ret)
+        goto err_nodes;
+    return 0;
+
+err_nodes:
+    kfree(cd->nodes);
+err_stats:
+    free_percpu(cd->stats);
+    return ret;
+}
+
+static inline void chardev_teardown(struct chardev *cd)
+{
+    chardev_free_stores(cd);
+    kfree(cd->nodes);
+    free_percpu(cd->stats);
+}
+
+static inline const char *chardev_store_name(const struct chardev_store_ops *store)
+{
+    return store ? store->name : "no";
+}
+
+/*
+ * nr_nodes device nodes, /dev/<name> or /dev/<name>0.., in class
+ * class_name (default <name>), backed by 'store' of 'size' bytes; a NULL
+ * store makes nodes that fail to open. On failure everything done so far
+ * is undone.
+ */
+static inline int chardev_register(struct chardev *cd, const char *name,
+                                   const struct chardev_store_ops *store, size_t size)
+{
+    const char *class_name = cd->class_name ?: name;
+    struct device *dev;
+    unsigned int i;
+    int ret;
+
+    ret = chardev_setup(cd, store, size);
+    if (ret)
+        return ret;
+
+    ret = alloc_chrdev_region(&cd->devt, cd->baseminor, cd->nr_nodes, name);
+    if (ret < 0) {
+        pr_err("%s: failed to allocate device number\n", name);
+        goto err_setup;
+    }
+
+    cdev_init(&cd->cdev, &chardev_fops);
+    cd->cdev.owner = THIS_MODULE;
+    ret = cdev_add(&cd->cdev, cd->devt, cd->nr_nodes);
+    if (ret < 0) {
+        pr_err("%s: failed to add cdev\n", name);
+        goto err_region;
+    }
+
+    cd->class = class_create(THIS_MODULE, class_name);
+    if (IS_ERR(cd->class)) {
+        pr_err("%s: failed to create class %s\n", name, class_name);
+        ret = PTR_ERR(cd->class);
+        goto err_cdev;
+    }
+
+    for (i = 0; i < cd->nr_nodes; i++) {
+        dev_t devt = MKDEV(MAJOR(cd->devt), MINOR(cd->devt) + i);
+
+        if (cd->nr_nodes == 1)
+            dev = device_create_with_groups(cd->class, NULL, devt, cd, chardev_groups,
+                                            "%s", name);
+        else
+            dev = device_create_with_groups(cd->class, NULL, devt, cd, chardev_groups,
+                                            "%s%u", name, i);
+        if (IS_ERR(dev)) {
+            pr_err("%s: failed to create device %u\n", name, i);
+            ret = PTR_ERR(dev);
+            goto err_devices;
+        }
+        cd->nodes[i].device = dev;
+    }
+
+    pr_info("%s: /dev/%s%s, major %d, %s store of %zu bytes%s\n", name, name,
+            cd->nr_nodes > 1 ? "0.." : "", MAJOR(cd->devt), chardev_store_name(store), size,
+            cd->node_stores ? " per node" : "");
+    return 0;
+
+err_devices:
+    while (i--)
+        device_destroy(cd->class, MKDEV(MAJOR(cd->devt), MINOR(cd->devt) + i));
+    class_destroy(cd->class);
+err_cdev:
+    cdev_del(&cd->cdev);
+err_region:
+    unregister_chrdev_region(cd->devt, cd->nr_nodes);
+err_setup:
+    chardev_teardown(cd);
+    return ret;
+}
+
+/*
+ * The same as a misc device: /dev/<name> on major 10 with a dynamic minor,
+ * in the misc class. One node only; class_name, baseminor and nr_nodes do
+ * not apply, cd->mode (if set) is the mode of the node.
+ */
+static inline int chardev_register_misc(struct chardev *cd, const char *name,
+                                        const struct chardev_store_ops *store, size_t size)
+{
+    int ret;
+
+    cd->nr_nodes = 1;
+    cd->node_stores = false;
+    ret = chardev_setup(cd, store, size);
+    if (ret)
+        return ret;
+
+    cd->misc.minor = MISC_DYNAMIC_MINOR;
+    cd->misc.name = name;
+    cd->misc.fops = &chardev_fops;
+    cd->misc.groups = chardev_groups;
+    cd->misc.mode = cd->mode;
+    ret = misc_register(&cd->misc);
+    if (ret) {
+        pr_err("%s: failed to register misc device\n", name);
+        chardev_teardown(cd);
+        return ret;
+    }
+    cd->nodes[0].device = cd->misc.this_device;
+
+    pr_info("%s: /dev/%s, misc minor %d, %s store of %zu bytes\n", name, name,
+            cd->misc.minor, chardev_store_name(store), size);
+    return 0;
+}
+
+static inline void chardev_unregister(struct chardev *cd)
+{
+    unsigned int i;
+
+    if (cd->misc.fops) {
+        misc_deregister(&cd->misc);
+    } else {
+        for (i = 0; i < cd->nr_nodes; i++)
+            device_destroy(cd->class, MKDEV(MAJOR(cd->devt), MINOR(cd->devt) + i));
+        class_destroy(cd->class);
+        cdev_del(&cd->cdev);
+        unregister_chrdev_region(cd->devt, cd->nr_nodes);
+    }
+    chardev_teardown(cd);
+}
+
+#endif
@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * msgbuf.h - the message buffer behind /dev/msg, /dev/mydevice, ...
+ *
+ * Examples 14 to 29 all expose the same thing: a fixed array of 'size'
+ * bytes of which the first 'len' are valid data. read() stops at 'len',
+ * write() stops at 'size' and grows 'len', lseek() may go anywhere in
+ * [0, size]. This header is that engine, written once.
+ *
+ * The offset/clamp arithmetic lives in msgbuf_{read,write}_span() and
+ * msgbuf_seek_pos(): pure functions of (buffer state, position, request)
+ * that touch neither user memory nor the file, so they can be exercised
+ * on their own. msgbuf_read/write/llseek() wrap them with the copies and
+ * are what the drivers' fops call.
+ *
+ * No locking: chardev.h's array store calls it under the device mutex, a
+ * driver using it directly (15) holds its own.
+ *
+ * Usage:
+ *   #include "msgbuf.h"                         (Makefile: ccflags-y += -I$(src)/../common)
+ *   static char kernel_buffer[MAX_SIZE];
+ *   static struct msgbuf msg = MSGBUF_INIT(kernel_buffer);
+ *
+ *   static ssize_t myRead(struct file *file, char __user *buf, size_t len, loff_t *off)
+ *   {
+ *       return msgbuf_read(&msg, buf, len, off);
+ *   }
+ */
+#ifndef __MSGBUF_H
+#define __MSGBUF_H
+
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/uaccess.h>
+
+struct msgbuf {
+    char *data;
+    size_t size;        /* capacity of data[] */
+    size_t len;         /* data[0..len) is valid, len <= size */
+};
+
+#define MSGBUF_INIT(array) { .data = (array), .size = sizeof(array), .len = 0 }
+
+static inline void msgbuf_init(struct msgbuf *mb, char *data, size_t size)
+{
+    mb->data = data;
+    mb->size = size;
+    mb->len = 0;
+}
+
+/*
+ * How many bytes a read of 'count' at 'pos' returns; 0 means EOF.
+ *
+ *      pos <---- len - pos ----> len            size
+ *   |---|-----------------------|----------------|
+ *
+ * bytes = min(count, len - pos)
+ */
+static inline size_t msgbuf_read_span(const struct msgbuf *mb, loff_t pos, size_t count)
+{
+    if (pos < 0 || pos >= mb->len)
+        return 0;
+    return min_t(size_t, count, mb->len - pos);
+}
+
+/*
+ * How many bytes a write of 'count' at 'pos' stores, or -ENOSPC when
+ * 'pos' is at (or past) the end of the buffer. A zero-length write at a
+ * valid position stores 0 bytes and is not an error.
+ *
+ *   0    pos <----- size - pos -----> size
+ *   |-----|---------------------------|
+ *
+ * bytes = min(count, size - pos)
+ */
+static inline ssize_t msgbuf_write_span(const struct msgbuf *mb, loff_t pos, size_t count)
+{
+    if (pos < 0)
+        return -EINVAL;
+    if (pos >= mb->size)
+        return -ENOSPC;
+    return min_t(size_t, count, mb->size - pos);
+}
+
+/*
+ * New file position for lseek(off, whence) from 'cur'. SEEK_END is
+ * relative to the valid data (len), not to the capacity. Negative results
+ * are -EINVAL; anything past 'size' is clamped to 'size', so a following
+ * write() gets -ENOSPC rather than the seek failing.
+ */
+static inline loff_t msgbuf_seek_pos(const struct msgbuf *mb, loff_t cur, loff_t off, int whence)
+{
+    loff_t base;
+
+    switch (whence) {
+    case SEEK_SET:
+        base = 0;
+        break;
+    case SEEK_CUR:
+        base = cur;
+        break;
+    case SEEK_END:
+        base = mb->len;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    /* base is within [0, size]; only off can overflow */
+    if (off < 0 ? off < -base : off > (loff_t)mb->size - base)
+        return off < 0 ? -EINVAL : (loff_t)mb->size;
+    return base + off;
+}
+
+static inline ssize_t msgbuf_read(struct msgbuf *mb, char __user *ubuf, size_t count,
+                                  loff_t *pos)
+{
+    size_t n = msgbuf_read_span(mb, *pos, count);
+
+    if (!n)
+        return 0;
+    if (copy_to_user(ubuf, mb->data + *pos, n))
+        return -EFAULT;
+
+    *pos += n;
+    pr_debug("%s: read %zu bytes, offset now %lld\n", __func__, n, *pos);
+    return n;
+}
+
+static inline ssize_t msgbuf_write(struct msgbuf *mb, const char __user *ubuf, size_t count,
+                                   loff_t *pos)
+{
+    ssize_t n = msgbuf_write_span(mb, *pos, count);
+
+    if (n <= 0)
+        return n;
+    if (copy_from_user(mb->data + *pos, ubuf, n))
+        return -EFAULT;
+
+    *pos += n;
+    /* a write past the valid data extends it */
+    if (*pos > mb->len)
+        mb->len = *pos;
+    pr_debug("%s: wrote %zd bytes, offset now %lld\n", __func__, n, *pos);
+    return n;
+}
+
+static inline loff_t msgbuf_llseek(struct msgbuf *mb, struct file *file, loff_t off, int whence)
+{
+    loff_t pos = msgbuf_seek_pos(mb, file->f_pos, off, whence);
+
+    if (pos < 0)
+        return pos;
+
+    file->f_pos = pos;
+    pr_debug("%s: new position %lld\n", __func__, pos);
+    return pos;
+}
+
+#endif
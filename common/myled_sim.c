@@ -0,0 +1,143 @@
+// myled_sim.c - register "myled" platform devices wired to gpio-sim lines
+//
+// No Raspberry Pi needed: gpio-sim provides a fake GPIO chip, and a GPIO
+// lookup table maps its lines to each "myled" device (instead of a DT
+// "gpios" / "led-gpios" property). The platform bus then matches them to
+// whichever myled driver is loaded by name.
+//
+// Built as myled_sim_device.ko by the LED examples (42, 44, 47), each from
+// this one source:
+//   42, 47: nlines=N                   -> lines 0..N-1 as the unnamed "gpios" array
+//   44:     nlines=1 con_id=led line=L -> chip line L as the single "led" GPIO
+//
+// Device N gets chip lines line + N*nlines .. line + N*nlines + nlines-1.
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/gpio/machine.h>
+#include <linux/slab.h>
+#include <linux/overflow.h>
+
+static char *chip = "myled-sim";
+module_param(chip, charp, 0444);
+MODULE_PARM_DESC(chip, "Label of the gpio-sim chip providing the lines");
+
+static unsigned int nlines = 8;
+module_param(nlines, uint, 0444);
+MODULE_PARM_DESC(nlines, "Number of LED lines per device");
+
+static unsigned int ndevs = 1;
+module_param(ndevs, uint, 0444);
+MODULE_PARM_DESC(ndevs, "Number of myled devices (the chip needs line + ndevs*nlines lines)");
+
+static unsigned int line;
+module_param(line, uint, 0444);
+MODULE_PARM_DESC(line, "First chip line used (default 0)");
+
+static char *con_id;
+module_param(con_id, charp, 0444);
+MODULE_PARM_DESC(con_id, "GPIO name the driver asks for, e.g. \"led\" (default: unnamed \"gpios\")");
+
+struct myled_sim {
+    struct gpiod_lookup_table *lookup;
+    struct platform_device *pdev;
+};
+
+static struct myled_sim *sims;
+
+// an empty con_id= means the unnamed lookup, like leaving it out
+static const char *myled_sim_con_id(void)
+{
+    return con_id && *con_id ? con_id : NULL;
+}
+
+static void myled_sim_del(struct myled_sim *sim)
+{
+    platform_device_unregister(sim->pdev);
+    gpiod_remove_lookup_table(sim->lookup);
+    kfree(sim->lookup->dev_id);
+    kfree(sim->lookup);
+}
+
+static int myled_sim_add(struct myled_sim *sim, unsigned int id)
+{
+    unsigned int i;
+    int ret;
+
+    // one entry per line + the empty terminator
+    sim->lookup = kzalloc(struct_size(sim->lookup, table, nlines + 1), GFP_KERNEL);
+    if (!sim->lookup)
+        return -ENOMEM;
+
+    // ndevs == 1 keeps the plain "myled" device name of the single-device setup
+    sim->lookup->dev_id = ndevs == 1 ? kstrdup("myled", GFP_KERNEL)
+                                     : kasprintf(GFP_KERNEL, "myled.%u", id);
+    if (!sim->lookup->dev_id) {
+        ret = -ENOMEM;
+        goto err_free;
+    }
+    for (i = 0; i < nlines; i++)
+        sim->lookup->table[i] = GPIO_LOOKUP_IDX(chip, line + id * nlines + i,
+                                                myled_sim_con_id(), i,
+                                                GPIO_ACTIVE_HIGH);
+    gpiod_add_lookup_table(sim->lookup);
+
+    sim->pdev = platform_device_register_simple("myled",
+                                                ndevs == 1 ? PLATFORM_DEVID_NONE : id,
+                                                NULL, 0);
+    if (IS_ERR(sim->pdev)) {
+        ret = PTR_ERR(sim->pdev);
+        gpiod_remove_lookup_table(sim->lookup);
+        kfree(sim->lookup->dev_id);
+        goto err_free;
+    }
+    return 0;
+
+err_free:
+    kfree(sim->lookup);
+    return ret;
+}
+
+static int __init myled_sim_init(void)
+{
+    unsigned int i;
+    int ret;
+
+    if (!nlines || !ndevs)
+        return -EINVAL;
+
+    sims = kcalloc(ndevs, sizeof(*sims), GFP_KERNEL);
+    if (!sims)
+        return -ENOMEM;
+
+    for (i = 0; i < ndevs; i++) {
+        ret = myled_sim_add(&sims[i], i);
+        if (ret)
+            goto err_del;
+    }
+
+    pr_info("myled_sim: %u myled device(s) with %u %s line(s) each on %s from line %u\n",
+            ndevs, nlines, myled_sim_con_id() ?: "gpios", chip, line);
+    return 0;
+
+err_del:
+    while (i--)
+        myled_sim_del(&sims[i]);
+    kfree(sims);
+    return ret;
+}
+
+static void __exit myled_sim_exit(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < ndevs; i++)
+        myled_sim_del(&sims[i]);
+    kfree(sims);
+}
+
+module_init(myled_sim_init);
+module_exit(myled_sim_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Ragab Elsayed");
+MODULE_DESCRIPTION("Platform devices for the myled drivers backed by gpio-sim");
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * msgbuf_kunit.c - KUnit tests for common/msgbuf.h
+ *
+ * The span/seek helpers are pure, so they are checked directly over the
+ * boundary, offset and whence combinations the drivers can hit. The timed
+ * cases report ns/op for 1 B, 64 B and 4 KiB transfers.
+ *
+ * The timed cases call msgbuf_write()/msgbuf_read() themselves, on user
+ * memory from kunit_vm_mmap(): KUnit runs each case in a kthread, which
+ * only gets a user mm for copy_{to,from}_user() from kunit_attach_mm()
+ * (6.10). Older kernels skip them.
+ *
+ * Run: see readme.md next to this file.
+ */
+#include <kunit/test.h>
+#include <linux/ktime.h>
+#include <linux/mman.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+#include "msgbuf.h"
+
+#define TEST_SIZE 4096
+
+static char test_data[TEST_SIZE];
+
+/* buffer of TEST_SIZE bytes, the first @len valid */
+static struct msgbuf test_buf(size_t len)
+{
+    struct msgbuf mb = MSGBUF_INIT(test_data);
+
+    mb.len = len;
+    return mb;
+}
+
+/* ---------- msgbuf_read_span ---------- */
+
+static void msgbuf_read_span_test(struct kunit *test)
+{
+    struct msgbuf mb = test_buf(100);
+    struct msgbuf empty = test_buf(0);
+    struct msgbuf full = test_buf(TEST_SIZE);
+
+    /* inside the valid data */
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, 0, 10), (size_t)10);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, 50, 50), (size_t)50);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, 0, 0), (size_t)0);
+
+    /* clamped to len, not to size */
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, 0, TEST_SIZE), (size_t)100);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, 99, 10), (size_t)1);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, 90, SIZE_MAX), (size_t)10);
+
+    /* EOF at and past len */
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, 100, 1), (size_t)0);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, 101, 1), (size_t)0);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, TEST_SIZE, 1), (size_t)0);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, LLONG_MAX, 1), (size_t)0);
+
+    /* a negative position reads nothing */
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, -1, 10), (size_t)0);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&mb, LLONG_MIN, 10), (size_t)0);
+
+    /* empty and full buffers */
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&empty, 0, 10), (size_t)0);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&full, TEST_SIZE - 1, 10), (size_t)1);
+    KUNIT_EXPECT_EQ(test, msgbuf_read_span(&full, TEST_SIZE, 10), (size_t)0);
+}
+
+/* ---------- msgbuf_write_span ---------- */
+
+static void msgbuf_write_span_test(struct kunit *test)
+{
+    struct msgbuf mb = test_buf(100);
+
+    /* independent of len: writes may extend the data up to size */
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, 0, 10), (ssize_t)10);
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, 100, 10), (ssize_t)10);
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, 200, 10), (ssize_t)10);
+
+    /* clamped to size */
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, 0, TEST_SIZE + 1), (ssize_t)TEST_SIZE);
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, TEST_SIZE - 1, 10), (ssize_t)1);
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, 10, SIZE_MAX), (ssize_t)(TEST_SIZE - 10));
+
+    /* zero-length write at a valid position is not an error */
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, 0, 0), (ssize_t)0);
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, TEST_SIZE - 1, 0), (ssize_t)0);
+
+    /* at or past the end: no space, whatever the count */
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, TEST_SIZE, 1), (ssize_t)-ENOSPC);
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, TEST_SIZE, 0), (ssize_t)-ENOSPC);
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, LLONG_MAX, 1), (ssize_t)-ENOSPC);
+
+    /* negative position */
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, -1, 1), (ssize_t)-EINVAL);
+    KUNIT_EXPECT_EQ(test, msgbuf_write_span(&mb, LLONG_MIN, 1), (ssize_t)-EINVAL);
+}
+
+/* ---------- msgbuf_seek_pos ---------- */
+
+struct seek_case {
+    const char *desc;
+    size_t len;             /* valid data in a TEST_SIZE buffer */
+    loff_t cur, off;
+    int whence;
+    loff_t want;
+};
+
+static const struct seek_case seek_cases[] = {
+    /* SEEK_SET: absolute, clamped to size */
+    { "set 0",                  100, 50, 0,                 SEEK_SET, 0 },
+    { "set inside data",        100, 50, 10,                SEEK_SET, 10 },
+    { "set past data",          100, 50, 200,               SEEK_SET, 200 },
+    { "set to size",            100, 50, TEST_SIZE,         SEEK_SET, TEST_SIZE },
+    { "set past size clamps",   100, 50, TEST_SIZE + 1,     SEEK_SET, TEST_SIZE },
+    { "set LLONG_MAX clamps",   100, 50, LLONG_MAX,         SEEK_SET, TEST_SIZE },
+    { "set -1",                 100, 50, -1,                SEEK_SET, -EINVAL },
+    { "set LLONG_MIN",          100, 50, LLONG_MIN,         SEEK_SET, -EINVAL },
+
+    /* SEEK_CUR: relative to the file position */
+    { "cur +0",                 100, 50, 0,                 SEEK_CUR, 50 },
+    { "cur forward",            100, 50, 25,                SEEK_CUR, 75 },
+    { "cur back to 0",          100, 50, -50,               SEEK_CUR, 0 },
+    { "cur before 0",           100, 50, -51,               SEEK_CUR, -EINVAL },
+    { "cur to size",            100, 50, TEST_SIZE - 50,    SEEK_CUR, TEST_SIZE },
+    { "cur past size clamps",   100, 50, TEST_SIZE,         SEEK_CUR, TEST_SIZE },
+    { "cur LLONG_MAX clamps",   100, 50, LLONG_MAX,         SEEK_CUR, TEST_SIZE },
+    { "cur LLONG_MIN",          100, 50, LLONG_MIN,         SEEK_CUR, -EINVAL },
+    { "cur at size +0",         100, TEST_SIZE, 0,          SEEK_CUR, TEST_SIZE },
+    { "cur at size back",       100, TEST_SIZE, -TEST_SIZE, SEEK_CUR, 0 },
+
+    /* SEEK_END: relative to len, not to size */
+    { "end +0",                 100, 0, 0,                  SEEK_END, 100 },
+    { "end back",               100, 0, -10,                SEEK_END, 90 },
+    { "end back to 0",          100, 0, -100,               SEEK_END, 0 },
+    { "end before 0",           100, 0, -101,               SEEK_END, -EINVAL },
+    { "end forward",            100, 0, 10,                 SEEK_END, 110 },
+    { "end past size clamps",   100, 0, TEST_SIZE,          SEEK_END, TEST_SIZE },
+    { "end of empty",           0,   0, 0,                  SEEK_END, 0 },
+    { "end of empty -1",        0,   0, -1,                 SEEK_END, -EINVAL },
+    { "end of full",            TEST_SIZE, 0, 0,            SEEK_END, TEST_SIZE },
+    { "end of full +1 clamps",  TEST_SIZE, 0, 1,            SEEK_END, TEST_SIZE },
+
+    /* whence the buffer does not implement */
+    { "SEEK_DATA",              100, 50, 0,                 SEEK_DATA, -EINVAL },
+    { "SEEK_HOLE",              100, 50, 0,                 SEEK_HOLE, -EINVAL },
+    { "whence -1",              100, 50, 0,                 -1,        -EINVAL },
+};
+
+static void seek_case_desc(const struct seek_case *c, char *desc)
+{
+    strscpy(desc, c->desc, KUNIT_PARAM_DESC_SIZE);
+}
+
+KUNIT_ARRAY_PARAM(seek, seek_cases, seek_case_desc);
+
+static void msgbuf_seek_pos_test(struct kunit *test)
+{
+    const struct seek_case *c = test->param_value;
+    struct msgbuf mb = test_buf(c->len);
+
+    KUNIT_EXPECT_EQ(test, msgbuf_seek_pos(&mb, c->cur, c->off, c->whence), c->want);
+}
+
+/* ---------- timed copies ---------- */
+
+#define TIMED_ROUNDS 100000
+
+static const size_t copy_sizes[] = { 1, 64, TEST_SIZE };
+
+static void copy_size_desc(const size_t *size, char *desc)
+{
+    snprintf(desc, KUNIT_PARAM_DESC_SIZE, "%zu bytes", *size);
+}
+
+KUNIT_ARRAY_PARAM(copy_size, copy_sizes, copy_size_desc);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+static void msgbuf_copy_timed_test(struct kunit *test)
+{
+    size_t size = *(const size_t *)test->param_value;
+    struct msgbuf mb = test_buf(0);
+    u64 t0, write_ns, read_ns;
+    char __user *usrc, *udst;
+    unsigned long uaddr;
+    char *src, *dst;
+    loff_t pos;
+    size_t i;
+
+    src = kunit_kmalloc(test, size, GFP_KERNEL);
+    dst = kunit_kzalloc(test, size, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dst);
+    for (i = 0; i < size; i++)
+        src[i] = i * 7 + 1;
+
+    /* attaches a user mm to this thread; unmapped when the case ends */
+    uaddr = kunit_vm_mmap(test, NULL, 0, 2 * PAGE_ALIGN(TEST_SIZE),
+                          PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0);
+    KUNIT_ASSERT_FALSE(test, IS_ERR_VALUE(uaddr));
+    KUNIT_ASSERT_NE(test, uaddr, 0UL);
+    usrc = (char __user *)uaddr;
+    udst = usrc + PAGE_ALIGN(TEST_SIZE);
+    KUNIT_ASSERT_EQ(test, copy_to_user(usrc, src, size), 0UL);
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < TIMED_ROUNDS; i++) {
+        pos = 0;
+        if (msgbuf_write(&mb, usrc, size, &pos) != (ssize_t)size)
+            break;
+    }
+    write_ns = ktime_get_ns() - t0;
+    KUNIT_ASSERT_EQ(test, i, (size_t)TIMED_ROUNDS);
+    KUNIT_EXPECT_EQ(test, mb.len, size);
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < TIMED_ROUNDS; i++) {
+        pos = 0;
+        if (msgbuf_read(&mb, udst, size, &pos) != (ssize_t)size)
+            break;
+    }
+    read_ns = ktime_get_ns() - t0;
+    KUNIT_ASSERT_EQ(test, i, (size_t)TIMED_ROUNDS);
+    KUNIT_ASSERT_EQ(test, copy_from_user(dst, udst, size), 0UL);
+    KUNIT_EXPECT_EQ(test, memcmp(src, dst, size), 0);
+
+    kunit_info(test, "%zu B: write %llu ns/op, read %llu ns/op\n", size,
+               div_u64(write_ns, TIMED_ROUNDS), div_u64(read_ns, TIMED_ROUNDS));
+}
+#else
+static void msgbuf_copy_timed_test(struct kunit *test)
+{
+    kunit_skip(test, "needs kunit_vm_mmap() (6.10) for user memory");
+}
+#endif
+
+static struct kunit_case msgbuf_test_cases[] = {
+    KUNIT_CASE(msgbuf_read_span_test),
+    KUNIT_CASE(msgbuf_write_span_test),
+    KUNIT_CASE_PARAM(msgbuf_seek_pos_test, seek_gen_params),
+    KUNIT_CASE_PARAM(msgbuf_copy_timed_test, copy_size_gen_params),
+    {}
+};
+
+static struct kunit_suite msgbuf_test_suite = {
+    .name = "msgbuf",
+    .test_cases = msgbuf_test_cases,
+};
+
+kunit_test_suite(msgbuf_test_suite);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("KUnit tests for common/msgbuf.h");
@@ -0,0 +1,568 @@
+/*
+ * devbench.c - load generator for the /dev nodes of the drivers in this repo.
+ *
+ * gcc -O2 -pthread -o devbench devbench.c      (or just: make)
+ *
+ *   devbench run [options] <dev>
+ *   devbench list [drivers.conf]
+ *
+ * run options:
+ *   -t N         threads, each with its own open() (default 1)
+ *   -d SEC       duration in seconds (default 5)
+ *   -m MIX       op mix by weight, e.g. read=70,write=20,lseek=5,ioctl=5
+ *                (default read=50,write=50)
+ *   -s SIZES     record sizes, one picked at random per op (default 64)
+ *   -L SPAN      lseek targets are random offsets in [0, SPAN) (default 1024)
+ *   -c CPUS      pin thread i to the i-th CPU of the list, e.g. 0-3,6
+ *   -i CMD[=ARG] ioctl issued by the "ioctl" op, may be repeated. With ARG
+ *                the integer is passed; without it, a pointer to a zeroed
+ *                scratch buffer (enough for any _IOR/_IOW payload).
+ *   -p STR       write STR instead of sized records (for the "value" devices)
+ *   -n NAME      label stored in the report (default: the device path)
+ *   -j FILE      write the report as JSON to FILE ("-" = stdout, no text)
+ *
+ * Reads that hit EOF and writes that hit the end of the buffer (ENOSPC)
+ * rewind the file to 0; they are counted as "rewinds", not as errors.
+ * Latencies go to a log-linear histogram (HDR style, < 1% error), so the
+ * percentiles stay exact enough down to single-digit nanoseconds and up to
+ * seconds without keeping every sample.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#define MAX_SIZES	16
+#define MAX_IOCTLS	8
+#define MAX_CPUS	256
+#define SCRATCH		4096
+
+/* log-linear histogram: 2^SUB_BITS unit buckets, then 2^(SUB_BITS-1) per power of 2 */
+#define SUB_BITS	8
+#define SUB_HALF	(1 << (SUB_BITS - 1))
+#define HDR_BUCKETS	((1 << SUB_BITS) + (64 - SUB_BITS) * SUB_HALF)
+
+enum op { OP_READ, OP_WRITE, OP_LSEEK, OP_IOCTL, NR_OPS };
+
+static const char * const op_names[NR_OPS] = { "read", "write", "lseek", "ioctl" };
+
+struct hist {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t b[HDR_BUCKETS];
+};
+
+struct op_stats {
+	uint64_t errors;
+	uint64_t bytes;
+	struct hist lat;
+};
+
+struct ioctl_spec {
+	unsigned long cmd;
+	unsigned long arg;
+	int has_arg;
+};
+
+struct config {
+	const char *dev;
+	const char *name;
+	const char *json;
+	const char *payload;
+	int threads;
+	int seconds;
+	unsigned int weight[NR_OPS];
+	unsigned int total_weight;
+	size_t sizes[MAX_SIZES];
+	int nsizes;
+	off_t span;
+	int cpus[MAX_CPUS];
+	int ncpus;
+	struct ioctl_spec ioctls[MAX_IOCTLS];
+	int nioctls;
+};
+
+struct worker {
+	pthread_t tid;
+	int idx;
+	int fd;
+	unsigned int seed;
+	uint64_t rewinds;
+	struct op_stats op[NR_OPS];
+};
+
+static struct config cfg;
+static volatile sig_atomic_t stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int hist_index(uint64_t v)
+{
+	int shift;
+
+	if (v < (1 << SUB_BITS))
+		return v;
+	shift = 63 - __builtin_clzll(v) - SUB_BITS + 1;
+	return (1 << SUB_BITS) + (shift - 1) * SUB_HALF + (int)(v >> shift) - SUB_HALF;
+}
+
+/* highest value that lands in bucket i */
+static uint64_t hist_value(int i)
+{
+	int shift;
+
+	if (i < (1 << SUB_BITS))
+		return i;
+	i -= 1 << SUB_BITS;
+	shift = i / SUB_HALF + 1;
+	return ((uint64_t)(i % SUB_HALF + SUB_HALF + 1) << shift) - 1;
+}
+
+static void hist_add(struct hist *h, uint64_t v)
+{
+	if (!h->count || v < h->min)
+		h->min = v;
+	if (v > h->max)
+		h->max = v;
+	h->count++;
+	h->sum += v;
+	h->b[hist_index(v)]++;
+}
+
+static void hist_merge(struct hist *dst, const struct hist *src)
+{
+	int i;
+
+	if (!src->count)
+		return;
+	if (!dst->count || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->count += src->count;
+	dst->sum += src->sum;
+	for (i = 0; i < HDR_BUCKETS; i++)
+		dst->b[i] += src->b[i];
+}
+
+static uint64_t hist_pct(const struct hist *h, double pct)
+{
+	uint64_t want, seen = 0;
+	int i;
+
+	if (!h->count)
+		return 0;
+	want = (uint64_t)(h->count * pct / 100.0 + 0.5);
+	if (want < 1)
+		want = 1;
+	for (i = 0; i < HDR_BUCKETS; i++) {
+		seen += h->b[i];
+		if (seen >= want)
+			return hist_value(i) < h->max ? hist_value(i) : h->max;
+	}
+	return h->max;
+}
+
+static const double pcts[] = { 50, 90, 99, 99.9, 99.99 };
+#define NR_PCTS (sizeof(pcts) / sizeof(pcts[0]))
+
+/* ---- option parsing ---- */
+
+static void die(const char *msg, const char *arg)
+{
+	fprintf(stderr, "devbench: %s%s%s\n", msg, arg ? ": " : "", arg ? arg : "");
+	exit(1);
+}
+
+static void parse_mix(char *s)
+{
+	char *tok, *eq;
+	int i;
+
+	memset(cfg.weight, 0, sizeof(cfg.weight));
+	for (tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+		eq = strchr(tok, '=');
+		if (!eq)
+			die("bad mix entry (want op=weight)", tok);
+		*eq = '\0';
+		for (i = 0; i < NR_OPS; i++)
+			if (!strcmp(tok, op_names[i]))
+				break;
+		if (i == NR_OPS)
+			die("unknown op", tok);
+		cfg.weight[i] = strtoul(eq + 1, NULL, 0);
+	}
+}
+
+static void parse_sizes(char *s)
+{
+	char *tok;
+
+	cfg.nsizes = 0;
+	for (tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+		if (cfg.nsizes == MAX_SIZES)
+			die("too many sizes", tok);
+		cfg.sizes[cfg.nsizes] = strtoul(tok, NULL, 0);
+		if (!cfg.sizes[cfg.nsizes] || cfg.sizes[cfg.nsizes] > SCRATCH)
+			die("size must be 1..4096", tok);
+		cfg.nsizes++;
+	}
+}
+
+static void parse_cpus(char *s)
+{
+	char *tok, *dash;
+	int a, b;
+
+	for (tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+		a = b = atoi(tok);
+		dash = strchr(tok, '-');
+		if (dash)
+			b = atoi(dash + 1);
+		for (; a <= b && cfg.ncpus < MAX_CPUS; a++)
+			cfg.cpus[cfg.ncpus++] = a;
+	}
+}
+
+static void parse_ioctl(char *s)
+{
+	struct ioctl_spec *io;
+	char *eq;
+
+	if (cfg.nioctls == MAX_IOCTLS)
+		die("too many ioctls", s);
+	io = &cfg.ioctls[cfg.nioctls++];
+	eq = strchr(s, '=');
+	if (eq) {
+		*eq = '\0';
+		io->arg = strtoul(eq + 1, NULL, 0);
+		io->has_arg = 1;
+	}
+	io->cmd = strtoul(s, NULL, 0);
+}
+
+/* ---- the load ---- */
+
+static enum op pick_op(struct worker *w)
+{
+	unsigned int r = rand_r(&w->seed) % cfg.total_weight;
+	int i;
+
+	for (i = 0; i < NR_OPS - 1; i++) {
+		if (r < cfg.weight[i])
+			break;
+		r -= cfg.weight[i];
+	}
+	return i;
+}
+
+static void on_signal(int sig)
+{
+	(void)sig;      /* only here to knock threads out of blocking syscalls */
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	char *buf = calloc(1, SCRATCH);
+	char *scratch = calloc(1, SCRATCH);
+	size_t plen = cfg.payload ? strlen(cfg.payload) : 0;
+	struct ioctl_spec *io;
+	uint64_t t0, t1;
+	ssize_t ret;
+	size_t size;
+	enum op op;
+
+	memset(buf, 'a' + w->idx % 26, SCRATCH);
+
+	if (cfg.ncpus) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(cfg.cpus[w->idx % cfg.ncpus], &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+			fprintf(stderr, "devbench: thread %d: cannot pin to CPU %d\n",
+				w->idx, cfg.cpus[w->idx % cfg.ncpus]);
+	}
+
+	while (!stop) {
+		op = pick_op(w);
+		size = cfg.sizes[rand_r(&w->seed) % cfg.nsizes];
+
+		t0 = now_ns();
+		switch (op) {
+		case OP_READ:
+			ret = read(w->fd, buf, size);
+			break;
+		case OP_WRITE:
+			ret = plen ? write(w->fd, cfg.payload, plen) : write(w->fd, buf, size);
+			break;
+		case OP_LSEEK:
+			ret = lseek(w->fd, rand_r(&w->seed) % cfg.span, SEEK_SET);
+			break;
+		default:
+			io = &cfg.ioctls[rand_r(&w->seed) % cfg.nioctls];
+			ret = ioctl(w->fd, io->cmd, io->has_arg ? io->arg : (unsigned long)scratch);
+			break;
+		}
+		t1 = now_ns();
+
+		if (ret < 0 && errno == EINTR && stop)
+			break;
+
+		hist_add(&w->op[op].lat, t1 - t0);
+		if ((op == OP_READ && ret == 0) || (op == OP_WRITE && ret < 0 && errno == ENOSPC)) {
+			/* end of the device buffer: start over, not an error */
+			lseek(w->fd, 0, SEEK_SET);
+			w->rewinds++;
+		} else if (ret < 0) {
+			w->op[op].errors++;
+		} else if (op == OP_READ || op == OP_WRITE) {
+			w->op[op].bytes += ret;
+		}
+	}
+
+	free(scratch);
+	free(buf);
+	return NULL;
+}
+
+/* ---- reports ---- */
+
+static void print_text(struct op_stats *tot, struct op_stats *all, uint64_t rewinds,
+		       double secs)
+{
+	int i, j;
+
+	printf("%s: %d thread(s), %.1f s, sizes", cfg.name, cfg.threads, secs);
+	for (i = 0; i < cfg.nsizes; i++)
+		printf("%c%zu", i ? ',' : ' ', cfg.sizes[i]);
+	printf(", %llu rewinds\n", (unsigned long long)rewinds);
+	printf("%-6s %11s %11s %9s %8s %8s %8s %8s %8s %8s %8s  (us)\n", "op", "ops",
+	       "ops/s", "MB/s", "errors", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+
+	for (i = 0; i <= NR_OPS; i++) {
+		struct op_stats *s = i < NR_OPS ? &tot[i] : all;
+
+		if (!s->lat.count)
+			continue;
+		printf("%-6s %11llu %11.0f %9.2f %8llu", i < NR_OPS ? op_names[i] : "all",
+		       (unsigned long long)s->lat.count, s->lat.count / secs,
+		       s->bytes / secs / 1e6, (unsigned long long)s->errors);
+		for (j = 0; j < (int)NR_PCTS; j++)
+			printf(" %8.2f", hist_pct(&s->lat, pcts[j]) / 1e3);
+		printf(" %8.2f\n", s->lat.max / 1e3);
+	}
+}
+
+static void json_op(FILE *f, const char *name, struct op_stats *s, double secs, int last)
+{
+	int j;
+
+	fprintf(f, "    \"%s\": {\"ops\": %llu, \"ops_per_s\": %.1f, \"bytes\": %llu, "
+		"\"bytes_per_s\": %.1f, \"errors\": %llu,\n      \"lat_ns\": {\"min\": %llu, "
+		"\"mean\": %.1f",
+		name, (unsigned long long)s->lat.count, s->lat.count / secs,
+		(unsigned long long)s->bytes, s->bytes / secs, (unsigned long long)s->errors,
+		(unsigned long long)s->lat.min, (double)s->lat.sum / s->lat.count);
+	for (j = 0; j < (int)NR_PCTS; j++)
+		fprintf(f, ", \"p%g\": %llu", pcts[j],
+			(unsigned long long)hist_pct(&s->lat, pcts[j]));
+	fprintf(f, ", \"max\": %llu}}%s\n", (unsigned long long)s->lat.max, last ? "" : ",");
+}
+
+static void print_json(FILE *f, struct op_stats *tot, struct op_stats *all,
+		       uint64_t rewinds, double secs)
+{
+	int i, last;
+
+	fprintf(f, "{\n  \"name\": \"%s\",\n  \"device\": \"%s\",\n", cfg.name, cfg.dev);
+	fprintf(f, "  \"threads\": %d,\n  \"duration_s\": %.3f,\n  \"sizes\": [", cfg.threads, secs);
+	for (i = 0; i < cfg.nsizes; i++)
+		fprintf(f, "%s%zu", i ? ", " : "", cfg.sizes[i]);
+	fprintf(f, "],\n  \"mix\": {");
+	for (i = 0; i < NR_OPS; i++)
+		fprintf(f, "%s\"%s\": %u", i ? ", " : "", op_names[i], cfg.weight[i]);
+	fprintf(f, "},\n  \"cpus\": [");
+	for (i = 0; i < cfg.ncpus; i++)
+		fprintf(f, "%s%d", i ? ", " : "", cfg.cpus[i]);
+	fprintf(f, "],\n  \"rewinds\": %llu,\n  \"ops\": {\n", (unsigned long long)rewinds);
+
+	for (last = NR_OPS - 1; last >= 0 && !tot[last].lat.count; last--)
+		;
+	for (i = 0; i <= last; i++)
+		if (tot[i].lat.count)
+			json_op(f, op_names[i], &tot[i], secs, i == last);
+	fprintf(f, "  },\n  \"total\": {\n");
+	json_op(f, "all", all, secs, 1);
+	fprintf(f, "  }\n}\n");
+}
+
+static int cmd_run(int argc, char *argv[])
+{
+	struct op_stats tot[NR_OPS], *all;
+	struct sigaction sa = { .sa_handler = on_signal };
+	struct worker *w;
+	uint64_t t0, rewinds = 0;
+	double secs;
+	int flags, opt, i, j;
+
+	cfg.threads = 1;
+	cfg.seconds = 5;
+	cfg.weight[OP_READ] = cfg.weight[OP_WRITE] = 50;
+	cfg.sizes[0] = 64;
+	cfg.nsizes = 1;
+	cfg.span = 1024;
+
+	while ((opt = getopt(argc, argv, "t:d:m:s:L:c:i:p:n:j:")) != -1) {
+		switch (opt) {
+		case 't': cfg.threads = atoi(optarg); break;
+		case 'd': cfg.seconds = atoi(optarg); break;
+		case 'm': parse_mix(optarg); break;
+		case 's': parse_sizes(optarg); break;
+		case 'L': cfg.span = strtoul(optarg, NULL, 0); break;
+		case 'c': parse_cpus(optarg); break;
+		case 'i': parse_ioctl(optarg); break;
+		case 'p': cfg.payload = optarg; break;
+		case 'n': cfg.name = optarg; break;
+		case 'j': cfg.json = optarg; break;
+		default: return 1;
+		}
+	}
+	if (optind != argc - 1)
+		die("usage: devbench run [options] <dev>", NULL);
+	cfg.dev = argv[optind];
+	if (!cfg.name)
+		cfg.name = cfg.dev;
+
+	for (i = 0; i < NR_OPS; i++)
+		cfg.total_weight += cfg.weight[i];
+	if (!cfg.total_weight)
+		die("empty op mix", NULL);
+	if (cfg.weight[OP_IOCTL] && !cfg.nioctls)
+		die("ioctl in the mix needs at least one -i CMD", NULL);
+	if (cfg.threads < 1 || cfg.seconds < 1 || cfg.span < 1)
+		die("threads, duration and span must be positive", NULL);
+
+	if (!cfg.weight[OP_WRITE])
+		flags = O_RDONLY;
+	else if (!cfg.weight[OP_READ])
+		flags = O_WRONLY;
+	else
+		flags = O_RDWR;
+
+	w = calloc(cfg.threads, sizeof(*w));
+	all = calloc(1, sizeof(*all));
+	if (!w || !all)
+		die("out of memory", NULL);
+
+	sigaction(SIGUSR1, &sa, NULL);      /* no SA_RESTART: blocked reads return EINTR */
+
+	/* open everything first, so single-open devices fail before any load runs */
+	for (i = 0; i < cfg.threads; i++) {
+		w[i].idx = i;
+		w[i].seed = i + 1;
+		w[i].fd = open(cfg.dev, flags);
+		if (w[i].fd < 0) {
+			fprintf(stderr, "devbench: open %s (thread %d): %s\n", cfg.dev, i,
+				strerror(errno));
+			return 2;
+		}
+	}
+
+	t0 = now_ns();
+	for (i = 0; i < cfg.threads; i++)
+		pthread_create(&w[i].tid, NULL, worker_fn, &w[i]);
+	sleep(cfg.seconds);
+	stop = 1;
+	for (i = 0; i < cfg.threads; i++)
+		pthread_kill(w[i].tid, SIGUSR1);
+	for (i = 0; i < cfg.threads; i++)
+		pthread_join(w[i].tid, NULL);
+	secs = (now_ns() - t0) / 1e9;
+
+	memset(tot, 0, sizeof(tot));
+	for (i = 0; i < cfg.threads; i++) {
+		close(w[i].fd);
+		rewinds += w[i].rewinds;
+		for (j = 0; j < NR_OPS; j++) {
+			tot[j].errors += w[i].op[j].errors;
+			tot[j].bytes += w[i].op[j].bytes;
+			hist_merge(&tot[j].lat, &w[i].op[j].lat);
+		}
+	}
+	for (j = 0; j < NR_OPS; j++) {
+		all->errors += tot[j].errors;
+		all->bytes += tot[j].bytes;
+		hist_merge(&all->lat, &tot[j].lat);
+	}
+
+	if (!cfg.json || strcmp(cfg.json, "-"))
+		print_text(tot, all, rewinds, secs);
+	if (cfg.json) {
+		FILE *f = strcmp(cfg.json, "-") ? fopen(cfg.json, "w") : stdout;
+
+		if (!f) {
+			perror(cfg.json);
+			return 2;
+		}
+		print_json(f, tot, all, rewinds, secs);
+		if (f != stdout)
+			fclose(f);
+	}
+	return all->lat.count ? 0 : 2;
+}
+
+/* drivers.conf: "<dir> <modules> <node> <run options...>", '#' comments */
+static int cmd_list(int argc, char *argv[])
+{
+	const char *path = argc > 1 ? argv[1] : "drivers.conf";
+	char line[1024], dir[64], mods[256], node[128];
+	FILE *f = fopen(path, "r");
+	int n;
+
+	if (!f) {
+		perror(path);
+		return 2;
+	}
+	printf("%-5s %-8s %-28s %s\n", "dir", "present", "node", "options");
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || sscanf(line, "%63s %255s %127s %n", dir, mods, node, &n) < 3)
+			continue;
+		line[strcspn(line, "\n")] = '\0';
+		printf("%-5s %-8s %-28s %s\n", dir, access(node, F_OK) ? "no" : "yes", node,
+		       line + n);
+	}
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "run"))
+		return cmd_run(argc - 1, argv + 1);
+	if (argc > 1 && !strcmp(argv[1], "list"))
+		return cmd_list(argc - 1, argv + 1);
+
+	fprintf(stderr, "usage: %s run [options] <dev>\n"
+			"       %s list [drivers.conf]\n"
+			"see the top of devbench.c for the run options\n", argv[0], argv[0]);
+	return 1;
+}
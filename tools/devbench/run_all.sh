@@ -0,0 +1,52 @@
+#!/bin/sh
+# Build, load and benchmark every driver listed in drivers.conf, one after
+# the other, and keep one JSON report per driver for regression tracking.
+#
+#   sudo ./run_all.sh [outdir] [seconds] [threads] [cpus]
+#   e.g. sudo ./run_all.sh results/$(git rev-parse --short HEAD) 5 4 0-3
+#
+# Drivers whose node does not show up after loading (DT-only examples
+# without the overlay applied, missing gpio-sim, ...) are reported as
+# skipped. The examples share node names, so only one is loaded at a time.
+
+HERE=$(cd $(dirname $0) && pwd)
+TOP=$(cd $HERE/../.. && pwd)
+OUT=${1:-results}
+SECS=${2:-5}
+THREADS=${3:-4}
+CPUS=$4
+
+make -C $HERE -s || exit 1
+mkdir -p $OUT
+
+grep -v '^#' $HERE/drivers.conf | while read NUM MODS NODE OPTS; do
+    [ -n "$NUM" ] || continue
+    DIR=$(ls -d $TOP/${NUM}_* | head -1)
+    NAME=$(basename $DIR)
+
+    if ! make -C $DIR -s > $OUT/$NUM.build.log 2>&1; then
+        echo "$NUM: build failed (see $OUT/$NUM.build.log)"
+        continue
+    fi
+
+    LOADED=
+    for M in $(echo $MODS | tr , ' '); do
+        insmod $DIR/$M.ko || break
+        LOADED="$M $LOADED"
+    done
+    udevadm settle 2>/dev/null
+
+    if [ -e $NODE ]; then
+        # per-driver options come last, so e.g. "-t 1" for single-open devices wins
+        $HERE/devbench run -n $NAME -d $SECS -t $THREADS ${CPUS:+-c $CPUS} \
+            -j $OUT/$NUM.json $OPTS $NODE > $OUT/$NUM.txt 2>&1 \
+            && echo "$NUM: $(sed -n 's/^all *\([0-9]*\) *\([0-9]*\).*/\2 ops\/s/p' $OUT/$NUM.txt)" \
+            || echo "$NUM: FAILED (see $OUT/$NUM.txt)"
+    else
+        echo "$NUM: skipped, $NODE not created"
+    fi
+
+    for M in $LOADED; do
+        rmmod $M
+    done
+done